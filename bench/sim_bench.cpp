@@ -0,0 +1,479 @@
+// 模拟器吞吐量基准: 热点路径的微基准与整条 trace 的端到端运行, 结果以每秒模拟的请求数表示.
+//   用法: sim_bench [-quick] [-reps N] [-filter text] [-data dir] [-o results.json]
+//                   [-baseline baseline.json] [-threshold percent]
+// 每项重复 reps 次取最快的一次. -o 写出结果, 可作为以后运行的 -baseline;
+// 与基准相比吞吐量下降超过 threshold (默认 10%) 的项标为 REGRESSION, 此时退出码为 2.
+// 数值与机器和构建类型有关, 基准文件应在同一台机器上用 Release 构建生成
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "bus.hpp"
+#include "cache.hpp"
+#include "core.hpp"
+#include "memory.hpp"
+#include "request.hpp"
+#include "simulator.hpp"
+#include "trace.hpp"
+#include "workload.hpp"
+
+#ifdef NDEBUG
+#define BENCH_BUILD "release"
+#else
+#define BENCH_BUILD "debug"
+#endif
+
+#ifndef SIM_DATA_DIR
+#define SIM_DATA_DIR "data"
+#endif
+
+struct BenchOptions {
+    bool quick = false;
+    int reps = 3;
+    std::string filter;
+    std::string data_dir = SIM_DATA_DIR;
+    std::string output;
+    std::string baseline;
+    double threshold = 10.0;
+};
+
+// 一次计时: 模拟的请求数与耗时
+struct Measurement {
+    uint64_t requests = 0;
+    double seconds = 0.0;
+};
+
+struct BenchResult {
+    std::string name;
+    double rate = 0.0;          // 每秒请求数, 取各次重复中最快的
+};
+
+template <typename F>
+static double seconds(F f) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(end - start).count();
+}
+
+// 防止编译器删掉只为计时而做的计算
+static volatile uint64_t sink;
+
+// 几个核、各自的 cache、总线和内存, 不经过 Simulator, 供微基准直接调用组件
+struct Machine {
+    Memory memory;
+    std::vector<Core *> cores;
+    std::unique_ptr<Bus> bus;
+
+    Machine(int num_cores, const CacheGeometry &geometry) {
+        for (int i = 0; i < num_cores; i++) {
+            Core *core = new Core(i);
+            core->setCache(new Cache(i, geometry));
+            cores.push_back(core);
+        }
+        bus.reset(new Bus(cores, &memory));
+        for (Core *core : cores) {
+            core->getCache()->setBus(bus.get());
+            core->getCache()->setMemory(&memory);
+        }
+        bus->setOutput(false, nullptr);
+    }
+    ~Machine() {
+        for (Core *core : cores) {
+            delete core->getCache();
+            delete core;
+        }
+    }
+    Machine(const Machine &) = delete;
+    Machine &operator=(const Machine &) = delete;
+    Cache *cache(int id) { return cores[id]->getCache(); }
+};
+
+// 读命中: 反复访问已装入的一半容量
+static Measurement benchCacheHit(size_t count) {
+    const CacheGeometry &geometry = DefaultGeometry::value;
+    Machine machine(1, geometry);
+    Cache *cache = machine.cache(0);
+    uint64_t lines = geometry.sets * geometry.ways / 2;
+    for (uint64_t l = 0; l < lines; l++) {
+        cache->access(l * geometry.line_bytes, READ);
+    }
+    Measurement m;
+    m.requests = count;
+    m.seconds = seconds([&]() {
+        uint64_t hits = 0;
+        uint64_t x = 1;
+        for (size_t n = 0; n < count; n++) {
+            x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+            hits += cache->access(((x >> 33) % lines) * geometry.line_bytes, READ);
+        }
+        sink = hits;
+    });
+    return m;
+}
+
+// 读缺失: 顺序扫描 4 倍容量的区域, LRU 下每次都缺失并从内存取行, 替换的是干净行
+static Measurement benchCacheMiss(size_t count) {
+    const CacheGeometry &geometry = DefaultGeometry::value;
+    Machine machine(1, geometry);
+    Cache *cache = machine.cache(0);
+    uint64_t lines = 4ULL * geometry.sets * geometry.ways;
+    // 先扫描一遍, 内存页在计时前分配好
+    for (uint64_t l = 0; l < lines; l++) {
+        cache->access(l * geometry.line_bytes, READ);
+    }
+    Measurement m;
+    m.requests = count;
+    m.seconds = seconds([&]() {
+        uint64_t hits = 0;
+        for (size_t n = 0; n < count; n++) {
+            hits += cache->access((n % lines) * geometry.line_bytes, READ);
+        }
+        sink = hits;
+    });
+    return m;
+}
+
+// 总线广播: 4 核, 每次读缺失探测其余 3 个 cache, 一半的行在某个 cache 中
+static Measurement benchBroadcast(size_t count) {
+    const CacheGeometry &geometry = DefaultGeometry::value;
+    Machine machine(4, geometry);
+    uint64_t lines = geometry.sets * geometry.ways / 2;
+    for (uint64_t l = 0; l < lines; l++) {
+        machine.cache(1 + l % 3)->access(l * geometry.line_bytes, READ);
+    }
+    std::vector<uint32_t> line(geometry.words_per_line);
+    Measurement m;
+    m.requests = count;
+    m.seconds = seconds([&]() {
+        uint64_t supplied = 0;
+        for (size_t n = 0; n < count; n++) {
+            bool shared = false;
+            supplied += machine.bus->broadcast(READ_MISS, (n % (2 * lines)) * geometry.line_bytes, 0, &shared,
+                                               line.data());
+        }
+        sink = supplied;
+    });
+    return m;
+}
+
+// 文本请求解析: 读写混合, 地址与数据位数不等
+static Measurement benchParse(size_t count) {
+    std::string text;
+    std::vector<size_t> offsets;
+    uint32_t x = 7;
+    for (int n = 0; n < 1024; n++) {
+        x = x * 1664525u + 1013904223u;
+        std::ostringstream line;
+        line << "<P" << (x >> 8) % 4 << ", ";
+        if ((x >> 12) & 1) {
+            line << "write, " << (x >> 14) % 65536 << ", " << (x >> 4) % 1000 << ">";
+        } else {
+            line << "read, " << (x >> 14) % 65536 << ", - >";
+        }
+        offsets.push_back(text.size());
+        text += line.str();
+    }
+    offsets.push_back(text.size());
+    Measurement m;
+    m.requests = count;
+    m.seconds = seconds([&]() {
+        uint64_t sum = 0;
+        for (size_t n = 0; n < count; n++) {
+            size_t k = n % 1024;
+            Request request = parseRequest(text.data() + offsets[k], text.data() + offsets[k + 1]);
+            sum += request.address + request.op;
+        }
+        sink = sum;
+    });
+    return m;
+}
+
+// 仲裁: 4 核每周期各发一个请求, 大多命中各自的行, 每 8 个周期有一次写共享行
+static Measurement benchArbitrate(size_t count) {
+    const CacheGeometry &geometry = DefaultGeometry::value;
+    Machine machine(4, geometry);
+    std::vector<std::vector<Request>> cycles(64);
+    for (size_t c = 0; c < cycles.size(); c++) {
+        for (int id = 0; id < 4; id++) {
+            uint64_t address = (c % 8 == 0 && id == static_cast<int>(c / 8 % 4)) ? 0
+                             : (1 + id * 64 + c % 16) * geometry.line_bytes;
+            Operation op = c % 2 ? WRITE : READ;
+            cycles[c].push_back(Request(id, op, address, static_cast<uint16_t>(c)));
+        }
+    }
+    size_t num_cycles = count / 4;
+    Measurement m;
+    m.requests = num_cycles * 4;
+    m.seconds = seconds([&]() {
+        for (size_t c = 0; c < num_cycles; c++) {
+            machine.bus->beginCycle(c);
+            machine.bus->arbitrate(cycles[c % cycles.size()]);
+        }
+    });
+    sink = machine.cache(0)->stats.hits();
+    return m;
+}
+
+// 端到端: 完整的 Simulator (静默模式), 每次运行重新构造. 短 trace 重复运行直到至少 min_seconds
+static Measurement benchSimulate(const TraceData &trace, const SimConfig &config, double min_seconds) {
+    Measurement m;
+    do {
+        m.seconds += seconds([&]() {
+            Simulator sim(config);
+            sim.run(trace);
+            sim.finish();
+        });
+        m.requests += trace.requests.size();
+    } while (m.seconds < min_seconds);
+    return m;
+}
+
+static bool loadTrace(const std::string &filename, int num_cores, TraceData &trace) {
+    std::unique_ptr<TraceReader> reader = TraceReader::open(filename);
+    if (!reader) {
+        return false;
+    }
+    reader->setNumCores(num_cores);
+    trace.load(*reader);
+    return true;
+}
+
+static SimConfig quietConfig() {
+    SimConfig config;
+    config.quiet = true;
+    config.report = false;
+    return config;
+}
+
+class BenchRunner {
+private:
+    const BenchOptions &options;
+
+public:
+    std::vector<BenchResult> results;
+
+    explicit BenchRunner(const BenchOptions &options) : options(options) {}
+
+    template <typename F>
+    void run(const std::string &name, F bench) {
+        if (!options.filter.empty() && name.find(options.filter) == std::string::npos) {
+            return;
+        }
+        BenchResult result = {name, 0.0};
+        for (int r = 0; r < options.reps; r++) {
+            Measurement m = bench();
+            if (m.seconds > 0) {
+                result.rate = std::max(result.rate, m.requests / m.seconds);
+            }
+        }
+        std::cout << std::left << std::setw(28) << name << std::right << std::setw(14) << std::fixed
+                  << std::setprecision(0) << result.rate << " req/s" << std::endl;
+        results.push_back(result);
+    }
+};
+
+static bool writeResults(const std::string &filename, const std::vector<BenchResult> &results) {
+    FILE *file = std::fopen(filename.c_str(), "w");
+    if (file == nullptr) {
+        return false;
+    }
+    std::fprintf(file, "{\"build\": \"%s\", \"benchmarks\": [", BENCH_BUILD);
+    for (size_t i = 0; i < results.size(); i++) {
+        std::fprintf(file, "%s\n  {\"name\": \"%s\", \"requests_per_second\": %.1f}", i == 0 ? "" : ",",
+                     results[i].name.c_str(), results[i].rate);
+    }
+    std::fputs("\n]}\n", file);
+    return std::fclose(file) == 0;
+}
+
+// 读取 writeResults 写出的文件. 只识别本程序的输出格式: 依次查找 "name" 与其后的 "requests_per_second"
+static bool readBaseline(const std::string &filename, std::string &build, std::vector<BenchResult> &baseline) {
+    std::ifstream file(filename);
+    if (!file.is_open()) {
+        return false;
+    }
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    std::string text = buffer.str();
+    const std::string build_key = "\"build\": \"";
+    size_t pos = text.find(build_key);
+    if (pos != std::string::npos) {
+        pos += build_key.size();
+        build = text.substr(pos, text.find('"', pos) - pos);
+    }
+    const std::string name_key = "\"name\": \"";
+    const std::string rate_key = "\"requests_per_second\": ";
+    for (pos = text.find(name_key); pos != std::string::npos; pos = text.find(name_key, pos)) {
+        pos += name_key.size();
+        size_t name_end = text.find('"', pos);
+        size_t rate = text.find(rate_key, name_end);
+        if (name_end == std::string::npos || rate == std::string::npos) {
+            return false;
+        }
+        baseline.push_back({text.substr(pos, name_end - pos), std::strtod(text.c_str() + rate + rate_key.size(), nullptr)});
+        pos = rate;
+    }
+    return !baseline.empty();
+}
+
+// 返回退步的项数
+static int compareBaseline(const std::vector<BenchResult> &results, const std::vector<BenchResult> &baseline,
+                           double threshold) {
+    int regressions = 0;
+    std::cout << "\nBenchmark                       Baseline       Current    Change\n";
+    for (const BenchResult &result : results) {
+        auto it = std::find_if(baseline.begin(), baseline.end(),
+                               [&result](const BenchResult &b) { return b.name == result.name; });
+        if (it == baseline.end() || it->rate <= 0) {
+            std::cout << std::left << std::setw(28) << result.name << std::right << "  (not in baseline)\n";
+            continue;
+        }
+        double change = 100.0 * (result.rate / it->rate - 1.0);
+        bool regressed = change < -threshold;
+        regressions += regressed;
+        std::cout << std::left << std::setw(28) << result.name << std::right << std::setw(14) << std::fixed
+                  << std::setprecision(0) << it->rate << std::setw(14) << result.rate << std::setw(9)
+                  << std::showpos << std::setprecision(1) << change << "%" << std::noshowpos
+                  << (regressed ? "  REGRESSION" : "") << "\n";
+    }
+    std::cout << std::flush;
+    return regressions;
+}
+
+static bool parseArgs(int argc, char *argv[], BenchOptions &options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "-quick") {
+            options.quick = true;
+        } else if (arg == "-reps" && has_value) {
+            options.reps = std::atoi(argv[++i]);
+        } else if (arg == "-filter" && has_value) {
+            options.filter = argv[++i];
+        } else if (arg == "-data" && has_value) {
+            options.data_dir = argv[++i];
+        } else if (arg == "-o" && has_value) {
+            options.output = argv[++i];
+        } else if (arg == "-baseline" && has_value) {
+            options.baseline = argv[++i];
+        } else if (arg == "-threshold" && has_value) {
+            options.threshold = std::atof(argv[++i]);
+        } else {
+            return false;
+        }
+    }
+    return options.reps >= 1 && options.threshold > 0;
+}
+
+int main(int argc, char *argv[]) {
+    BenchOptions options;
+    if (!parseArgs(argc, argv, options)) {
+        std::cerr << "Usage: ./sim_bench [-quick] [-reps N] [-filter text] [-data dir] [-o results.json]"
+                  << " [-baseline baseline.json] [-threshold percent]" << std::endl;
+        return 1;
+    }
+    std::string baseline_build;
+    std::vector<BenchResult> baseline;
+    if (!options.baseline.empty() && !readBaseline(options.baseline, baseline_build, baseline)) {
+        std::cerr << "Error: Cannot read baseline " << options.baseline << std::endl;
+        return 1;
+    }
+    std::cout << "sim_bench (" << BENCH_BUILD << " build)\n";
+#ifndef NDEBUG
+    std::cout << "Warning: Debug build; configure with -DCMAKE_BUILD_TYPE=Release for meaningful numbers.\n";
+#endif
+
+    size_t count = options.quick ? 1000000 : 10000000;
+    double min_seconds = options.quick ? 0.05 : 0.3;
+    uint64_t synthetic_cycles = options.quick ? 20000 : 200000;
+    BenchRunner runner(options);
+
+    runner.run("micro/cache_hit", [&]() { return benchCacheHit(count); });
+    runner.run("micro/cache_miss", [&]() { return benchCacheMiss(count / 4); });
+    runner.run("micro/bus_broadcast", [&]() { return benchBroadcast(count / 2); });
+    runner.run("micro/parse_request", [&]() { return benchParse(count); });
+    runner.run("micro/arbitrate", [&]() { return benchArbitrate(count); });
+
+    // data/ 中的 trace, 按文件名排序, 结果的顺序固定
+    std::vector<std::string> files;
+    std::error_code error;
+    for (const auto &entry : std::filesystem::directory_iterator(options.data_dir, error)) {
+        if (entry.path().extension() == ".txt") {
+            files.push_back(entry.path().string());
+        }
+    }
+    if (error) {
+        std::cerr << "Warning: Cannot list " << options.data_dir << ", skipping trace benchmarks." << std::endl;
+    }
+    std::sort(files.begin(), files.end());
+    SimConfig config = quietConfig();
+    for (const std::string &filename : files) {
+        std::string name = "trace/" + std::filesystem::path(filename).stem().string();
+        TraceData trace;
+        if (!loadTrace(filename, config.num_cores, trace)) {
+            std::cerr << "Warning: Cannot open " << filename << std::endl;
+            continue;
+        }
+        runner.run(name, [&]() { return benchSimulate(trace, config, min_seconds); });
+    }
+
+    // 大规模合成负载: 先生成到内存, 计时不含生成
+    struct SyntheticRun {
+        const char *name;
+        const char *workload;
+        int cores;
+        bool timing;
+        bool directory;
+    };
+    const SyntheticRun synthetic[] = {
+        {"synthetic/zipf", "zipf", 4, false, false},
+        {"synthetic/stream", "stream", 4, false, false},
+        {"synthetic/prodcons", "prodcons", 4, false, false},
+        {"synthetic/lock", "lock", 4, false, false},
+        {"synthetic/falseshare", "falseshare", 4, false, false},
+        {"synthetic/zipf-timing", "zipf", 4, true, false},
+        {"synthetic/zipf-16core-dir", "zipf", 16, false, true},
+    };
+    for (const SyntheticRun &run : synthetic) {
+        if (!options.filter.empty() && std::string(run.name).find(options.filter) == std::string::npos) {
+            continue;
+        }
+        WorkloadSpec spec;
+        parseWorkload(std::string(run.workload) + ":cycles=" + std::to_string(synthetic_cycles), spec);
+        SyntheticTraceReader reader(spec);
+        reader.setNumCores(run.cores);
+        TraceData trace;
+        trace.load(reader);
+        SimConfig run_config = quietConfig();
+        run_config.num_cores = run.cores;
+        run_config.timing = run.timing;
+        run_config.interconnect = run.directory ? DIRECTORY_FILTER : BROADCAST_BUS;
+        runner.run(run.name, [&]() { return benchSimulate(trace, run_config, 0.0); });
+    }
+
+    if (!options.output.empty() && !writeResults(options.output, runner.results)) {
+        std::cerr << "Error: Cannot write " << options.output << std::endl;
+        return 1;
+    }
+    if (!options.baseline.empty()) {
+        if (baseline_build != BENCH_BUILD) {
+            std::cout << "Warning: The baseline is from a " << baseline_build << " build." << std::endl;
+        }
+        int regressions = compareBaseline(runner.results, baseline, options.threshold);
+        if (regressions > 0) {
+            std::cout << regressions << " benchmark(s) regressed by more than " << options.threshold << "%."
+                      << std::endl;
+            return 2;
+        }
+    }
+    return 0;
+}
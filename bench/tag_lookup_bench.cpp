@@ -0,0 +1,103 @@
+// tag 查找微基准: 比较原来的结构体数组逐路扫描与结构数组 + 向量比较的 Cache::findWay
+//   用法: tag_lookup_bench [lookups]
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+#include "bus.hpp"
+#include "cache.hpp"
+#include "core.hpp"
+#include "memory.hpp"
+
+// 原来的块布局, 作为对照
+struct AosBlock {
+    State state;
+    uint64_t tag;
+    uint32_t lru_counter;
+    uint32_t *data;
+};
+
+static int scalarFindWay(const AosBlock *set, uint32_t ways, uint64_t tag) {
+    for (uint32_t w = 0; w < ways; w++) {
+        if (set[w].state != INVALID && set[w].tag == tag) {
+            return w;
+        }
+    }
+    return -1;
+}
+
+struct Lookup {
+    uint32_t index;
+    uint64_t tag;
+};
+
+template <typename F>
+static double timeLookups(const std::vector<Lookup> &lookups, F find, long &checksum) {
+    auto start = std::chrono::steady_clock::now();
+    long sum = 0;
+    for (const Lookup &lookup : lookups) {
+        sum += find(lookup.index, lookup.tag);
+    }
+    auto end = std::chrono::steady_clock::now();
+    checksum += sum;
+    return std::chrono::duration<double, std::nano>(end - start).count() / lookups.size();
+}
+
+static void benchGeometry(const CacheGeometry &geometry, size_t count) {
+    Core core(0);
+    Cache cache(0, geometry);
+    core.setCache(&cache);
+    std::vector<Core *> cores = {&core};
+    Memory memory;
+    Bus bus(cores, &memory);
+    bus.setOutput(false, nullptr);
+    cache.setBus(&bus);
+    cache.setMemory(&memory);
+
+    // 每组装满 tag 0..ways-1, 对照数组保存相同内容
+    std::vector<AosBlock> aos(geometry.sets * geometry.ways);
+    for (uint32_t index = 0; index < geometry.sets; index++) {
+        for (uint32_t w = 0; w < geometry.ways; w++) {
+            cache.access(geometry.lineAddress(w, index), READ);
+            aos[index * geometry.ways + w] = AosBlock{EXCLUSIVE, w, 0, nullptr};
+        }
+    }
+
+    // 一半命中, 一半缺失 (tag 超出已装入范围)
+    std::vector<Lookup> lookups(count);
+    uint32_t x = 12345;
+    for (Lookup &lookup : lookups) {
+        x = x * 1664525u + 1013904223u;
+        lookup.index = (x >> 8) % geometry.sets;
+        lookup.tag = (x >> 20) % (2 * geometry.ways);
+    }
+
+    long checksum = 0;
+    double aos_ns = timeLookups(lookups, [&](uint32_t index, uint64_t tag) {
+        return scalarFindWay(&aos[index * geometry.ways], geometry.ways, tag);
+    }, checksum);
+    double soa_ns = timeLookups(lookups, [&](uint32_t index, uint64_t tag) {
+        return cache.findWay(index, tag);
+    }, checksum);
+
+    std::cout << std::setw(3) << geometry.ways << "-way " << std::setw(4) << geometry.sets << " sets: "
+              << "scalar AoS " << std::fixed << std::setprecision(2) << aos_ns << " ns, "
+              << "SoA findWay " << soa_ns << " ns (checksum " << checksum << ")\n";
+}
+
+int main(int argc, char *argv[]) {
+    size_t count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 20000000;
+#if defined(__AVX2__)
+    std::cout << "findWay: AVX2\n";
+#elif defined(__SSE2__)
+    std::cout << "findWay: SSE2\n";
+#else
+    std::cout << "findWay: scalar\n";
+#endif
+    benchGeometry(CacheGeometry::make(16384, 4, 64), count);
+    benchGeometry(L1Geometry32K::value, count);
+    benchGeometry(L1Geometry64K::value, count);
+    return 0;
+}
@@ -0,0 +1,143 @@
+#include "arbitration.hpp"
+#include "checkpoint.hpp"
+#include <numeric>
+#include <utility>
+
+#define AGE_RADIX 256           // 按年龄排序时每趟基数排序处理 8 位
+
+ArbitrationPolicy::ArbitrationPolicy(const std::vector<int> &priorities)
+    : priorities(priorities), num_cores(priorities.size()), rank(priorities.size()),
+      scratch(priorities.size(), ArbitrationCandidate{Request(0, READ), 0}) {
+    std::vector<uint32_t> order(num_cores);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(),
+                     [&priorities](uint32_t a, uint32_t b) { return priorities[a] < priorities[b]; });
+    for (uint32_t i = 0; i < num_cores; i++) {
+        rank[order[i]] = i;
+    }
+    counts.reserve(std::max<uint32_t>(2 * num_cores, AGE_RADIX) + 1);
+}
+
+void ArbitrationPolicy::byPriority(ArbitrationCandidate *begin, ArbitrationCandidate *end) const {
+    countingSort(begin, end, num_cores,
+                 [this](const ArbitrationCandidate &c) { return rank[c.request.processor_id]; });
+}
+
+void StaticArbitration::order(ArbitrationCandidate *begin, ArbitrationCandidate *end, uint64_t) {
+    countingSort(begin, end, 2 * num_cores, [this](const ArbitrationCandidate &c) { return staticKey(c); });
+}
+
+void RoundRobinArbitration::order(ArbitrationCandidate *begin, ArbitrationCandidate *end, uint64_t) {
+    if (begin == end) {
+        return;
+    }
+    // 距离 next 的循环距离小的先服务
+    countingSort(begin, end, num_cores, [this](const ArbitrationCandidate &c) {
+        return (c.request.processor_id + num_cores - next) % num_cores;
+    });
+    next = (begin->request.processor_id + 1) % num_cores;
+}
+
+void RoundRobinArbitration::checkpoint(Checkpoint &cp) {
+    cp.value(next);
+}
+
+void AgeArbitration::order(ArbitrationCandidate *begin, ArbitrationCandidate *end, uint64_t) {
+    if (end - begin < 2) {
+        return;
+    }
+    // 先按静态顺序排好, 再按入队周期做基数排序 (稳定, 同样久的请求保持静态顺序);
+    // 只处理最旧与最新请求之差实际用到的字节, 通常只需一趟
+    countingSort(begin, end, 2 * num_cores, [this](const ArbitrationCandidate &c) { return staticKey(c); });
+    uint64_t oldest = begin->enqueued;
+    uint64_t newest = begin->enqueued;
+    for (ArbitrationCandidate *c = begin + 1; c < end; c++) {
+        oldest = std::min(oldest, c->enqueued);
+        newest = std::max(newest, c->enqueued);
+    }
+    for (int shift = 0; shift < 64 && ((newest - oldest) >> shift) != 0; shift += 8) {
+        countingSort(begin, end, AGE_RADIX, [oldest, shift](const ArbitrationCandidate &c) {
+            return static_cast<uint32_t>(((c.enqueued - oldest) >> shift) & (AGE_RADIX - 1));
+        });
+    }
+}
+
+LotteryArbitration::LotteryArbitration(const std::vector<int> &priorities)
+    : ArbitrationPolicy(priorities), tickets(priorities.size()) {
+    // 彩票数由优先级的名次决定, 优先级相同的核彩票数相同
+    for (size_t i = 0; i < priorities.size(); i++) {
+        uint32_t ahead = 0;
+        for (size_t j = 0; j < priorities.size(); j++) {
+            if (priorities[j] < priorities[i]) {
+                ahead++;
+            }
+        }
+        tickets[i] = priorities.size() - ahead;
+    }
+}
+
+void LotteryArbitration::order(ArbitrationCandidate *begin, ArbitrationCandidate *end, uint64_t) {
+    // 逐个位置抽签, 抽中的请求换到该位置, 其余的继续参加下一轮
+    for (ArbitrationCandidate *slot = begin; slot + 1 < end; slot++) {
+        uint32_t total = 0;
+        for (ArbitrationCandidate *c = slot; c < end; c++) {
+            total += tickets[c->request.processor_id];
+        }
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        uint32_t draw = state % total;
+        ArbitrationCandidate *winner = slot;
+        for (; draw >= tickets[winner->request.processor_id]; winner++) {
+            draw -= tickets[winner->request.processor_id];
+        }
+        std::swap(*slot, *winner);
+    }
+}
+
+void LotteryArbitration::checkpoint(Checkpoint &cp) {
+    cp.value(state);
+}
+
+std::unique_ptr<ArbitrationPolicy> makeArbitrationPolicy(Arbitration kind, const std::vector<int> &priorities) {
+    switch (kind) {
+    case ARB_ROUND_ROBIN:
+        return std::unique_ptr<ArbitrationPolicy>(new RoundRobinArbitration(priorities));
+    case ARB_AGE:
+        return std::unique_ptr<ArbitrationPolicy>(new AgeArbitration(priorities));
+    case ARB_LOTTERY:
+        return std::unique_ptr<ArbitrationPolicy>(new LotteryArbitration(priorities));
+    case ARB_STATIC:
+    default:
+        return std::unique_ptr<ArbitrationPolicy>(new StaticArbitration(priorities));
+    }
+}
+
+bool parseArbitration(const std::string &text, Arbitration &kind) {
+    if (text == "static") {
+        kind = ARB_STATIC;
+    } else if (text == "rr") {
+        kind = ARB_ROUND_ROBIN;
+    } else if (text == "age") {
+        kind = ARB_AGE;
+    } else if (text == "lottery") {
+        kind = ARB_LOTTERY;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char *arbitrationName(Arbitration kind) {
+    switch (kind) {
+    case ARB_ROUND_ROBIN:
+        return "rr";
+    case ARB_AGE:
+        return "age";
+    case ARB_LOTTERY:
+        return "lottery";
+    case ARB_STATIC:
+    default:
+        return "static";
+    }
+}
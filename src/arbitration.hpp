@@ -0,0 +1,125 @@
+#ifndef ARBITRATION_HPP
+#define ARBITRATION_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "common.hpp"
+#include "request.hpp"
+
+class Checkpoint;
+
+#define SMALL_SORT 8            // 不超过这么多候选时用插入排序代替计数排序
+
+// 本周期参与仲裁的一个请求
+struct ArbitrationCandidate {
+    Request request;
+    uint64_t enqueued;          // 进入队列的周期
+};
+
+// 总线仲裁策略: 决定同一周期各核队首的读写请求使用总线的先后. barrier 总是最先处理,
+// 预取总是排在最后, 两者内部按优先级排序, 不受策略影响
+class ArbitrationPolicy {
+protected:
+    const std::vector<int> &priorities;     // 总线的优先级表, 数值小的优先
+    uint32_t num_cores;
+    std::vector<uint32_t> rank;             // 各核按 (优先级, 处理器编号) 排序的名次, 构造时算好
+    // 计数排序的暂存区, 构造时按核数分配
+    mutable std::vector<ArbitrationCandidate> scratch;
+    mutable std::vector<uint32_t> counts;
+
+    // 计数排序: 按 key 升序稳定地排列, key 须小于 buckets. 每核至多一个候选, buckets 为核数的常数倍,
+    // 因此每周期是线性时间, 也不分配内存. 候选很少时直接插入排序, 工作量有常数上界
+    template <typename Key>
+    void countingSort(ArbitrationCandidate *begin, ArbitrationCandidate *end, uint32_t buckets, Key key) const {
+        size_t count = end - begin;
+        if (count <= SMALL_SORT) {
+            for (ArbitrationCandidate *i = begin + 1; i < end; i++) {
+                ArbitrationCandidate item = *i;
+                uint32_t item_key = key(item);
+                ArbitrationCandidate *j = i;
+                for (; j > begin && item_key < key(*(j - 1)); j--) {
+                    *j = *(j - 1);
+                }
+                *j = item;
+            }
+            return;
+        }
+        if (scratch.size() < count) {
+            scratch.resize(count, *begin);
+        }
+        counts.assign(buckets + 1, 0);
+        for (ArbitrationCandidate *c = begin; c < end; c++) {
+            counts[key(*c) + 1]++;
+        }
+        for (uint32_t b = 1; b <= buckets; b++) {
+            counts[b] += counts[b - 1];
+        }
+        for (ArbitrationCandidate *c = begin; c < end; c++) {
+            scratch[counts[key(*c)]++] = *c;
+        }
+        std::copy(scratch.begin(), scratch.begin() + count, begin);
+    }
+    // 静态顺序的键: 写先于读, 同类按名次
+    uint32_t staticKey(const ArbitrationCandidate &c) const {
+        return (isWriteOperation(c.request.op) ? 0 : num_cores) + rank[c.request.processor_id];
+    }
+
+public:
+    explicit ArbitrationPolicy(const std::vector<int> &priorities);
+    virtual ~ArbitrationPolicy() {}
+    // 就地排列本周期的读写请求, 排在前面的先使用总线; now 为当前周期
+    virtual void order(ArbitrationCandidate *begin, ArbitrationCandidate *end, uint64_t now) = 0;
+    // 保存或恢复策略的内部状态
+    virtual void checkpoint(Checkpoint &) {}
+    // 只按优先级排序, 优先级相同时保持处理器编号顺序
+    void byPriority(ArbitrationCandidate *begin, ArbitrationCandidate *end) const;
+};
+
+// 静态优先级 (默认): 写先于读, 同类请求按优先级
+class StaticArbitration : public ArbitrationPolicy {
+public:
+    using ArbitrationPolicy::ArbitrationPolicy;
+    void order(ArbitrationCandidate *begin, ArbitrationCandidate *end, uint64_t now) override;
+};
+
+// 轮转: 从上一周期最先服务的核的下一个核开始, 按处理器编号循环
+class RoundRobinArbitration : public ArbitrationPolicy {
+private:
+    uint32_t next = 0;
+
+public:
+    using ArbitrationPolicy::ArbitrationPolicy;
+    void order(ArbitrationCandidate *begin, ArbitrationCandidate *end, uint64_t now) override;
+    void checkpoint(Checkpoint &cp) override;
+};
+
+// 按年龄: 在队列中等待最久的请求先服务, 同样久时按静态优先级
+class AgeArbitration : public ArbitrationPolicy {
+public:
+    using ArbitrationPolicy::ArbitrationPolicy;
+    void order(ArbitrationCandidate *begin, ArbitrationCandidate *end, uint64_t now) override;
+};
+
+// 彩票调度: 优先级最高的核持有 num_cores 张彩票, 依次递减到 1 张; 每个位置按彩票数加权抽取,
+// 低优先级的核也总有机会排在前面. 随机数序列固定, 结果可复现.
+// 每个位置都要在剩余候选中重新加权抽签, 因此每周期是 O(N^2), 这是唯一保留平方复杂度的策略
+class LotteryArbitration : public ArbitrationPolicy {
+private:
+    std::vector<uint32_t> tickets;      // 每核的彩票数
+    uint32_t state = 0x2545F491u;       // xorshift32
+
+public:
+    LotteryArbitration(const std::vector<int> &priorities);
+    void order(ArbitrationCandidate *begin, ArbitrationCandidate *end, uint64_t now) override;
+    void checkpoint(Checkpoint &cp) override;
+};
+
+std::unique_ptr<ArbitrationPolicy> makeArbitrationPolicy(Arbitration kind, const std::vector<int> &priorities);
+// 解析 static, rr, age, lottery
+bool parseArbitration(const std::string &text, Arbitration &kind);
+const char *arbitrationName(Arbitration kind);
+
+#endif
@@ -1,6 +1,10 @@
 #include "bus.hpp"
 #include "core.hpp"
 #include "cache.hpp"
+#include "event_log.hpp"
+#include "timing.hpp"
+#include "checkpoint.hpp"
+#include "profile.hpp"
 #include <iostream>
 #include <algorithm>
 #include <stdexcept>
@@ -8,102 +12,317 @@
 Bus::Bus(std::vector<Core *> &cores, Memory *memory, const std::vector<int> &initial_priorities) {
     this->cores = cores;
     this->memory = memory;
-    if (initial_priorities.size() != cores.size()) {
+    if (cores.size() > MAX_CORES) {
+        throw std::invalid_argument("Number of cores exceeds MAX_CORES");
+    }
+    if (initial_priorities.empty()) {
+        // 默认优先级即处理器编号
+        for (size_t i = 0; i < cores.size(); i++) {
+            priorities.push_back(i);
+        }
+    } else if (initial_priorities.size() != cores.size()) {
         throw std::invalid_argument("Priority list size must match number of cores");
+    } else {
+        this->priorities = initial_priorities;
     }
-    this->priorities = initial_priorities;
     for (Core *core : cores) {
         core->prioritiy = &priorities[core->getProcessorId()];
+        core->public_sum = &public_sum;
+        core->bus_cycle = &now;
     }
+    arbitration = makeArbitrationPolicy(arbitration_kind, priorities);
+    candidates.reserve(cores.size());
+    reads_writes.reserve(cores.size());
+    arbitration_stats.resize(cores.size());
 }
 
-uint32_t Bus::broadcast(BusRequest request, uint16_t address, int source_id, bool *shared) {
-    uint32_t response_data = 0;
+bool Bus::broadcast(BusRequest request, uint64_t address, int source_id, bool *shared, uint32_t *line,
+                    uint32_t sectors) {
+    PROFILE_SCOPE(PROF_BROADCAST);
+    cores[source_id]->getCache()->stats.bus_transactions[request]++;
+    if (directory) {
+        return directedBroadcast(request, address, source_id, shared, line, sectors);
+    }
     for (Core* core : cores) {
         if (core->getProcessorId() != source_id) {
-            response_data = core->getCache()->handleBusRequest(request, address, source_id, shared);
-            if (shared != nullptr && *shared && request == READ_MISS) {
+            probes_sent++;
+            broadcast_probes++;
+            // 读缺失在第一个提供数据的 cache 处结束
+            if (core->getCache()->handleBusRequest(request, address, source_id, shared, line, sectors) &&
+                request == READ_MISS) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// 目录模式: 只探测目录中记录的共享者, 探测顺序与广播相同 (按处理器编号),
+// 因此结果与广播总线完全一致
+bool Bus::directedBroadcast(BusRequest request, uint64_t address, int source_id, bool *shared, uint32_t *line,
+                            uint32_t sectors) {
+    const SharerMask *sharers = directory->lookup(address);
+    int others = static_cast<int>(cores.size()) - 1;
+    int first_supplier = -1;
+    // 被探测时从写回缓冲写回了该行的 cache 已不再持有它, 但遍历期间不能修改目录, 结束后再移除
+    SharerMask flushed;
+    bool any_flushed = false;
+    if (sharers != nullptr) {
+        for (int id = sharers->next(0); id >= 0; id = sharers->next(id + 1)) {
+            if (id == source_id) {
+                continue;
+            }
+            probes_sent++;
+            Cache *cache = cores[id]->getCache();
+            const WriteBackBuffer &write_back = cache->getWriteBackBuffer();
+            if (!write_back.empty() &&
+                write_back.find(address & ~static_cast<uint64_t>(cache->getGeometry().offset_mask)) >= 0) {
+                flushed.set(id);
+                any_flushed = true;
+            }
+            if (cache->handleBusRequest(request, address, source_id, shared, line, sectors) &&
+                request == READ_MISS) {
+                first_supplier = id;
                 break;
             }
         }
     }
-    return response_data;
+    // 广播总线在读缺失时探测到第一个提供数据的 cache 为止
+    if (first_supplier >= 0) {
+        broadcast_probes += first_supplier - (source_id < first_supplier ? 1 : 0) + 1;
+    } else {
+        broadcast_probes += others;
+    }
+
+    if (request == READ_MISS) {
+        directory->addSharer(address, source_id);
+    } else if (sectors != ALL_SECTORS && sharers != nullptr) {
+        // 扇区模式下被探测的 cache 可能仍持有该行的其他扇区, 只移除已不再持有该行的共享者;
+        // 先复制一份, 因为移除会修改目录
+        SharerMask probed = *sharers;
+        for (int id = probed.next(0); id >= 0; id = probed.next(id + 1)) {
+            if (id != source_id && !cores[id]->getCache()->holds(address)) {
+                directory->removeSharer(address, id);
+            }
+        }
+        directory->addSharer(address, source_id);
+    } else {
+        directory->setOwner(address, source_id);
+    }
+    if (any_flushed) {
+        for (int id = flushed.next(0); id >= 0; id = flushed.next(id + 1)) {
+            directory->removeSharer(address, id);
+        }
+    }
+    return first_supplier >= 0;
 }
 
-bool Bus::allBarriersSet() const {
-    for (const Core* core : cores) {
-        if (!core->getBarrierFlag()) {
-            return false;
+void Bus::setInterconnect(Interconnect mode) {
+    interconnect = mode;
+    if (mode == DIRECTORY_FILTER) {
+        directory.reset(new Directory(cores[0]->getCache()->getGeometry().offset_bits));
+    } else {
+        directory.reset();
+    }
+}
+
+void Bus::notifyEviction(uint64_t address, int source_id) {
+    if (directory) {
+        directory->removeSharer(address, source_id);
+    }
+}
+
+void Bus::setLastLevel(const CacheGeometry &geometry, Inclusion inclusion, Replacement kind) {
+    llc.reset(new LastLevelCache(geometry, inclusion, kind, memory, this));
+    for (Core *core : cores) {
+        core->getCache()->setLastLevel(llc.get());
+    }
+}
+
+void Bus::enableSharingDetector() {
+    sharing.reset(new SharingDetector(cores[0]->getCache()->getGeometry()));
+    for (Core *core : cores) {
+        core->getCache()->setSharingDetector(sharing.get());
+    }
+}
+
+int Bus::backInvalidate(uint64_t address) {
+    // 目录模式下只需通知记录的共享者; 先复制一份, 因为通知会修改目录
+    SharerMask sharers;
+    if (directory) {
+        const SharerMask *entry = directory->lookup(address);
+        if (entry == nullptr) {
+            return 0;
+        }
+        sharers = *entry;
+    }
+    int invalidated = 0;
+    for (Core *core : cores) {
+        int id = core->getProcessorId();
+        if (directory && !sharers.test(id)) {
+            continue;
+        }
+        if (core->getCache()->backInvalidate(address)) {
+            invalidated++;
+            notifyEviction(address, id);
         }
     }
-    return true;
+    return invalidated;
+}
+
+void Bus::printProbeStats() const {
+    uint64_t avoided = broadcast_probes - probes_sent;
+    std::cout << "\nInterconnect: " << (interconnect == DIRECTORY_FILTER ? "directory" : "broadcast")
+              << ", probes sent: " << probes_sent
+              << ", broadcast would send: " << broadcast_probes
+              << ", avoided: " << avoided;
+    if (broadcast_probes > 0) {
+        std::cout << " (" << (100.0 * avoided / broadcast_probes) << "%)";
+    }
+    std::cout << std::endl;
+}
+
+bool Bus::allBarriersSet() const {
+    return barrier_count == static_cast<int>(cores.size());
 }
 
 void Bus::arbitrate(const std::vector<Request> &requests, bool omp, bool reduction) {
-    std::vector<Request> requests_tmp = requests;
-    std::vector<Request> sorted_requests;
+    PROFILE_SCOPE(PROF_ARBITRATE);
     // 将请求加入对应处理器的请求队列
-    for (Request &request : requests_tmp) {
+    for (const Request &request : requests) {
         Core *core = cores[request.processor_id];
-        core->enqueueRequest(request);
+        core->enqueueRequest(request, now);
         // 如果当前处理器已设置了barrier, 则打印
         if (core->getBarrierFlag() || core->getQueueSize() > 1) {
-            std::cout << "\nEnqueued " << request.toString() 
-                      << " (Priority: " << priorities[request.processor_id] 
-                      << ", Type: " << (request.op == BARRIER ? "BARRIER" : 
-                                        request.op == WRITE ? "WRITE" : "READ") << ")" << std::endl;
+            if (verbose) {
+                std::cout << "\nEnqueued " << request.toString() 
+                          << " (Priority: " << priorities[request.processor_id] 
+                          << ", Type: " << operationType(request.op) << ")\n";
+            }
+            if (log != nullptr) {
+                log->request(LOG_ENQUEUE, request, request.processor_id, priorities[request.processor_id]);
+            }
         }
     }
-    // 遍历所有处理器，获取未设置barrier且队列不为空的请求
+    // 遍历所有处理器，获取未设置barrier且队列不为空的请求.
+    // barrier 稳定地排在最前面: 读写请求先暂存, 遍历结束后接在 barrier 之后
+    candidates.clear();
+    reads_writes.clear();
     for (Core* core : cores) {
-        if (!core->getBarrierFlag() && !core->isQueueEmpty()) {
-            sorted_requests.push_back(core->dequeueRequest());
-        }
-    }
-    // 按 barrier > write > read 和处理器优先级排序新请求
-    std::sort(sorted_requests.begin(), sorted_requests.end(), 
-              [this](const Request &a, const Request &b) {
-                  if (a.op != b.op) {
-                      if (a.op == BARRIER) return true;
-                      if (b.op == BARRIER) return false;
-                      return a.op == WRITE;
-                  }
-                  return priorities[a.processor_id] < priorities[b.processor_id];
-              });
-
-    // 遍历排序后的请求
-    for (Request &request : sorted_requests) {
+        if (core->getBarrierFlag()) {
+            core->getCache()->stats.barrier_stall_cycles++;
+        } else if (!core->isQueueEmpty()) {
+            QueuedRequest queued = core->dequeueRequest();
+            (queued.request.op == BARRIER ? candidates : reads_writes).push_back({queued.request, queued.enqueued});
+        }
+    }
+    size_t barriers = candidates.size();
+    candidates.insert(candidates.end(), reads_writes.begin(), reads_writes.end());
+    // barrier 按优先级排序; 其余读写请求的先后由仲裁策略决定
+    ArbitrationCandidate *begin = candidates.data();
+    arbitration->byPriority(begin, begin + barriers);
+    arbitration->order(begin + barriers, begin + candidates.size(), now);
+
+    // 按仲裁顺序执行
+    for (size_t k = 0; k < candidates.size(); k++) {
+        Request &request = candidates[k].request;
         Core *core = cores[request.processor_id];
-        // if (!core->getBarrierFlag() && core->isQueueEmpty()) {
-        //     // 未设置 barrier 且队列为空，直接执行
-        //     std::cout << "\nExecuting directly " << request.toString() 
-        //               << " (Priority: " << priorities[request.processor_id] 
-        //               << ", Type: " << (request.op == BARRIER ? "BARRIER" : 
-        //                                 request.op == WRITE ? "WRITE" : "READ") << ")" << std::endl;
-        //     core->executeRequest(request);
-        // } else {
-        //     // 否则压入队列
-        //     core->enqueueRequest(request);
-        //     std::cout << "\nEnqueued " << request.toString() 
-        //               << " (Priority: " << priorities[request.processor_id] 
-        //               << ", Type: " << (request.op == BARRIER ? "BARRIER" : 
-        //                                 request.op == WRITE ? "WRITE" : "READ") << ")" << std::endl;
-        //     // 如果未设置 barrier，执行队列中的第一条请求
-        //     if (!core->getBarrierFlag() && !core->isQueueEmpty()) {
-        //         Request req = core->dequeueRequest();
-        //         core->executeRequest(req);
-        //     }
-        // }
+        ArbitrationStats &stats = arbitration_stats[request.processor_id];
+        uint64_t wait = now - candidates[k].enqueued;
+        stats.grants++;
+        stats.wait_cycles += wait;
+        stats.max_wait = std::max(stats.max_wait, wait);
+        stats.preceded += k;
         core->executeRequest(request, omp, reduction);
+        // 只有未设置 barrier 的核会被调度, 因此每条 barrier 请求恰好置位一次
+        if (request.op == BARRIER) {
+            barrier_count++;
+        }
+    }
+
+    issuePrefetches();
+
+    // 写回缓冲在后台每周期写回一项
+    for (Core *core : cores) {
+        core->getCache()->drainWriteBack(1);
     }
 
     // 检查所有核心的 barrier 状态
     bool all_barriers = allBarriersSet();
     if (all_barriers) {
-        std::cout << "\nAll barriers set, clearing barriers\n";
+        if (verbose) {
+            std::cout << "\nAll barriers set, clearing barriers\n";
+        }
+        if (log != nullptr) {
+            log->clearBarriers();
+        }
+        if (timing != nullptr) {
+            timing->releaseBarrier();
+        }
         for (Core* core : cores) {
             core->clearBarrier();
         }
+        barrier_count = 0;
+    }
+}
+
+// 每个 cache 每周期最多发出一个预取, 排在本周期所有需求请求之后:
+// 需求访问刚放入队列的候选当周期就能发出, 不会在同一周期被需求缺失抢先装入
+void Bus::issuePrefetches() {
+    candidates.clear();
+    for (Core *core : cores) {
+        uint64_t address;
+        if (core->getCache()->nextPrefetch(address)) {
+            candidates.push_back({Request(core->getProcessorId(), PREFETCH, address), now});
+        }
+    }
+    arbitration->byPriority(candidates.data(), candidates.data() + candidates.size());
+    for (ArbitrationCandidate &candidate : candidates) {
+        cores[candidate.request.processor_id]->executeRequest(candidate.request);
+    }
+}
+
+void Bus::setOutput(bool verbose, EventLog *log) {
+    this->verbose = verbose;
+    this->log = log;
+    for (Core *core : cores) {
+        core->setOutput(verbose, log);
+        core->getCache()->setEventLog(log);
+    }
+}
+
+void Bus::setTiming(TimingModel *timing) {
+    this->timing = timing;
+    for (Core *core : cores) {
+        core->setTiming(timing);
+    }
+}
+
+void Bus::checkpoint(Checkpoint &cp) {
+    cp.array(priorities);
+    if (cp.isLoading()) {
+        // 名次、彩票数等由优先级导出的状态按恢复的优先级重新计算, 再读回策略自己的状态
+        arbitration = makeArbitrationPolicy(arbitration_kind, priorities);
+    }
+    cp.value(public_sum);
+    cp.value(barrier_count);
+    cp.value(probes_sent);
+    cp.value(broadcast_probes);
+    for (ArbitrationStats &stats : arbitration_stats) {
+        cp.value(stats.grants);
+        cp.value(stats.wait_cycles);
+        cp.value(stats.max_wait);
+        cp.value(stats.preceded);
+    }
+    arbitration->checkpoint(cp);
+    if (directory) {
+        directory->checkpoint(cp);
+    }
+    if (llc) {
+        llc->checkpoint(cp);
+    }
+    if (sharing) {
+        sharing->checkpoint(cp);
     }
 }
 
@@ -112,4 +331,23 @@ void Bus::setPriorities(const std::vector<int> &new_priorities) {
         throw std::invalid_argument("New priority list size must match number of cores");
     }
     priorities = new_priorities;
+    // 彩票数等由优先级导出的状态需要重新计算
+    arbitration = makeArbitrationPolicy(arbitration_kind, priorities);
+}
+
+void Bus::setArbitration(Arbitration kind) {
+    arbitration_kind = kind;
+    arbitration = makeArbitrationPolicy(kind, priorities);
+}
+
+void Bus::printArbitrationStats() const {
+    std::cout << "\nArbitration (" << arbitrationName(arbitration_kind) << "):\n";
+    std::cout << "Core\tGrants\tAvgWait\tMaxWait\tAvgAhead\n";
+    for (size_t id = 0; id < arbitration_stats.size(); id++) {
+        const ArbitrationStats &stats = arbitration_stats[id];
+        double grants = stats.grants > 0 ? static_cast<double>(stats.grants) : 1.0;
+        std::cout << "P" << id << "\t" << stats.grants << "\t" << (stats.wait_cycles / grants) << "\t"
+                  << stats.max_wait << "\t" << (stats.preceded / grants) << "\n";
+    }
+    std::cout << std::flush;
 }
\ No newline at end of file
@@ -2,24 +2,82 @@
 #define BUS_HPP
 
 #include <vector>
+#include <memory>
 #include "common.hpp"
+#include "arbitration.hpp"
+#include "directory.hpp"
+#include "llc.hpp"
+#include "sharing.hpp"
 #include "request.hpp"
+#include "stats.hpp"
 
 class Core;
 class Memory;
+class EventLog;
+class TimingModel;
+class Checkpoint;
 
 class Bus {
 private:
     std::vector<Core *> cores;
     Memory *memory;
     std::vector<int> priorities;
+    uint16_t public_sum = 0;            // -omp -r 模式下的共享归约结果
+    Interconnect interconnect = BROADCAST_BUS;
+    std::unique_ptr<Directory> directory;
+    std::unique_ptr<LastLevelCache> llc;
+    std::unique_ptr<SharingDetector> sharing;
+    int barrier_count = 0;              // 已设置 barrier 的核数
+    uint64_t now = 0;                   // 当前周期, 由 beginCycle 设置
+    Arbitration arbitration_kind = ARB_STATIC;
+    std::unique_ptr<ArbitrationPolicy> arbitration;
+    // 每周期参与仲裁的请求 (预取另外一轮使用), 各预留核数项, 仲裁路径上不分配内存
+    std::vector<ArbitrationCandidate> candidates;
+    std::vector<ArbitrationCandidate> reads_writes;     // 本周期的读写请求, 暂存以便排在 barrier 之后
+    std::vector<ArbitrationStats> arbitration_stats;
+    bool verbose = true;
+    EventLog *log = nullptr;
+    TimingModel *timing = nullptr;
+
+    bool directedBroadcast(BusRequest request, uint64_t address, int source_id, bool *shared, uint32_t *line,
+                           uint32_t sectors);
 
 public:
-    Bus(std::vector<Core *> &cores, Memory *memory, const std::vector<int> &initial_priorities = {0, 1, 2, 3});
-    uint32_t broadcast(BusRequest request, uint16_t address, int source_id, bool *shared = nullptr);
+    uint64_t probes_sent = 0;           // 实际调用 handleBusRequest 的次数
+    uint64_t broadcast_probes = 0;      // 同样的事件在广播总线上需要的探测次数
+
+    Bus(std::vector<Core *> &cores, Memory *memory, const std::vector<int> &initial_priorities = {});
+    // 返回是否有 cache 提供了数据; sectors 为请求涉及的扇区位图
+    bool broadcast(BusRequest request, uint64_t address, int source_id, bool *shared = nullptr, uint32_t *line = nullptr,
+                   uint32_t sectors = ALL_SECTORS);
     void arbitrate(const std::vector<Request> &requests, bool omp = false, bool reduction = false);
+    // 各 cache 发出预取队列中的下一项; arbitrate 在需求请求之后调用, 没有请求的周期由模拟器直接调用
+    void issuePrefetches();
     void setPriorities(const std::vector<int> &new_priorities);
+    // 每周期仲裁前调用, 入队的请求记录该周期
+    void beginCycle(uint64_t cycle) { now = cycle; }
+    void setArbitration(Arbitration kind);
+    Arbitration getArbitration() const { return arbitration_kind; }
+    const std::vector<ArbitrationStats> &getArbitrationStats() const { return arbitration_stats; }
+    void printArbitrationStats() const;
     bool allBarriersSet() const;
+    void setInterconnect(Interconnect mode);
+    Interconnect getInterconnect() const { return interconnect; }
+    void notifyEviction(uint64_t address, int source_id);
+    // 在总线与内存之间加入共享 LLC, 并接到所有 cache 上
+    void setLastLevel(const CacheGeometry &geometry, Inclusion inclusion, Replacement kind);
+    const LastLevelCache *getLastLevel() const { return llc.get(); }
+    // 开启伪共享检测, 接到所有 cache 上
+    void enableSharingDetector();
+    const SharingDetector *getSharingDetector() const { return sharing.get(); }
+    // 包含式 LLC 替换一行时无效化所有 L1 中的副本, 返回被无效化的副本数
+    int backInvalidate(uint64_t address);
+    void printProbeStats() const;
+    // 设置总线、所有核与 cache 的输出方式: 逐请求打印和/或事件日志
+    void setOutput(bool verbose, EventLog *log);
+    void setTiming(TimingModel *timing);
+    // 保存或恢复优先级、归约结果、barrier 计数、探测计数、仲裁状态和目录 (不含各核与 cache)
+    void checkpoint(Checkpoint &cp);
 };
 
 #endif
\ No newline at end of file
@@ -1,190 +1,788 @@
 #include "cache.hpp"
 #include "memory.hpp"
 #include "bus.hpp"
+#include "llc.hpp"
+#include "event_log.hpp"
+#include "tag_match.hpp"
+#include "sharing.hpp"
+#include "checkpoint.hpp"
+#include "profile.hpp"
 #include <iostream>
 #include <iomanip>
+#include <algorithm>
+#include <cstring>
 
-Cache::Cache(int id) {
+Cache::Cache(int id, const CacheGeometry &geometry) : geometry(geometry), bus(nullptr), memory(nullptr) {
     processor_id = id;
-    int blocks_num = 64 / block_size;
-    int sets_num = blocks_num / 2;
-    cache.resize(sets_num);
-}
-
-uint32_t Cache::handleBusRequest(BusRequest request, uint16_t address, int source_id, bool *shared) {
-    if (source_id == processor_id) {return 0;}
-
-    uint16_t index = (address >> 2) & 0x7;
-    uint16_t tag = (address >> 5) & 0xFF;
-    Set &set = cache[index];
-
-    for (Block &block : set.blocks) {
-        if (block.tag == tag) {
-            switch (request) {
-                case READ_MISS: {
-                    if (block.state == SHARED || block.state == EXCLUSIVE) {
-                        block.state = SHARED;
-                        if (shared != nullptr) {
-                            *shared = true;
-                        }
-                        return block.data;
-                    } else if (block.state == MODIFIED) {
-                        memory->writeOneBlock(address, block.data);
-                        block.state = SHARED;
-                        if (shared != nullptr) {
-                            *shared = true;
-                        }
-                        return block.data;
-                    }
-                    break;
-                }
-                case WRITE_MISS: {
-                    if (block.state == SHARED || block.state == EXCLUSIVE) {
-                        block.state = INVALID;
-                        return 0;
-                    } else if (block.state == MODIFIED) {
-                        memory->writeOneBlock(address, block.data);
-                        block.state = INVALID;
-                        return 0;
-                    }
-                    break;
-                }
-                case SET_INVALID: {
-                    block.state = INVALID;
-                    return 0;
-                }
-                default: break;
-            }
-        }
+    replacement = makeReplacementPolicy(replacement_kind, geometry, id);
+    tag_stride = tagStride(geometry.ways);
+    tags.resize(geometry.sets * tag_stride, 0);
+    tag_keys.resize(tags.size(), 0);
+    states.resize(geometry.sets * tag_stride, INVALID);
+    lru_stamps.resize(geometry.sets * geometry.ways, 0);
+    line_store.resize(geometry.sets * geometry.ways * geometry.words_per_line, 0);
+    if (sameGeometry<DefaultGeometry>(geometry)) {
+        usePaths<DefaultGeometry>();
+    } else if (sameGeometry<L1Geometry32K>(geometry)) {
+        usePaths<L1Geometry32K>();
+    } else if (sameGeometry<L1Geometry64K>(geometry)) {
+        usePaths<L1Geometry64K>();
+    } else {
+        usePaths<RuntimeGeometry>();
     }
-    return 0;
 }
 
-bool Cache::access(uint16_t address, Operation op, uint16_t write_data, uint16_t* read_data) {
-    access_count++;
-    uint16_t offset = address & 0x3;
-    uint16_t index = (address >> 2) & 0x7;
-    uint16_t tag = (address >> 5) & 0xFF;
+template <typename Fixed>
+void Cache::usePaths() {
+    access_path = &Cache::accessLine<Fixed>;
+    snoop_path = &Cache::snoopLine<Fixed>;
+}
+
+template <typename Fixed>
+int Cache::findWayIn(uint32_t index, uint64_t tag) const {
+    const CacheGeometry &g = geometryOf<Fixed>(geometry);
+    uint32_t base = index * tagStride(g.ways);
+    return matchTag(&tag_keys[base], &tags[base], &states[base], g.ways, tag);
+}
+
+void Cache::setTag(uint32_t index, uint32_t way, uint64_t tag) {
+    tags[slot(index, way)] = tag;
+    tag_keys[slot(index, way)] = tagKey(tag);
+}
 
-    Set &set = cache[index];
-    bool hit = false;
-    int block_index = -1;
+bool Cache::handleBusRequest(BusRequest request, uint64_t address, int source_id, bool *shared, uint32_t *line,
+                             uint32_t sectors) {
+    PROFILE_SCOPE(PROF_SNOOP);
+    if (source_id == processor_id) {return false;}
+    return (this->*snoop_path)(request, address, source_id, shared, line, sectors);
+}
 
-    for (int i = 0; i < 2; i++) {
-        if (set.blocks[i].state != INVALID && set.blocks[i].tag == tag) {
-            hit = true;
-            block_index = i;
-            break;
+template <typename Fixed>
+bool Cache::snoopLine(BusRequest request, uint64_t address, int source_id, bool *shared, uint32_t *line,
+                      uint32_t sectors) {
+    const CacheGeometry &g = geometryOf<Fixed>(geometry);
+    uint32_t index = g.indexOf(address);
+    int way = findWayIn<Fixed>(index, g.tagOf(address));
+    if (way < 0) {
+        // 该行可能刚被替换, 还在写回缓冲中: 先写回下一级, 请求者随后从下一级读到最新数据
+        flushWriteBack(address & ~static_cast<uint64_t>(g.offset_mask), false);
+        return false;
+    }
+    if (!sector_states.empty()) {
+        return snoopSectors(request, address, sectors, index, way, shared, line);
+    }
+    int words = g.words_per_line;
+    uint8_t &state = states[slot(index, way)];
+    uint32_t *data = lineData(index, way);
+
+    const SnoopAction &action = protocol->snoop[request][state];
+    if (action.writeback) {
+        writeBackLine(address, data);
+        stats.writebacks++;
+    }
+    bool changed = action.next != state;
+    state = action.next;
+    if (action.next == INVALID) {
+        stats.invalidations_received++;
+        breakLink(address & ~static_cast<uint64_t>(g.offset_mask));
+        if (sharing != nullptr && request != READ_MISS) {
+            sharing->classify(address & ~static_cast<uint64_t>(g.offset_mask), processor_id,
+                              touched_words[blockId(index, way)], written_words[blockId(index, way)]);
+        }
+        if (!prefetched.empty() && prefetched[blockId(index, way)]) {
+            prefetched[blockId(index, way)] = 0;
+            prefetch_stats.useless_invalidations++;
         }
     }
+    if (log != nullptr && changed) {
+        logBlock(index, way);
+    }
+    if (action.shared && shared != nullptr) {
+        *shared = true;
+    }
+    if (action.supply && line != nullptr) {
+        std::copy(data, data + words, line);
+    }
+    return action.supply;
+}
+
+bool Cache::access(uint64_t address, Operation op, uint16_t write_data, uint16_t* read_data) {
+    PROFILE_SCOPE(PROF_ACCESS);
+    if (!sector_states.empty()) {
+        return accessSectors(address, op, write_data, read_data);
+    }
+    return (this->*access_path)(address, op, write_data, read_data);
+}
+
+template <typename Fixed>
+bool Cache::accessLine(uint64_t address, Operation op, uint16_t write_data, uint16_t *read_data) {
+    const CacheGeometry &g = geometryOf<Fixed>(geometry);
+    access_count++;
+    int offset = g.offsetOf(address) >> 1;   // 行内半字下标
+    uint32_t index = g.indexOf(address);
+    uint64_t tag = g.tagOf(address);
+    last_access = AccessInfo();
+    last_access.line = address & ~static_cast<uint64_t>(g.offset_mask);
+    last_access.write = op != READ;
+    last_access.atomic = op == FETCH_ADD || op == CAS;
 
-    Block *block_ptr = nullptr;
+    int way = findWayIn<Fixed>(index, tag);
+    bool hit = way >= 0;
+    bool first_use = false;     // 第一次命中预取装入的行
     if (hit) {
-        block_ptr = &set.blocks[block_index];
-        block_ptr->lru_counter = access_count;
+        uint8_t &state = states[slot(index, way)];
+        uint32_t *data = lineData(index, way);
+        lru_stamps[blockId(index, way)] = access_count;
+        replacement->touch(index, way);
+        if (!prefetched.empty() && prefetched[blockId(index, way)]) {
+            prefetched[blockId(index, way)] = 0;
+            prefetch_stats.useful++;
+            first_use = true;
+        }
+        if (sharing != nullptr) {
+            recordWords(index, way, address, op != READ);
+        }
         if (op == READ) {
-            if (block_ptr->state == SHARED || block_ptr->state == EXCLUSIVE || block_ptr->state == MODIFIED) {
-                if (read_data != nullptr) {
-                    *read_data = block_ptr->readTwoBytes(offset);
-                }
+            if (read_data != nullptr) {
+                *read_data = readTwoBytes(data, offset);
             }
-            read_hit_count++;
+            stats.read_hits++;
         } else {
-            if (block_ptr->state == SHARED) {
-                block_ptr->state = MODIFIED;
-                block_ptr->writeTwoBytes(offset, write_data);
-                bus->broadcast(SET_INVALID, address, processor_id);
-            } else if (block_ptr->state == EXCLUSIVE || block_ptr->state == MODIFIED) {
-                block_ptr->state = MODIFIED;
-                block_ptr->writeTwoBytes(offset, write_data);
+            const WriteHitAction &action = protocol->write_hit[state];
+            state = action.next;
+            writeValue(data, offset, op, write_data, read_data);
+            if (action.bus_request >= 0) {
+                bus->broadcast(static_cast<BusRequest>(action.bus_request), address, processor_id);
+                stats.upgrades++;
+                last_access.bus_request = action.bus_request;
             }
-            write_hit_count++;
+            stats.write_hits++;
         }
     } else {
-        int lruTarget = 0;
-        if (set.blocks[0].state == INVALID || set.blocks[1].state == INVALID) {
-            lruTarget = (set.blocks[0].state == INVALID) ? 0 : 1;
-        } else {
-            lruTarget = (set.blocks[0].lru_counter < set.blocks[1].lru_counter) ? 0 : 1;
+        way = allocate(index);
+        uint8_t &state = states[slot(index, way)];
+        uint32_t *data = lineData(index, way);
+        if (sharing != nullptr) {
+            recordWords(index, way, address, op != READ);
         }
-        Block& victim = set.blocks[lruTarget];
-        
         if (op == READ) {
-            if (victim.state == MODIFIED) {
-                memory->writeOneBlock(address, victim.data);
-            }
             bool shared = false;
-            uint32_t response_data = bus->broadcast(READ_MISS, address, processor_id, &shared);
-            if (shared) {
-                victim.state = SHARED;
-                victim.tag = tag;
-                victim.lru_counter = access_count;
-                victim.data = response_data;
+            bool supplied = bus->broadcast(READ_MISS, address, processor_id, &shared, data);
+            state = protocol->read_fill[shared];
+            setTag(index, way, tag);
+            if (supplied) {
+                stats.cache_to_cache++;
+                last_access.cache_to_cache = true;
             } else {
-                victim.state = EXCLUSIVE;
-                victim.tag = tag;
-                victim.lru_counter = access_count;
-                victim.data = memory->readOneBlock(address);
+                fillLine(address, data);
+                stats.memory_fills++;
             }
             if (read_data != nullptr) {
-                *read_data = victim.readTwoBytes(offset);
+                *read_data = readTwoBytes(data, offset);
             }
-            read_miss_count++;
+            stats.read_misses++;
+            last_access.bus_request = READ_MISS;
         } else {
-            if (victim.state == MODIFIED) {
-                memory->writeOneBlock(address, victim.data);
-            }
             bus->broadcast(WRITE_MISS, address, processor_id);
-            victim.state = MODIFIED;
-            victim.tag = tag;
-            victim.lru_counter = access_count;
-            victim.data = memory->readOneBlock(address);
-            victim.writeTwoBytes(offset, write_data);
-            write_miss_count++;
+            state = MODIFIED;
+            setTag(index, way, tag);
+            fillLine(address, data);
+            stats.memory_fills++;
+            writeValue(data, offset, op, write_data, read_data);
+            stats.write_misses++;
+            last_access.bus_request = WRITE_MISS;
+        }
+        lru_stamps[blockId(index, way)] = access_count;
+        replacement->insert(index, way);
+    }
+    last_access.hit = hit;
+    if (log != nullptr) {
+        logBlock(index, way);
+    }
+    if (prefetcher) {
+        candidates.clear();
+        prefetcher->observe(last_access.line, !hit || first_use, candidates);
+        for (uint64_t line : candidates) {
+            queuePrefetch(line);
+        }
+    }
+    return hit;
+}
+
+void Cache::writeValue(uint32_t *line, int offset, Operation op, uint16_t data, uint16_t *read_data) {
+    if (op == WRITE) {
+        writeTwoBytes(line, offset, data);
+        return;
+    }
+    uint16_t old_value = readTwoBytes(line, offset);
+    if (read_data != nullptr) {
+        *read_data = old_value;
+    }
+    if (op == FETCH_ADD) {
+        writeTwoBytes(line, offset, static_cast<uint16_t>(old_value + data));
+    } else if (old_value == rmw_compare) {
+        writeTwoBytes(line, offset, data);
+    } else {
+        stats.cas_failures++;
+    }
+}
+
+bool Cache::atomic(uint64_t address, Operation op, uint16_t data, uint16_t compare, uint16_t *old_value) {
+    uint64_t line_address = address & ~static_cast<uint64_t>(geometry.offset_mask);
+    if (op == LL) {
+        bool hit = access(address, READ, 0, old_value);
+        stats.load_links++;
+        link_line = line_address;
+        link_valid = true;
+        return hit;
+    }
+    if (op == SC) {
+        bool linked = link_valid && link_line == line_address;
+        link_valid = false;
+        if (old_value != nullptr) {
+            *old_value = linked;
+        }
+        if (!linked) {
+            // 链接已失效: 不访问总线也不写入, 但与其他访问一样推进 LRU 时钟, 分片回放时按访问序号恢复时钟
+            access_count++;
+            last_access = AccessInfo();
+            last_access.line = line_address;
+            last_access.hit = true;
+            stats.sc_failures++;
+            return true;
         }
+        stats.store_conditionals++;
+        return access(address, WRITE, data);
+    }
+    // 整个读-改-写在取得独占所有权后由一次 access 完成, 其间没有其他核的请求插入, 因此缓存锁本身不需要额外的状态
+    rmw_compare = compare;
+    bool hit = access(address, op, data, old_value);
+    stats.atomics++;
+    if (atomic_lock == LOCK_BUS) {
+        last_access.bus_lock = true;
+        stats.bus_locks++;
+    }
+    return hit;
+}
+
+uint32_t Cache::allocate(uint32_t index) {
+    // 优先选择无效块, 否则由替换策略选择
+    const uint8_t *set_states = &states[slot(index, 0)];
+    const void *first_invalid = std::memchr(set_states, INVALID, geometry.ways);
+    uint32_t way = first_invalid != nullptr ? static_cast<const uint8_t *>(first_invalid) - set_states
+                                            : replacement->victim(index);
+    uint8_t state = states[slot(index, way)];
+    uint32_t *data = lineData(index, way);
+    bool dirty = protocol->dirty[state];
+    if (state != INVALID) {
+        // 写回使用被替换行自己的地址, 而不是本次访问的地址
+        uint64_t victim_address = geometry.lineAddress(tags[slot(index, way)], index);
+        breakLink(victim_address);
+        if (dirty && write_back.enabled()) {
+            // 排空时才通知目录, 以便该行在写回之前仍能被监听到
+            if (write_back.full()) {
+                write_back.full_drains++;
+                drainWriteBack(1);
+            }
+            write_back.push(victim_address, data);
+        } else {
+            bus->notifyEviction(victim_address, processor_id);
+            if (llc != nullptr) {
+                llc->evict(victim_address, data, dirty);
+            } else if (dirty && !sector_states.empty()) {
+                writeSectors(victim_address, data, dirty_sectors[blockId(index, way)]);
+            } else if (dirty) {
+                memory->writeLine(victim_address, data, geometry.words_per_line);
+            }
+        }
+        if (!prefetched.empty() && prefetched[blockId(index, way)]) {
+            prefetch_stats.unused_evictions++;
+        }
+    }
+    if (!prefetched.empty()) {
+        prefetched[blockId(index, way)] = 0;
+    }
+    if (sharing != nullptr) {
+        touched_words[blockId(index, way)] = 0;
+        written_words[blockId(index, way)] = 0;
+    }
+    if (!sector_states.empty()) {
+        uint8_t *block_sectors = &sector_states[blockId(index, way) * sectors];
+        std::fill(block_sectors, block_sectors + sectors, INVALID);
+        valid_sectors[blockId(index, way)] = 0;
+        dirty_sectors[blockId(index, way)] = 0;
+    }
+
+    last_access.writeback = dirty;
+    if (dirty) {
+        stats.writebacks++;
+    }
+    // 本 cache 早先替换出的该行可能还在写回缓冲中, 先写回, 之后从下一级读到的才是最新数据
+    flushWriteBack(last_access.line, true);
+    return way;
+}
+
+void Cache::setSharingDetector(SharingDetector *detector) {
+    sharing = detector;
+    touched_words.assign(detector != nullptr ? geometry.sets * geometry.ways : 0, 0);
+    written_words.assign(touched_words.size(), 0);
+}
+
+void Cache::recordWords(uint32_t index, uint32_t way, uint64_t address, bool write) {
+    uint64_t bit = sharing->wordBit(address);
+    uint32_t block = blockId(index, way);
+    touched_words[block] |= bit;
+    if (write) {
+        written_words[block] |= bit;
+        sharing->beginWrite(processor_id, touched_words[block], written_words[block]);
+    }
+}
+
+void Cache::setSectors(uint32_t count) {
+    sectors = count;
+    sector_halves = geometry.line_bytes / 2 / count;
+    size_t blocks = count > 1 ? geometry.sets * geometry.ways : 0;
+    sector_states.assign(blocks * count, INVALID);
+    valid_sectors.assign(blocks, 0);
+    dirty_sectors.assign(blocks, 0);
+    sector_fill.assign(count > 1 ? geometry.words_per_line : 0, 0);
+    sector_merge.assign(sector_fill.size(), 0);
+}
+
+bool Cache::accessSectors(uint64_t address, Operation op, uint16_t write_data, uint16_t *read_data) {
+    access_count++;
+    int offset = geometry.offsetOf(address) >> 1;
+    uint32_t index = geometry.indexOf(address);
+    uint64_t tag = geometry.tagOf(address);
+    uint32_t sector_mask = 1u << (offset / sector_halves);
+    last_access = AccessInfo();
+    last_access.line = address & ~static_cast<uint64_t>(geometry.offset_mask);
+    last_access.write = op != READ;
+    last_access.atomic = op == FETCH_ADD || op == CAS;
+
+    int way = findWay(index, tag);
+    bool present = way >= 0;
+    if (!present) {
+        way = allocate(index);
+        setTag(index, way, tag);
+    }
+    uint32_t block = blockId(index, way);
+    bool hit = (valid_sectors[block] & sector_mask) != 0;
+    if (present && !hit) {
+        stats.sector_misses++;
+    }
+    uint8_t &state = sector_states[block * sectors + (offset / sector_halves)];
+    uint32_t *data = lineData(index, way);
+    lru_stamps[block] = access_count;
+    if (present) {
+        replacement->touch(index, way);
+    } else {
+        replacement->insert(index, way);
+    }
+    if (sharing != nullptr) {
+        recordWords(index, way, address, op != READ);
+    }
+
+    // 与整行模式相同的转移, 只作用于被访问的扇区; 缺失只取回该扇区, 块中其他扇区保持不变
+    if (hit && op == READ) {
+        stats.read_hits++;
+    } else if (hit) {
+        const WriteHitAction &action = protocol->write_hit[state];
+        state = action.next;
+        if (action.bus_request >= 0) {
+            bus->broadcast(static_cast<BusRequest>(action.bus_request), address, processor_id, nullptr, nullptr,
+                           sector_mask);
+            stats.upgrades++;
+            last_access.bus_request = action.bus_request;
+        }
+        stats.write_hits++;
+    } else if (op == READ) {
+        bool shared = false;
+        bool supplied = bus->broadcast(READ_MISS, address, processor_id, &shared, sector_fill.data(), sector_mask);
+        state = protocol->read_fill[shared];
+        if (supplied) {
+            stats.cache_to_cache++;
+            last_access.cache_to_cache = true;
+        } else {
+            fillLine(address, sector_fill.data());
+            stats.memory_fills++;
+        }
+        copySectors(data, sector_fill.data(), sector_mask);
+        stats.read_misses++;
+        last_access.bus_request = READ_MISS;
+    } else {
+        bus->broadcast(WRITE_MISS, address, processor_id, nullptr, nullptr, sector_mask);
+        state = MODIFIED;
+        fillLine(address, sector_fill.data());
+        copySectors(data, sector_fill.data(), sector_mask);
+        stats.memory_fills++;
+        stats.write_misses++;
+        last_access.bus_request = WRITE_MISS;
+    }
+    if (op == READ) {
+        if (read_data != nullptr) {
+            *read_data = readTwoBytes(data, offset);
+        }
+    } else {
+        writeValue(data, offset, op, write_data, read_data);
+    }
+    updateSectors(index, way);
+    last_access.hit = hit;
+    if (log != nullptr) {
+        logBlock(index, way);
     }
     return hit;
 }
 
+bool Cache::snoopSectors(BusRequest request, uint64_t address, uint32_t mask, uint32_t index, uint32_t way,
+                         bool *shared, uint32_t *line) {
+    uint32_t block = blockId(index, way);
+    uint32_t present = mask & valid_sectors[block];
+    uint32_t supplied = 0;
+    uint32_t written_back = 0;
+    bool invalidated = false;
+    bool changed = false;
+    for (uint32_t s = 0; s < sectors; s++) {
+        if (((present >> s) & 1) == 0) {
+            continue;
+        }
+        uint8_t &state = sector_states[block * sectors + s];
+        const SnoopAction &action = protocol->snoop[request][state];
+        changed |= action.next != state;
+        state = action.next;
+        invalidated |= action.next == INVALID;
+        if (action.writeback) {
+            written_back |= 1u << s;
+        }
+        if (action.supply) {
+            supplied |= 1u << s;
+        }
+        if (action.shared && shared != nullptr) {
+            *shared = true;
+        }
+    }
+    uint32_t *data = lineData(index, way);
+    if (written_back != 0) {
+        writeSectors(address, data, written_back);
+        stats.writebacks++;
+    }
+    if (supplied != 0 && line != nullptr) {
+        copySectors(line, data, supplied);
+    }
+    if (invalidated) {
+        // 一次请求无效化若干扇区只算一次, 与整行模式直接可比
+        stats.invalidations_received++;
+        // 链接按行记录, 任一扇区被无效化都使其失效
+        breakLink(address & ~static_cast<uint64_t>(geometry.offset_mask));
+        if (sharing != nullptr && request != READ_MISS) {
+            sharing->classify(address & ~static_cast<uint64_t>(geometry.offset_mask), processor_id,
+                              touched_words[block], written_words[block]);
+        }
+    }
+    updateSectors(index, way);
+    if (log != nullptr && changed) {
+        logBlock(index, way);
+    }
+    // 请求方每次只请求一个扇区, 提供了数据即满足了整个请求
+    return supplied != 0;
+}
+
+void Cache::copySectors(uint32_t *dst, const uint32_t *src, uint32_t mask) const {
+    for (uint32_t s = 0; s < sectors; s++) {
+        if ((mask >> s) & 1) {
+            for (uint32_t h = s * sector_halves; h < (s + 1) * sector_halves; h++) {
+                writeTwoBytes(dst, h, readTwoBytes(src, h));
+            }
+        }
+    }
+}
+
+void Cache::writeSectors(uint64_t address, const uint32_t *data, uint32_t mask) {
+    memory->readLine(address, sector_merge.data(), geometry.words_per_line);
+    copySectors(sector_merge.data(), data, mask);
+    memory->writeLine(address, sector_merge.data(), geometry.words_per_line);
+}
+
+void Cache::updateSectors(uint32_t index, uint32_t way) {
+    // 块状态取最强的扇区状态: 有脏扇区时块状态也是脏的, 替换时才会写回
+    static const int strength[NUM_STATES] = {5, 3, 1, 0, 4, 2};     // M E S I O F
+    uint32_t block = blockId(index, way);
+    const uint8_t *block_sectors = &sector_states[block * sectors];
+    uint8_t strongest = INVALID;
+    uint32_t valid = 0;
+    uint32_t dirty = 0;
+    for (uint32_t s = 0; s < sectors; s++) {
+        uint8_t state = block_sectors[s];
+        if (state != INVALID) {
+            valid |= 1u << s;
+        }
+        if (protocol->dirty[state]) {
+            dirty |= 1u << s;
+        }
+        if (strength[state] > strength[strongest]) {
+            strongest = state;
+        }
+    }
+    valid_sectors[block] = valid;
+    dirty_sectors[block] = dirty;
+    states[slot(index, way)] = strongest;
+}
+
+void Cache::setPrefetcher(Prefetch kind, uint32_t degree) {
+    prefetch_kind = kind;
+    prefetcher = makePrefetcher(kind, geometry, degree);
+    prefetched.assign(prefetcher ? geometry.sets * geometry.ways : 0, 0);
+    prefetch_queue.clear();
+}
+
+void Cache::queuePrefetch(uint64_t line_address) {
+    if (findWay(geometry.indexOf(line_address), geometry.tagOf(line_address)) >= 0 ||
+        std::find(prefetch_queue.begin(), prefetch_queue.end(), line_address) != prefetch_queue.end()) {
+        return;
+    }
+    if (prefetch_queue.size() >= PREFETCH_QUEUE_SIZE) {
+        prefetch_stats.dropped++;
+        return;
+    }
+    prefetch_queue.push_back(line_address);
+}
+
+bool Cache::nextPrefetch(uint64_t &address) {
+    while (!prefetch_queue.empty()) {
+        address = prefetch_queue.front();
+        prefetch_queue.erase(prefetch_queue.begin());
+        if (findWay(geometry.indexOf(address), geometry.tagOf(address)) < 0) {
+            return true;
+        }
+        prefetch_stats.late++;
+    }
+    return false;
+}
+
+bool Cache::prefetch(uint64_t address) {
+    uint32_t index = geometry.indexOf(address);
+    uint64_t tag = geometry.tagOf(address);
+    // 出队之后同一周期的其他请求可能已经装入了该行
+    if (findWay(index, tag) >= 0) {
+        prefetch_stats.late++;
+        return false;
+    }
+    last_access = AccessInfo();
+    last_access.line = address & ~static_cast<uint64_t>(geometry.offset_mask);
+    uint32_t way = allocate(index);
+    uint32_t *data = lineData(index, way);
+    bool shared = false;
+    bool supplied = bus->broadcast(READ_MISS, address, processor_id, &shared, data);
+    states[slot(index, way)] = protocol->read_fill[shared];
+    setTag(index, way, tag);
+    if (supplied) {
+        last_access.cache_to_cache = true;
+    } else {
+        fillLine(address, data);
+    }
+    last_access.bus_request = READ_MISS;
+    // 预取不是需求访问, 不推进 LRU 时钟
+    lru_stamps[blockId(index, way)] = access_count;
+    replacement->insert(index, way);
+    prefetched[blockId(index, way)] = 1;
+    prefetch_stats.issued++;
+    if (shared) {
+        prefetch_stats.shared_fills++;
+    }
+    if (log != nullptr) {
+        logBlock(index, way);
+    }
+    return true;
+}
+
+void Cache::fillLine(uint64_t address, uint32_t *data) {
+    if (llc != nullptr) {
+        last_access.llc_hit = llc->readLine(address, data);
+    } else {
+        memory->readLine(address, data, geometry.words_per_line);
+    }
+}
+
+void Cache::writeBackLine(uint64_t address, const uint32_t *data) {
+    if (llc != nullptr) {
+        llc->writeLine(address, data);
+    } else {
+        memory->writeLine(address, data, geometry.words_per_line);
+    }
+}
+
+void Cache::retireDirty(uint64_t address, const uint32_t *data) {
+    if (llc != nullptr) {
+        llc->evict(address, data, true);
+    } else {
+        memory->writeLine(address, data, geometry.words_per_line);
+    }
+}
+
+void Cache::flushWriteBack(uint64_t line_address, bool notify) {
+    if (write_back.empty()) {
+        return;
+    }
+    int position = write_back.find(line_address);
+    if (position < 0) {
+        return;
+    }
+    if (notify) {
+        bus->notifyEviction(line_address, processor_id);
+    }
+    retireDirty(line_address, write_back.line(position));
+    write_back.remove(position);
+    write_back.early_drains++;
+}
+
+void Cache::drainWriteBack(uint32_t entries) {
+    for (uint32_t i = 0; i < entries && !write_back.empty(); i++) {
+        uint64_t address = write_back.address(0);
+        bus->notifyEviction(address, processor_id);
+        retireDirty(address, write_back.line(0));
+        write_back.remove(0);
+    }
+}
+
+bool Cache::backInvalidate(uint64_t address) {
+    uint32_t index = geometry.indexOf(address);
+    int way = findWay(index, geometry.tagOf(address));
+    if (way < 0) {
+        return false;
+    }
+    uint8_t &state = states[slot(index, way)];
+    if (protocol->dirty[state]) {
+        memory->writeLine(address, lineData(index, way), geometry.words_per_line);
+        stats.writebacks++;
+    }
+    if (!prefetched.empty() && prefetched[blockId(index, way)]) {
+        prefetched[blockId(index, way)] = 0;
+        prefetch_stats.unused_evictions++;
+    }
+    state = INVALID;
+    breakLink(address & ~static_cast<uint64_t>(geometry.offset_mask));
+    if (log != nullptr) {
+        logBlock(index, way);
+    }
+    return true;
+}
+
+void Cache::copySet(const Cache &other, uint32_t index) {
+    std::copy(&other.tags[slot(index, 0)], &other.tags[slot(index, 0)] + tag_stride, &tags[slot(index, 0)]);
+    std::copy(&other.tag_keys[slot(index, 0)], &other.tag_keys[slot(index, 0)] + tag_stride, &tag_keys[slot(index, 0)]);
+    std::copy(&other.states[slot(index, 0)], &other.states[slot(index, 0)] + tag_stride, &states[slot(index, 0)]);
+    std::copy(&other.lru_stamps[blockId(index, 0)], &other.lru_stamps[blockId(index, 0)] + geometry.ways,
+              &lru_stamps[blockId(index, 0)]);
+    size_t words = geometry.ways * geometry.words_per_line;
+    const uint32_t *from = &other.line_store[blockId(index, 0) * geometry.words_per_line];
+    std::copy(from, from + words, lineData(index, 0));
+    if (!sector_states.empty()) {
+        const uint8_t *block_sectors = &other.sector_states[blockId(index, 0) * sectors];
+        std::copy(block_sectors, block_sectors + geometry.ways * sectors, &sector_states[blockId(index, 0) * sectors]);
+        std::copy(&other.valid_sectors[blockId(index, 0)], &other.valid_sectors[blockId(index, 0)] + geometry.ways,
+                  &valid_sectors[blockId(index, 0)]);
+        std::copy(&other.dirty_sectors[blockId(index, 0)], &other.dirty_sectors[blockId(index, 0)] + geometry.ways,
+                  &dirty_sectors[blockId(index, 0)]);
+    }
+    replacement->copySet(*other.replacement, index);
+}
+
+void Cache::checkpoint(Checkpoint &cp) {
+    cp.value(access_count);
+    cp.array(tags);
+    cp.array(states);
+    cp.array(lru_stamps);
+    cp.array(line_store);
+    cp.array(sector_states);
+    cp.array(valid_sectors);
+    cp.array(dirty_sectors);
+    replacement->checkpoint(cp);
+    cp.value(link_line);
+    cp.value(link_valid);
+    cp.value(stats);
+    write_back.checkpoint(cp);
+    if (prefetcher) {
+        prefetcher->checkpoint(cp);
+    }
+    cp.array(prefetched);
+    cp.array(prefetch_queue, true);
+    cp.value(prefetch_stats);
+    cp.array(touched_words);
+    cp.array(written_words);
+    if (cp.isLoading() && prefetch_queue.size() > PREFETCH_QUEUE_SIZE) {
+        cp.fail();
+    }
+    if (cp.isLoading()) {
+        std::transform(tags.begin(), tags.end(), tag_keys.begin(), tagKey);
+    }
+}
+
+void Cache::setReplacement(Replacement kind) {
+    replacement_kind = kind;
+    replacement = makeReplacementPolicy(kind, geometry, processor_id);
+}
+
+void Cache::logBlock(uint32_t index, uint32_t way) {
+    log->block(processor_id, blockId(index, way), stateOf(index, way), tags[slot(index, way)],
+               lru_stamps[blockId(index, way)], lineData(index, way), geometry.words_per_line);
+}
+
+void Cache::printBlock(std::ostream &out, State state, uint64_t tag, const uint32_t *data, int words, uint32_t lru,
+                       const uint8_t *sector_states, uint32_t sectors) {
+    if (state == INVALID) {
+        out << "[INVALID]\t\t";
+        return;
+    }
+    out << "[T:0x" << std::hex << tag << " S:";
+    if (sector_states != nullptr) {
+        for (uint32_t s = 0; s < sectors; s++) {
+            out << stateChar(static_cast<State>(sector_states[s]));
+        }
+    } else {
+        out << stateChar(state);
+    }
+    out << " D:" << std::dec << data[0];
+    for (int w = 1; w < words; w++) {
+        out << "," << data[w];
+    }
+    out << " L:" << lru << "]\t";
+}
+
 void Cache::print_state() {
+    PROFILE_SCOPE(PROF_OUTPUT);
     std::cout << "Cache State (Processor " << processor_id << "):\n";
-    for (int s = 0; s < cache.size(); s++) {
+    for (uint32_t s = 0; s < geometry.sets; s++) {
         std::cout << "Set " << s << ":\t";
-        for (int b = 0; b < 2; b++) {
-            Block &block = cache[s].blocks[b];
-            if (block.state != INVALID) {
-                // 将状态枚举转换为可读字符串
-                std::string state_str;
-                switch(block.state) {
-                    case MODIFIED: state_str = "M"; break;
-                    case EXCLUSIVE: state_str = "E"; break;
-                    case SHARED: state_str = "S"; break;
-                    default: state_str = "I";
-                }
-                
-                // std::cout << "[T:0x" << std::hex << block.tag 
-                //           << " S:" << state_str
-                //           << " D:0x" << std::setw(8) << std::setfill('0') << block.data
-                //           << " L:" << std::dec << block.lru_counter << "]\t";
-                // D改为10进制
-                std::cout << "[T:0x" << std::hex << block.tag 
-                          << " S:" << state_str
-                          << " D:" << std::dec << block.data
-                          << " L:" << block.lru_counter << "]\t";
-            } else {
-                std::cout << "[INVALID]\t\t";
-            }
+        for (uint32_t b = 0; b < geometry.ways; b++) {
+            printBlock(std::cout, stateOf(s, b), tags[slot(s, b)], lineData(s, b), geometry.words_per_line,
+                       lru_stamps[blockId(s, b)],
+                       sector_states.empty() ? nullptr : &sector_states[blockId(s, b) * sectors], sectors);
         }
         std::cout << "\n";
     }
     
     // // 添加性能统计信息
     // std::cout << "Access Count: " << access_count << "\n";
-    // std::cout << "Read Hits: " << read_hit_count 
-    //           << ", Read Misses: " << read_miss_count << "\n";
-    // std::cout << "Write Hits: " << write_hit_count 
-    //           << ", Write Misses: " << write_miss_count << "\n";
+    // std::cout << "Read Hits: " << stats.read_hits 
+    //           << ", Read Misses: " << stats.read_misses << "\n";
+    // std::cout << "Write Hits: " << stats.write_hits 
+    //           << ", Write Misses: " << stats.write_misses << "\n";
     // std::cout << "Hit Rate: " 
-    //           << (access_count ? (100.0 * (read_hit_count + write_hit_count) / access_count) : 0.0)
+    //           << (access_count ? (100.0 * stats.hits() / access_count) : 0.0)
     //           << "%\n\n";
-}
\ No newline at end of file
+}
+
+const char *atomicLockName(AtomicLock lock) {
+    return lock == LOCK_BUS ? "bus" : "cache";
+}
+
+bool parseAtomicLock(const std::string &text, AtomicLock &lock) {
+    if (text == "cache") {
+        lock = LOCK_CACHE;
+    } else if (text == "bus") {
+        lock = LOCK_BUS;
+    } else {
+        return false;
+    }
+    return true;
+}
@@ -3,67 +3,208 @@
 
 #include <vector>
 #include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <memory>
 #include "common.hpp"
+#include "geometry.hpp"
+#include "stats.hpp"
+#include "timing.hpp"
+#include "tag_match.hpp"
+#include "protocol.hpp"
+#include "replacement.hpp"
+#include "write_buffer.hpp"
+#include "prefetcher.hpp"
+
+#define PREFETCH_QUEUE_SIZE 8   // 每个 cache 待发出的预取数上限
 
 class Bus;
 class Memory;
+class EventLog;
+class LastLevelCache;
+class SharingDetector;
+class Checkpoint;
 
 class Cache {
 private:
-    struct Block {
-        State state;
-        uint16_t tag;
-        uint32_t lru_counter;
-        uint32_t data;
-
-        Block() : state(INVALID), tag(0), lru_counter(0), data(0) {}
+    // 行内第 offset 个半字 (2 字节) 的读写
+    static void writeTwoBytes(uint32_t *line, int offset, uint16_t data) {
+        int shift = (offset & 1) * 16;
+        uint32_t &word = line[offset >> 1];
+        word = (word & ~(0xFFFFu << shift)) | (static_cast<uint32_t>(data) << shift);
+    }
 
-        bool isDirty() const { 
-            return state == MODIFIED; 
-        }
-
-        bool writeTwoBytes(int offset, uint16_t data) {
-            if (offset < 0 || offset > 1) {
-                return false;
-            }
-            int shift = offset * 16;
-            this->data = (this->data & ~(0xFFFF << shift)) | (data << shift);
-            return true;
-        }
+    static uint16_t readTwoBytes(const uint32_t *line, int offset) {
+        int shift = (offset & 1) * 16;
+        return (line[offset >> 1] >> shift) & 0xFFFF;
+    }
 
-        uint16_t readTwoBytes(int offset) const {
-            if (offset < 0 || offset > 1) {
-                return 0;
-            }
-            int shift = offset * 16;
-            return (this->data >> shift) & 0xFFFF;
-        }
-    };
+    // 写类访问取得所有权后写入半字: WRITE 直接写入, FETCH_ADD 加上 data, CAS 只在旧值等于 rmw_compare 时写入;
+    // 原子操作的旧值放在 read_data 中
+    void writeValue(uint32_t *line, int offset, Operation op, uint16_t data, uint16_t *read_data);
 
-    struct Set {
-        Block blocks[2];
-    };
-    
-    std::vector<Set> cache;
-    const int block_size = 4;
-    int access_count = 0;
+    const CacheGeometry geometry;
+    // 结构数组存储: tag 与状态按组紧凑存放, 每组填充到 tag_stride 路以便按 8 路一组做向量比较,
+    // 填充路的状态恒为 INVALID; 打印用的访问时间戳和数据各自单独存放
+    uint32_t tag_stride;
+    std::vector<uint64_t> tags;         // sets * tag_stride
+    std::vector<uint32_t> tag_keys;     // sets * tag_stride, tag 的低 32 位, 由 setTag 与 tags 同步维护
+    std::vector<uint8_t> states;        // sets * tag_stride, 取值为 State
+    std::vector<uint32_t> lru_stamps;   // sets * ways, 最近一次访问时的 access_count, 仅用于打印和日志
+    std::vector<uint32_t> line_store;   // sets * ways * words_per_line
+    uint32_t access_count = 0;
     Bus *bus;
     Memory *memory;
+    LastLevelCache *llc = nullptr;      // 为空时缺失与写回直接访问内存
+    EventLog *log = nullptr;
+    const ProtocolTable *protocol = &MESI_PROTOCOL;
+    Replacement replacement_kind = REPLACE_LRU;
+    std::unique_ptr<ReplacementPolicy> replacement;
+    WriteBackBuffer write_back;         // 未启用时替换出的脏行直接写回下一级
+    Prefetch prefetch_kind = PREFETCH_NONE;
+    std::unique_ptr<Prefetcher> prefetcher;
+    std::vector<uint8_t> prefetched;        // sets * ways, 行由预取装入且还没有被需求访问命中; 不预取时为空
+    std::vector<uint64_t> prefetch_queue;   // 待发出的预取行地址, 先进先出
+    std::vector<uint64_t> candidates;       // 预取器的输出, 复用以免每次访问分配
+    // 伪共享检测: 每块自装入以来本核读写过 / 写过的字, 不检测时为空
+    SharingDetector *sharing = nullptr;
+    std::vector<uint64_t> touched_words;    // sets * ways
+    std::vector<uint64_t> written_words;    // sets * ways
+    // 扇区一致性: 每行分为 sectors 个扇区, 各扇区有独立的状态, 总线请求只涉及缺失或写入的扇区.
+    // 块状态 states 取各扇区中最强的状态, tag 匹配与替换照常只看块状态. 整行一致性时以下数组为空
+    uint32_t sectors = 1;
+    uint32_t sector_halves = 0;             // 每个扇区的半字数
+    std::vector<uint8_t> sector_states;     // sets * ways * sectors, 取值为 State
+    std::vector<uint32_t> valid_sectors;    // sets * ways, 非 INVALID 的扇区位图
+    std::vector<uint32_t> dirty_sectors;    // sets * ways, 替换时需要写回的扇区位图
+    std::vector<uint32_t> sector_fill;      // 缺失时收到的数据, 只取请求的扇区
+    std::vector<uint32_t> sector_merge;     // 部分写回时与内存中的行合并
+    // 原子操作: LL 记住的行在被无效化或替换之前, 同一行上的 SC 才会成功
+    AtomicLock atomic_lock = LOCK_CACHE;
+    uint64_t link_line = 0;
+    bool link_valid = false;
+    uint16_t rmw_compare = 0;               // 正在执行的 CAS 的期望值
+
+    // 需求访问与监听的主体按几何模板化, 构造时选定一次: 预设几何 (FixedGeometry) 的组号、tag、
+    // 行内偏移和组内查找都用编译期常量, 其他几何以 RuntimeGeometry 实例化, 从 geometry 读取
+    using AccessPath = bool (Cache::*)(uint64_t, Operation, uint16_t, uint16_t *);
+    using SnoopPath = bool (Cache::*)(BusRequest, uint64_t, int, bool *, uint32_t *, uint32_t);
+    AccessPath access_path;
+    SnoopPath snoop_path;
+    template <typename Fixed>
+    void usePaths();
+    template <typename Fixed>
+    int findWayIn(uint32_t index, uint64_t tag) const;
+    template <typename Fixed>
+    bool accessLine(uint64_t address, Operation op, uint16_t write_data, uint16_t *read_data);
+    template <typename Fixed>
+    bool snoopLine(BusRequest request, uint64_t address, int source_id, bool *shared, uint32_t *line,
+                   uint32_t sectors);
+
+    uint32_t slot(uint32_t index, uint32_t way) const { return index * tag_stride + way; }
+    void setTag(uint32_t index, uint32_t way, uint64_t tag);
+    uint32_t blockId(uint32_t index, uint32_t way) const { return index * geometry.ways + way; }
+    uint32_t *lineData(uint32_t index, uint32_t way) {
+        return &line_store[blockId(index, way) * geometry.words_per_line];
+    }
+    State stateOf(uint32_t index, uint32_t way) const { return static_cast<State>(states[slot(index, way)]); }
+    void logBlock(uint32_t index, uint32_t way);
+    // 从下一级 (LLC 或内存) 读入一行 / 写回一行
+    void fillLine(uint64_t address, uint32_t *data);
+    void writeBackLine(uint64_t address, const uint32_t *data);
+    // 替换出的脏行写入下一级: 有 LLC 时装入 LLC, 否则写内存
+    void retireDirty(uint64_t address, const uint32_t *data);
+    // 写回缓冲中有该行时立即写回下一级; notify 为 false 时不通知目录 (监听期间目录项正在被遍历)
+    void flushWriteBack(uint64_t line_address, bool notify);
+    // 缺失时在组内腾出一路: 处理被替换行 (写回或进入写回缓冲), 返回空出的路
+    uint32_t allocate(uint32_t index);
+    // 不在 cache 和队列中的候选行加入预取队列
+    void queuePrefetch(uint64_t line_address);
+    // 记录本核访问了块中的哪个字; 写时把写者的位图交给伪共享检测器
+    void recordWords(uint32_t index, uint32_t way, uint64_t address, bool write);
+    // 扇区模式下的访问与监听
+    bool accessSectors(uint64_t address, Operation op, uint16_t write_data, uint16_t *read_data);
+    bool snoopSectors(BusRequest request, uint64_t address, uint32_t mask, uint32_t index, uint32_t way,
+                      bool *shared, uint32_t *line);
+    // 复制 mask 选中的扇区
+    void copySectors(uint32_t *dst, const uint32_t *src, uint32_t mask) const;
+    // 只把 mask 选中的扇区写回内存, 其他扇区在别的 cache 中可能更新
+    void writeSectors(uint64_t address, const uint32_t *data, uint32_t mask);
+    // 由扇区状态重新计算块的有效/脏位图和块状态
+    void updateSectors(uint32_t index, uint32_t way);
+    // 该行离开本 cache 或被其他核取得所有权时, 之前的 LL 失效
+    void breakLink(uint64_t line_address) {
+        if (link_valid && link_line == line_address) {
+            link_valid = false;
+        }
+    }
 
 public:
     int processor_id;
-    int read_hit_count = 0;
-    int read_miss_count = 0;
-    int write_hit_count = 0;
-    int write_miss_count = 0;
+    CacheStats stats;
+    PrefetchStats prefetch_stats;
+    AccessInfo last_access;     // 最近一次 access 的结果, 供时序模型使用
 
-    Cache(int id);
-    uint32_t handleBusRequest(BusRequest request, uint16_t address, int source_id, bool *shared = nullptr);
-    bool access(uint16_t address, Operation op, uint16_t write_data = 0, uint16_t* read_data = nullptr);
+    Cache(int id, const CacheGeometry &geometry = DefaultGeometry::value);
+    // 监听总线请求, 返回是否由本 cache 提供了数据; sectors 为请求涉及的扇区, 整行一致性时忽略
+    bool handleBusRequest(BusRequest request, uint64_t address, int source_id, bool *shared = nullptr,
+                          uint32_t *line = nullptr, uint32_t sectors = ALL_SECTORS);
+    bool access(uint64_t address, Operation op, uint16_t write_data = 0, uint16_t* read_data = nullptr);
+    // FETCH_ADD / CAS / LL / SC. 读-改-写与写一样取得独占所有权后在一次访问中完成, 旧值 (SC 为 0 或 1 表示
+    // 是否成功) 放在 old_value 中; 返回是否命中, 失败的 SC 不访问 cache, 返回 true
+    bool atomic(uint64_t address, Operation op, uint16_t data, uint16_t compare, uint16_t *old_value = nullptr);
+    void setAtomicLock(AtomicLock lock) { atomic_lock = lock; }
+    AtomicLock getAtomicLock() const { return atomic_lock; }
+    // 分片回放: 其他组上的 LL 或 SC 由别的分片执行, 但同样会使本组的链接失效
+    void clearLink() { link_valid = false; }
     void print_state();
+    // print_state 中单个块的格式, 离线日志回放工具共用
+    // sector_states 不为空时按扇区打印状态
+    static void printBlock(std::ostream &out, State state, uint64_t tag, const uint32_t *data, int words, uint32_t lru,
+                           const uint8_t *sector_states = nullptr, uint32_t sectors = 1);
     void setBus(Bus *b) { bus = b; }
     void setMemory(Memory *m) { memory = m; }
+    void setLastLevel(LastLevelCache *l) { llc = l; }
+    void setEventLog(EventLog *l) { log = l; }
+    void setProtocol(const ProtocolTable *p) { protocol = p; }
+    const ProtocolTable *getProtocol() const { return protocol; }
+    void setReplacement(Replacement kind);
+    // entries 为 0 时不使用写回缓冲
+    void setWriteBackBuffer(uint32_t entries) { write_back.configure(entries, geometry.words_per_line); }
+    const WriteBackBuffer &getWriteBackBuffer() const { return write_back; }
+    // 后台写回: 写回缓冲中最旧的 entries 项写入下一级
+    void drainWriteBack(uint32_t entries);
+    void setSharingDetector(SharingDetector *detector);
+    // count 为 1 时按整行维护一致性
+    void setSectors(uint32_t count);
+    uint32_t getSectors() const { return sectors; }
+    void setPrefetcher(Prefetch kind, uint32_t degree);
+    Prefetch getPrefetch() const { return prefetch_kind; }
+    // 取出下一个仍不在 cache 中的预取行地址, 队列为空时返回 false
+    bool nextPrefetch(uint64_t &address);
+    // 以读缺失的监听把一行预取进 cache, 不计为需求访问; 该行已在 cache 中时返回 false
+    bool prefetch(uint64_t address);
+    Replacement getReplacement() const { return replacement_kind; }
     int getProcessorId() const { return processor_id; }
+    // 返回组内与 tag 匹配的有效路, 没有则返回 -1
+    int findWay(uint32_t index, uint64_t tag) const {
+        return matchTag(&tag_keys[slot(index, 0)], &tags[slot(index, 0)], &states[slot(index, 0)], geometry.ways, tag);
+    }
+    bool holds(uint64_t address) const { return findWay(geometry.indexOf(address), geometry.tagOf(address)) >= 0; }
+    const CacheGeometry &getGeometry() const { return geometry; }
+    // 分片回放: 跳过其他组的访问后, 将 LRU 时钟恢复到顺序执行时的值
+    uint32_t advanceClock() { return ++access_count; }
+    void setClock(uint32_t clock) { access_count = clock; }
+    // 包含式 LLC 替换该行时调用: 脏副本写回内存后置为 INVALID, 返回本 cache 是否持有该行
+    bool backInvalidate(uint64_t address);
+    // 从另一个相同几何参数的 cache 复制一个组的全部块
+    void copySet(const Cache &other, uint32_t index);
+    // 保存或恢复所有组的 tag、状态、数据、替换元数据与统计
+    void checkpoint(Checkpoint &cp);
 };
 
+const char *atomicLockName(AtomicLock lock);
+// 解析 "cache" / "bus"
+bool parseAtomicLock(const std::string &text, AtomicLock &lock);
+
 #endif
\ No newline at end of file
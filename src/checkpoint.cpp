@@ -0,0 +1,47 @@
+#include "checkpoint.hpp"
+
+Checkpoint::Checkpoint(const std::string &filename, bool loading) : loading(loading) {
+    file = std::fopen(filename.c_str(), loading ? "rb" : "wb");
+    if (file == nullptr) {
+        ok = false;
+        return;
+    }
+    if (loading && std::fseek(file, 0, SEEK_END) == 0) {
+        long size = std::ftell(file);
+        remaining = size > 0 ? static_cast<uint64_t>(size) : 0;
+        std::fseek(file, 0, SEEK_SET);
+    }
+}
+
+Checkpoint::~Checkpoint() {
+    close();
+}
+
+void Checkpoint::bytes(void *data, size_t size) {
+    if (!ok) {
+        return;
+    }
+    if (loading) {
+        if (size > remaining || std::fread(data, 1, size, file) != size) {
+            ok = false;
+            return;
+        }
+        remaining -= size;
+    } else if (std::fwrite(data, 1, size, file) != size) {
+        ok = false;
+    }
+}
+
+bool Checkpoint::close() {
+    if (file != nullptr) {
+        // 恢复时文件必须恰好读完
+        if (loading && remaining != 0) {
+            ok = false;
+        }
+        if (std::fclose(file) != 0) {
+            ok = false;
+        }
+        file = nullptr;
+    }
+    return ok;
+}
@@ -0,0 +1,89 @@
+#ifndef CHECKPOINT_HPP
+#define CHECKPOINT_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#define CHECKPOINT_MAGIC "MESICKP"
+#define CHECKPOINT_VERSION 4
+
+// 检查点文件头: 决定状态布局的配置, 恢复时必须与当前配置一致
+struct CheckpointHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t num_cores;
+    uint32_t size_bytes;
+    uint32_t ways;
+    uint32_t line_bytes;
+    uint32_t sectors;
+    uint32_t replacement;
+    uint32_t interconnect;
+    uint32_t arbitration;
+    uint32_t llc_size_bytes;    // 0 表示没有 LLC
+    uint32_t llc_ways;
+    uint32_t inclusion;
+    uint32_t writeback;         // 写回缓冲项数
+    uint32_t store;             // 存储缓冲项数
+    uint32_t timing;            // 0 表示不计时, 否则 1 + 分离事务总线每个 cache 的 MSHR 数
+    uint32_t prefetch;
+    uint32_t sharing;
+    char protocol[16];
+    uint64_t cycle;             // 已模拟的 trace 周期数, 恢复后从下一个周期继续
+};
+
+static_assert(sizeof(CheckpointHeader) == 104, "CheckpointHeader layout");
+
+// 二进制检查点. 保存与恢复共用同一组接口: 各组件的 checkpoint() 只写一遍字段顺序,
+// 保存时写出字段, 恢复时从同一位置读回. 出错后其余操作都被忽略, 结束时检查 good()
+class Checkpoint {
+private:
+    FILE *file;
+    bool loading;
+    bool ok = true;
+    uint64_t remaining = 0;     // 恢复时文件中剩余的字节数, 防止损坏的长度字段
+
+public:
+    Checkpoint(const std::string &filename, bool loading);
+    ~Checkpoint();
+    Checkpoint(const Checkpoint &) = delete;
+    Checkpoint &operator=(const Checkpoint &) = delete;
+    bool isOpen() const { return file != nullptr; }
+    bool isLoading() const { return loading; }
+    bool good() const { return ok; }
+    // 恢复的内容与当前状态不符
+    void fail() { ok = false; }
+    void bytes(void *data, size_t size);
+
+    template <typename T>
+    void value(T &field) {
+        static_assert(std::is_trivially_copyable<T>::value, "checkpoint fields must be plain data");
+        bytes(&field, sizeof(T));
+    }
+
+    // 数组先写元素个数. 恢复时 resize 为 false 的数组 (大小由配置决定) 个数必须相同
+    template <typename T>
+    void array(std::vector<T> &items, bool resize = false) {
+        static_assert(std::is_trivially_copyable<T>::value, "checkpoint fields must be plain data");
+        uint64_t count = items.size();
+        value(count);
+        if (loading && ok && count != items.size()) {
+            if (!resize || count > remaining / sizeof(T)) {
+                ok = false;
+                return;
+            }
+            items.resize(count);
+        }
+        if (count > 0) {
+            bytes(items.data(), count * sizeof(T));
+        }
+    }
+
+    // 关闭文件, 返回是否全部写入成功 (恢复时还要求恰好读完整个文件)
+    bool close();
+};
+
+#endif
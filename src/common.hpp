@@ -7,13 +7,23 @@ enum State {
     MODIFIED,       // 修改态
     EXCLUSIVE,      // 独占态
     SHARED,         // 共享态
-    INVALID         // 无效态
+    INVALID,        // 无效态
+    OWNED,          // 拥有态 (MOESI): 脏且可能被共享, 由本 cache 负责提供数据和写回
+    FORWARD         // 转发态 (MESIF): 干净的共享副本中负责提供数据的那一个
 };
 
+#define NUM_STATES 6
+
 enum Operation {
     READ,
     WRITE,
-    BARRIER         // 新增 barrier 操作
+    BARRIER,        // 新增 barrier 操作
+    PREFETCH,       // 预取: 由 cache 的预取器产生, 不出现在 trace 中, 仲裁时排在所有需求请求之后
+    // 原子读-改-写: 与写一样先取得独占所有权, 读出旧值并在同一次访问中写回新值, 仲裁时按写处理
+    FETCH_ADD,      // 加上 data, 返回旧值
+    CAS,            // 旧值等于 compare_data 时写入 data; 失败时也取得所有权 (与 x86 cmpxchg 相同)
+    LL,             // load-linked: 读, 并记住该行
+    SC              // store-conditional: 自 LL 以来该行未被无效化或替换时写入, 否则失败且不访问总线
 };
 
 enum BusRequest {
@@ -22,6 +32,54 @@ enum BusRequest {
     SET_INVALID     // 无效
 };
 
+// 总线请求涉及的扇区位图: 整行一致性的 cache 总是请求整行
+#define ALL_SECTORS 0xFFFFFFFFu
+#define MAX_SECTORS 32
+
+enum Interconnect {
+    BROADCAST_BUS,      // 广播监听: 每次一致性事件探测所有其他 cache
+    DIRECTORY_FILTER    // 目录/监听过滤: 只探测实际持有该行的 cache
+};
+
+enum Replacement {
+    REPLACE_LRU,        // 真 LRU (默认)
+    REPLACE_PLRU,       // 树形伪 LRU
+    REPLACE_SRRIP,      // 静态再引用区间预测
+    REPLACE_BRRIP,      // 双模态再引用区间预测
+    REPLACE_RANDOM      // 随机
+};
+
+enum Inclusion {
+    LLC_INCLUSIVE,      // 包含: LLC 替换时反向无效化各 L1 中的副本
+    LLC_EXCLUSIVE,      // 互斥: L1 缺失命中 LLC 时把行移入 L1, LLC 只接收 L1 替换出的行
+    LLC_NINE            // 非包含非互斥: 缺失时装入 LLC, 但 LLC 替换不影响 L1
+};
+
+enum Prefetch {
+    PREFETCH_NONE,
+    PREFETCH_NEXT_LINE, // 下一行
+    PREFETCH_STRIDE,    // 按区域检测步长, 不依赖 PC
+    PREFETCH_STREAM     // 流缓冲
+};
+
+enum Arbitration {
+    ARB_STATIC,         // barrier > 写 > 读, 同类按优先级 (默认)
+    ARB_ROUND_ROBIN,    // 轮转
+    ARB_AGE,            // 等待最久的先服务
+    ARB_LOTTERY         // 按优先级分配彩票数的抽签
+};
+
+enum AtomicLock {
+    LOCK_CACHE,         // 缓存锁: 持有独占行期间完成读-改-写, 只在需要取得所有权时占用总线 (默认)
+    LOCK_BUS            // 总线锁: 整个读-改-写期间锁住总线, 命中也要占用总线
+};
+
 #define PUBLIC_SUM_ADDR 0x400
+#define MAX_CORES 256
+
+// 各核私有累加变量的地址: 前 4 个核沿用 id * 0x100, 其余核依次排在 PUBLIC_SUM_ADDR 之后
+inline uint64_t privateSumAddr(int id) {
+    return id < 4 ? id * 0x100 : PUBLIC_SUM_ADDR + (id - 3) * 0x40;
+}
 
 #endif
\ No newline at end of file
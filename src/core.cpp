@@ -1,33 +1,58 @@
 #include "core.hpp"
+#include "checkpoint.hpp"
 #include <iostream>
 
-uint16_t public_sum = 0;
-
-Core::Core(int id) : processor_id(id), cache(nullptr), barrier_flag(false) {}
+Core::Core(int id) : processor_id(id), cache(nullptr), barrier_flag(false), bus_cycle(nullptr), private_sum(0) {}
 
 void Core::executeRequest(Request &request, bool omp, bool reduction) {
+    if (request.op == PREFETCH) {
+        // 预取由 cache 自己发出, 不进入请求队列, 也不受 barrier 影响; 只占用总线, 不让核停顿
+        if (cache->prefetch(request.address) && timing != nullptr) {
+            timing->accountPrefetch(processor_id, cache->last_access);
+        }
+        return;
+    }
     if (request.op == BARRIER) {
         barrier_flag = true;
-        std::cout << "\nProcessing " << request.toString() 
-                  << " (Set barrier for P" << processor_id << ")" << std::endl;
-        cache->print_state();
+        if (timing != nullptr) {
+            timing->arriveBarrier(processor_id);
+        }
+        if (verbose) {
+            std::cout << "\nProcessing " << request.toString() 
+                      << " (Set barrier for P" << processor_id << ")\n";
+            cache->print_state();
+        }
+        if (log != nullptr) {
+            log->request(LOG_BARRIER, request, processor_id);
+        }
     } else {
         if (barrier_flag) {
-            request_queue.push(request);
-            std::cout << "\nQueued " << request.toString() 
-                      << " (Barrier active for P" << processor_id << ")" << std::endl;
+            request_queue.push(request, *bus_cycle);
+            if (verbose) {
+                std::cout << "\nQueued " << request.toString() 
+                          << " (Barrier active for P" << processor_id << ")\n";
+            }
+            if (log != nullptr) {
+                log->request(LOG_QUEUED, request, processor_id);
+            }
         } else {
-            if (request.op == READ) {
+            if (schedule != nullptr) {
+                schedule->push_back({request.address, cache->advanceClock(), request.write_data, request.compare_data,
+                                     static_cast<uint16_t>(processor_id), static_cast<uint8_t>(request.op)});
+            } else if (request.op == READ) {
                 uint16_t read_data = 0;
                 cache->access(request.address, request.op, 0, &read_data);
                 if (omp) {
                     private_sum = read_data;
                 }
+            } else if (request.op != WRITE) {
+                // 原子操作总是使用 trace 中的操作数, 结果由 cache 中的数据决定, 不经过 -omp 的累加
+                cache->atomic(request.address, request.op, request.write_data, request.compare_data);
             } else {
                 if (omp) {
                     if (reduction && request.address == PUBLIC_SUM_ADDR) {
-                        public_sum += private_sum;
-                        request.write_data = public_sum;
+                        *public_sum += private_sum;
+                        request.write_data = *public_sum;
                     } else {
                         request.write_data = private_sum + i;
                         i++;
@@ -35,21 +60,61 @@ void Core::executeRequest(Request &request, bool omp, bool reduction) {
                 }
                 cache->access(request.address, request.op, request.write_data);
             }
-            std::cout << "\nProcessing " << request.toString() 
-                      << " (Priority: " << processor_id 
-                      << ", Type: " << (request.op == WRITE ? "WRITE" : "READ") << ")" << std::endl;
-            cache->print_state();
+            if (timing != nullptr) {
+                timing->account(processor_id, cache->last_access);
+            }
+            if (verbose) {
+                std::cout << "\nProcessing " << request.toString() 
+                          << " (Priority: " << processor_id 
+                          << ", Type: " << operationType(request.op) << ")\n";
+                cache->print_state();
+            }
+            if (log != nullptr) {
+                log->request(LOG_PROCESS, request, processor_id);
+            }
         }
     }
 
 }
 
-void Core:: enqueueRequest(const Request &request) {
-    request_queue.push(request);
+void Core::enqueueRequest(const Request &request, uint64_t enqueued) {
+    request_queue.push(request, enqueued);
+}
+
+QueuedRequest Core::dequeueRequest() {
+    return request_queue.pop();
+}
+// 逐字段读写, 不把结构体的填充字节写进文件
+static void transferRequest(Checkpoint &cp, Request &request) {
+    cp.value(request.processor_id);
+    cp.value(request.op);
+    cp.value(request.address);
+    cp.value(request.write_data);
+    cp.value(request.compare_data);
 }
 
-Request Core::dequeueRequest() {
-    Request req = request_queue.front();
-    request_queue.pop();
-    return req;
-}
\ No newline at end of file
+void Core::checkpoint(Checkpoint &cp) {
+    cp.value(barrier_flag);
+    cp.value(i);
+    cp.value(private_sum);
+    uint64_t count = request_queue.size();
+    cp.value(count);
+    if (cp.isLoading()) {
+        request_queue.clear();
+        for (uint64_t n = 0; n < count && cp.good(); n++) {
+            QueuedRequest queued = {Request(processor_id, READ), 0};
+            transferRequest(cp, queued.request);
+            cp.value(queued.enqueued);
+            if (queued.request.processor_id != processor_id) {
+                cp.fail();
+            }
+            request_queue.push(queued.request, queued.enqueued);
+        }
+        return;
+    }
+    for (uint32_t n = 0; n < count; n++) {
+        QueuedRequest queued = request_queue.at(n);
+        transferRequest(cp, queued.request);
+        cp.value(queued.enqueued);
+    }
+}
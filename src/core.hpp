@@ -2,23 +2,42 @@
 #define CORE_HPP
 
 #include <vector>
-#include <queue>
 #include "common.hpp"
 #include "cache.hpp"
 #include "request.hpp"
+#include "request_queue.hpp"
+#include "event_log.hpp"
+
+class Checkpoint;
+
+// 分片模式下记录的一次 cache 访问: 仲裁顺序与 cache 状态无关, 先记录全局执行顺序再按组回放
+struct ScheduledAccess {
+    uint64_t address;
+    uint32_t clock;                 // 访问时该 cache 的 access_count, 用于复现 LRU
+    uint16_t write_data;
+    uint16_t compare_data;
+    uint16_t processor_id;
+    uint8_t op;
+};
 
 class Core {
 private:
     int processor_id;
     Cache *cache;
     bool barrier_flag;
-    std::queue<Request> request_queue;
+    RequestQueue request_queue;
+    bool verbose = true;            // 是否逐请求打印 cache 状态
+    EventLog *log = nullptr;
+    TimingModel *timing = nullptr;
+    std::vector<ScheduledAccess> *schedule = nullptr;
 
 public:
     int *prioritiy;
+    uint16_t *public_sum;           // 指向总线上所有核共享的归约结果
+    const uint64_t *bus_cycle;      // 指向总线的当前周期, 请求入队时记录
     int i = getProcessorId() * 16;
     uint16_t private_sum;
-    const int private_sum_addr = getProcessorId() * 0x100;
+    const int private_sum_addr = privateSumAddr(getProcessorId());
     Core(int id);
     void setCache(Cache *c) { cache = c; }
     Cache *getCache() const { return cache; }
@@ -27,9 +46,15 @@ public:
     bool isQueueEmpty() const { return request_queue.empty(); }
     int getQueueSize() const { return request_queue.size(); }
     void executeRequest(Request &request, bool omp = false, bool reduction = false);
-    void enqueueRequest(const Request &request);
-    Request dequeueRequest();
+    void enqueueRequest(const Request &request, uint64_t enqueued);
+    QueuedRequest dequeueRequest();
     void clearBarrier() { barrier_flag = false; }
+    void setOutput(bool verbose, EventLog *log) { this->verbose = verbose; this->log = log; }
+    void setTiming(TimingModel *t) { timing = t; }
+    // 设置后读写请求只被记录而不访问 cache
+    void setSchedule(std::vector<ScheduledAccess> *s) { schedule = s; }
+    // 保存或恢复请求队列、barrier 标志和 -omp 的累加状态 (不含 cache)
+    void checkpoint(Checkpoint &cp);
 };
 
 #endif
\ No newline at end of file
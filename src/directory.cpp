@@ -0,0 +1,56 @@
+#include "directory.hpp"
+#include "checkpoint.hpp"
+#include <algorithm>
+#include <vector>
+
+const SharerMask *Directory::lookup(uint64_t address) const {
+    auto it = entries.find(lineOf(address));
+    return it == entries.end() ? nullptr : &it->second;
+}
+
+void Directory::addSharer(uint64_t address, int id) {
+    entries[lineOf(address)].set(id);
+}
+
+void Directory::removeSharer(uint64_t address, int id) {
+    auto it = entries.find(lineOf(address));
+    if (it == entries.end()) {
+        return;
+    }
+    it->second.reset(id);
+    if (it->second.none()) {
+        entries.erase(it);
+    }
+}
+
+void Directory::setOwner(uint64_t address, int id) {
+    SharerMask &mask = entries[lineOf(address)];
+    mask.clear();
+    mask.set(id);
+}
+
+void Directory::checkpoint(Checkpoint &cp) {
+    uint64_t count = entries.size();
+    cp.value(count);
+    if (cp.isLoading()) {
+        entries.clear();
+        for (uint64_t i = 0; i < count && cp.good(); i++) {
+            uint64_t line = 0;
+            SharerMask sharers;
+            cp.value(line);
+            cp.value(sharers);
+            entries[line] = sharers;
+        }
+        return;
+    }
+    std::vector<uint64_t> lines;
+    lines.reserve(count);
+    for (const auto &entry : entries) {
+        lines.push_back(entry.first);
+    }
+    std::sort(lines.begin(), lines.end());
+    for (uint64_t line : lines) {
+        cp.value(line);
+        cp.value(entries[line]);
+    }
+}
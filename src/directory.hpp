@@ -0,0 +1,59 @@
+#ifndef DIRECTORY_HPP
+#define DIRECTORY_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include "common.hpp"
+
+class Checkpoint;
+
+// 共享者位向量, 每个 cache 占一位
+struct SharerMask {
+    uint64_t words[MAX_CORES / 64] = {};
+
+    void set(int id) { words[id >> 6] |= 1ULL << (id & 63); }
+    void reset(int id) { words[id >> 6] &= ~(1ULL << (id & 63)); }
+    bool test(int id) const { return (words[id >> 6] >> (id & 63)) & 1; }
+    void clear() {
+        for (uint64_t &w : words) w = 0;
+    }
+    bool none() const {
+        for (uint64_t w : words) {
+            if (w != 0) return false;
+        }
+        return true;
+    }
+    // 返回 >= from 的第一个共享者编号, 没有则返回 -1
+    int next(int from) const {
+        for (int i = from >> 6; i < MAX_CORES / 64; i++) {
+            uint64_t w = words[i];
+            if (i == (from >> 6)) {
+                w &= ~0ULL << (from & 63);
+            }
+            if (w != 0) {
+                return (i << 6) + __builtin_ctzll(w);
+            }
+        }
+        return -1;
+    }
+};
+
+// 全映射位向量目录: 记录每个 cache 行由哪些 cache 持有 (非 INVALID)
+class Directory {
+private:
+    std::unordered_map<uint64_t, SharerMask> entries;
+    int offset_bits;
+
+public:
+    explicit Directory(int offset_bits) : offset_bits(offset_bits) {}
+    uint64_t lineOf(uint64_t address) const { return address >> offset_bits; }
+    const SharerMask *lookup(uint64_t address) const;
+    void addSharer(uint64_t address, int id);
+    void removeSharer(uint64_t address, int id);
+    void setOwner(uint64_t address, int id);
+    size_t size() const { return entries.size(); }
+    void checkpoint(Checkpoint &cp);
+};
+
+#endif
@@ -0,0 +1,86 @@
+#include "event_log.hpp"
+#include "profile.hpp"
+#include <cstring>
+
+EventLog::EventLog(const std::string &filename, int num_cores, const CacheGeometry &geometry, size_t buffer_bytes)
+    : buffer(buffer_bytes) {
+    file = std::fopen(filename.c_str(), "wb");
+    if (file == nullptr) {
+        return;
+    }
+    EventRecord header = {};
+    header.kind = LOG_HEADER;
+    header.core = num_cores;
+    header.slot = geometry.size_bytes;
+    header.tag = geometry.ways;
+    header.data = geometry.line_bytes;
+    header.lru = EVENT_LOG_VERSION;
+    append(&header, sizeof(header));
+}
+
+EventLog::~EventLog() {
+    if (file != nullptr) {
+        flush();
+        std::fclose(file);
+    }
+}
+
+void EventLog::append(const void *bytes, size_t size) {
+    if (used + size > buffer.size()) {
+        flush();
+    }
+    std::memcpy(&buffer[used], bytes, size);
+    used += size;
+}
+
+void EventLog::flush() {
+    PROFILE_SCOPE(PROF_OUTPUT);
+    if (file != nullptr && used > 0) {
+        std::fwrite(buffer.data(), 1, used, file);
+        used = 0;
+    }
+}
+
+void EventLog::beginCycle(uint32_t n) {
+    cycle = n;
+    EventRecord record = {};
+    record.kind = LOG_CYCLE;
+    record.cycle = n;
+    append(&record, sizeof(record));
+}
+
+void EventLog::block(int core, uint32_t slot, State state, uint64_t tag, uint32_t lru, const uint32_t *data, int words) {
+    EventRecord record = {};
+    record.kind = LOG_BLOCK;
+    record.state = state;
+    record.core = core;
+    record.cycle = cycle;
+    record.slot = slot;
+    record.tag = tag;
+    record.data = data[0];
+    record.lru = lru;
+    append(&record, sizeof(record));
+    if (words > 1) {
+        append(data + 1, (words - 1) * sizeof(uint32_t));
+    }
+}
+
+void EventLog::request(EventKind kind, const Request &request, int core, int priority) {
+    EventRecord record = {};
+    record.kind = kind;
+    record.state = request.op;
+    record.core = core;
+    record.cycle = cycle;
+    record.slot = priority;
+    record.tag = request.address;
+    record.data = request.write_data;
+    record.compare = request.compare_data;
+    append(&record, sizeof(record));
+}
+
+void EventLog::clearBarriers() {
+    EventRecord record = {};
+    record.kind = LOG_CLEAR;
+    record.cycle = cycle;
+    append(&record, sizeof(record));
+}
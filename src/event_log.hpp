@@ -0,0 +1,62 @@
+#ifndef EVENT_LOG_HPP
+#define EVENT_LOG_HPP
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "common.hpp"
+#include "geometry.hpp"
+#include "request.hpp"
+
+enum EventKind {
+    LOG_HEADER,     // 文件头: 核数与 cache 几何
+    LOG_CYCLE,      // 新周期开始
+    LOG_BLOCK,      // cache 块内容发生变化 (状态/tag/数据/LRU)
+    LOG_ENQUEUE,    // 请求在仲裁时进入非空队列
+    LOG_PROCESS,    // 读写请求执行完毕
+    LOG_QUEUED,     // barrier 生效期间请求被推迟
+    LOG_BARRIER,    // 处理器设置 barrier
+    LOG_CLEAR       // 所有 barrier 被清除
+};
+
+#define EVENT_LOG_VERSION 2
+
+// 定长 32 字节事件记录; LOG_BLOCK 之后紧跟 words_per_line - 1 个额外数据字
+struct EventRecord {
+    uint8_t kind;
+    uint8_t state;      // LOG_BLOCK: 新状态; 请求事件: Operation
+    uint16_t core;
+    uint32_t cycle;
+    uint32_t slot;      // LOG_BLOCK: set * ways + way; LOG_ENQUEUE: 优先级
+    uint32_t lru;
+    uint64_t tag;       // LOG_BLOCK: tag; 请求事件: 地址
+    uint32_t data;      // LOG_BLOCK: 第一个数据字; 请求事件: write_data
+    uint32_t compare;   // 请求事件: CAS 的 compare_data
+};
+
+static_assert(sizeof(EventRecord) == 32, "EventRecord layout");
+
+// 带大缓冲区的二进制事件日志, 只在缓冲区写满或关闭时写文件
+class EventLog {
+private:
+    FILE *file;
+    std::vector<char> buffer;
+    size_t used = 0;
+    uint32_t cycle = 0;
+
+    void append(const void *bytes, size_t size);
+
+public:
+    EventLog(const std::string &filename, int num_cores, const CacheGeometry &geometry,
+             size_t buffer_bytes = 1 << 20);
+    ~EventLog();
+    bool isOpen() const { return file != nullptr; }
+    void beginCycle(uint32_t n);
+    void block(int core, uint32_t slot, State state, uint64_t tag, uint32_t lru, const uint32_t *data, int words);
+    void request(EventKind kind, const Request &request, int core, int priority = 0);
+    void clearBarriers();
+    void flush();
+};
+
+#endif
@@ -36,23 +36,24 @@ std::vector<int> getRandomElements(const std::vector<int>& vec, int num) {
     return std::vector<int>(tmp.begin(), tmp.begin() + num);
 }
 
-void generateOmpRequest(const std::string& filename, bool reduction) {
-    std::vector<std::queue<Request>> requests(4);
+void generateOmpRequest(const std::string& filename, bool reduction, int num_cores) {
+    // 每个核执行 16 次读写
+    std::vector<std::queue<Request>> requests(num_cores);
     if (reduction) {
-        for (int i = 0; i < 64; i++) {
+        for (int i = 0; i < 16 * num_cores; i++) {
             int processor_id = i / 16;
-            requests[processor_id].push(Request(processor_id, READ, processor_id * 0x100, 0));
-            requests[processor_id].push(Request(processor_id, WRITE, processor_id * 0x100, 0));
+            requests[processor_id].push(Request(processor_id, READ, privateSumAddr(processor_id), 0));
+            requests[processor_id].push(Request(processor_id, WRITE, privateSumAddr(processor_id), 0));
         }
-        for (int i = 0; i < 4; i++) {
+        for (int i = 0; i < num_cores; i++) {
             requests[i].push(Request(i, BARRIER, 0, 0));
         }
-        for (int i = 0; i < 4; i++) {
-            requests[0].push(Request(0, READ, i * 0x100, 0));
+        for (int i = 0; i < num_cores; i++) {
+            requests[0].push(Request(0, READ, privateSumAddr(i), 0));
             requests[0].push(Request(0, WRITE, PUBLIC_SUM_ADDR, 0));
         }
     } else {
-        for (int i = 0; i < 64; i++) {
+        for (int i = 0; i < 16 * num_cores; i++) {
             int processor_id = i / 16;
             requests[processor_id].push(Request(processor_id, READ, PUBLIC_SUM_ADDR, 0));
             requests[processor_id].push(Request(processor_id, WRITE, PUBLIC_SUM_ADDR, 0));
@@ -65,12 +66,15 @@ void generateOmpRequest(const std::string& filename, bool reduction) {
     }
 
     int ins_count = 0;
-    std::vector<int> non_empty_cores = {0, 1, 2, 3};
+    std::vector<int> non_empty_cores;
+    for (int i = 0; i < num_cores; i++) {
+        non_empty_cores.push_back(i);
+    }
     while (!non_empty_cores.empty()) {
         int num_active = generateRandomInt(1, non_empty_cores.size());
         ins_count += num_active;
         std::vector<int> active_cores = getRandomElements(non_empty_cores, num_active);
-        std::vector<std::string> line_requests(4, "NULL");
+        std::vector<std::string> line_requests(num_cores, "NULL");
         for (int core : active_cores) {
             if (!requests[core].empty()) {
                 line_requests[core] = requests[core].front().toString();
@@ -86,9 +90,9 @@ void generateOmpRequest(const std::string& filename, bool reduction) {
             }
         }
 
-        for (int i = 0; i < 4; i++) {
+        for (int i = 0; i < num_cores; i++) {
             file << line_requests[i];
-            if (i < 3) file << ";";
+            if (i < num_cores - 1) file << ";";
             file << "\t";
         }
         file << "\n";
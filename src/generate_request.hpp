@@ -4,6 +4,6 @@
 #include <string>
 #include <vector>
 
-void generateOmpRequest(const std::string& filename, bool reduction = false);
+void generateOmpRequest(const std::string& filename, bool reduction = false, int num_cores = 4);
 
 #endif
\ No newline at end of file
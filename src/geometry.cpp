@@ -0,0 +1,52 @@
+#include "geometry.hpp"
+#include <sstream>
+#include <cstdlib>
+
+std::string CacheGeometry::toString() const {
+    std::stringstream ss;
+    ss << size_bytes << "B, " << ways << "-way, " << line_bytes << "B lines, " << sets << " sets";
+    return ss.str();
+}
+
+bool parseGeometry(const std::string &text, CacheGeometry &geometry) {
+    if (text == "default") {
+        geometry = DefaultGeometry::value;
+        return true;
+    }
+    if (text == "l1-32k") {
+        geometry = L1Geometry32K::value;
+        return true;
+    }
+    if (text == "l1-64k") {
+        geometry = L1Geometry64K::value;
+        return true;
+    }
+    if (text == "llc-1m") {
+        geometry = LlcGeometry1M::value;
+        return true;
+    }
+
+    uint32_t fields[3];
+    const char *p = text.c_str();
+    for (int i = 0; i < 3; i++) {
+        char *end = nullptr;
+        unsigned long value = std::strtoul(p, &end, 10);
+        if (end == p) {
+            return false;
+        }
+        fields[i] = static_cast<uint32_t>(value);
+        if (i < 2) {
+            if (*end != ':') {
+                return false;
+            }
+            p = end + 1;
+        } else if (*end != '\0') {
+            return false;
+        }
+    }
+    if (!CacheGeometry::valid(fields[0], fields[1], fields[2])) {
+        return false;
+    }
+    geometry = CacheGeometry::make(fields[0], fields[1], fields[2]);
+    return true;
+}
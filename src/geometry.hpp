@@ -0,0 +1,93 @@
+#ifndef GEOMETRY_HPP
+#define GEOMETRY_HPP
+
+#include <cstdint>
+#include <string>
+
+constexpr bool isPowerOfTwo(uint32_t value) {
+    return value != 0 && (value & (value - 1)) == 0;
+}
+
+constexpr int log2Of(uint32_t value) {
+    int bits = 0;
+    while (value > 1) {
+        value >>= 1;
+        bits++;
+    }
+    return bits;
+}
+
+// 替换策略的 LRU 排名用一个字节保存
+#define MAX_WAYS 256
+
+// Cache 几何参数: 容量、相联度、行大小, 以及由它们预先算好的移位/掩码
+struct CacheGeometry {
+    uint32_t size_bytes;
+    uint32_t ways;
+    uint32_t line_bytes;
+    uint32_t sets;
+    uint32_t words_per_line;
+    int offset_bits;
+    int index_bits;
+    uint32_t offset_mask;
+    uint32_t index_mask;
+
+    constexpr uint32_t offsetOf(uint64_t address) const { return address & offset_mask; }
+    constexpr uint32_t indexOf(uint64_t address) const { return (address >> offset_bits) & index_mask; }
+    constexpr uint64_t tagOf(uint64_t address) const { return address >> (offset_bits + index_bits); }
+    constexpr uint64_t lineAddress(uint64_t tag, uint32_t index) const {
+        return (tag << (offset_bits + index_bits)) | (static_cast<uint64_t>(index) << offset_bits);
+    }
+
+    static constexpr CacheGeometry make(uint32_t size_bytes, uint32_t ways, uint32_t line_bytes) {
+        uint32_t sets = size_bytes / (ways * line_bytes);
+        return CacheGeometry{size_bytes, ways, line_bytes, sets, line_bytes / 4,
+                             log2Of(line_bytes), log2Of(sets), line_bytes - 1, sets - 1};
+    }
+
+    static constexpr bool valid(uint32_t size_bytes, uint32_t ways, uint32_t line_bytes) {
+        return isPowerOfTwo(line_bytes) && line_bytes >= 4 && ways > 0 && ways <= MAX_WAYS &&
+               size_bytes % (ways * line_bytes) == 0 && isPowerOfTwo(size_bytes / (ways * line_bytes));
+    }
+
+    std::string toString() const;
+};
+
+// 编译期几何: 参数非法时直接编译失败, 移位和掩码均为常量
+template <uint32_t SizeBytes, uint32_t Ways, uint32_t LineBytes>
+struct FixedGeometry {
+    static_assert(CacheGeometry::valid(SizeBytes, Ways, LineBytes),
+                  "cache geometry needs power-of-two line size >= 4, at most 256 ways and a power-of-two set count");
+    static constexpr CacheGeometry value = CacheGeometry::make(SizeBytes, Ways, LineBytes);
+};
+
+// 运行时几何的占位类型: 模板化的查找路径以它为参数时, 移位和掩码从对象中读取
+struct RuntimeGeometry {};
+
+// 模板化查找路径使用的几何: FixedGeometry 返回编译期常量, 移位、掩码和路数都折叠进指令;
+// RuntimeGeometry 返回对象中保存的几何
+template <typename Fixed>
+constexpr const CacheGeometry &geometryOf(const CacheGeometry &) {
+    return Fixed::value;
+}
+
+template <>
+constexpr const CacheGeometry &geometryOf<RuntimeGeometry>(const CacheGeometry &runtime) {
+    return runtime;
+}
+
+template <typename Fixed>
+constexpr bool sameGeometry(const CacheGeometry &geometry) {
+    return geometry.size_bytes == Fixed::value.size_bytes && geometry.ways == Fixed::value.ways &&
+           geometry.line_bytes == Fixed::value.line_bytes;
+}
+
+using DefaultGeometry = FixedGeometry<64, 2, 4>;     // 原始配置: 64B, 2路, 4B 块
+using L1Geometry32K = FixedGeometry<32768, 8, 64>;
+using L1Geometry64K = FixedGeometry<65536, 16, 64>;
+using LlcGeometry1M = FixedGeometry<1048576, 16, 64>;
+
+// 解析命令行几何: 预设名 (default, l1-32k, l1-64k, llc-1m) 或 "size:ways:line"
+bool parseGeometry(const std::string &text, CacheGeometry &geometry);
+
+#endif
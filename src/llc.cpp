@@ -0,0 +1,179 @@
+#include "llc.hpp"
+#include "bus.hpp"
+#include "memory.hpp"
+#include "checkpoint.hpp"
+#include "tag_match.hpp"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+LastLevelCache::LastLevelCache(const CacheGeometry &geometry, Inclusion inclusion, Replacement kind,
+                               Memory *memory, Bus *bus)
+    : geometry(geometry), inclusion(inclusion), memory(memory), bus(bus) {
+    replacement = makeReplacementPolicy(kind, geometry, MAX_CORES);
+    tag_stride = tagStride(geometry.ways);
+    tags.resize(geometry.sets * tag_stride, 0);
+    tag_keys.resize(tags.size(), 0);
+    states.resize(geometry.sets * tag_stride, INVALID);
+    line_store.resize(static_cast<size_t>(geometry.sets) * geometry.ways * geometry.words_per_line, 0);
+}
+
+int LastLevelCache::findWay(uint32_t index, uint64_t tag) const {
+    return matchTag(&tag_keys[slot(index, 0)], &tags[slot(index, 0)], &states[slot(index, 0)], geometry.ways, tag);
+}
+
+void LastLevelCache::setTag(uint32_t index, uint32_t way, uint64_t tag) {
+    tags[slot(index, way)] = tag;
+    tag_keys[slot(index, way)] = tagKey(tag);
+}
+
+uint32_t LastLevelCache::allocate(uint32_t index) {
+    const uint8_t *set_states = &states[slot(index, 0)];
+    const void *first_invalid = std::memchr(set_states, INVALID, geometry.ways);
+    if (first_invalid != nullptr) {
+        return static_cast<const uint8_t *>(first_invalid) - set_states;
+    }
+    uint32_t way = replacement->victim(index);
+    uint8_t &state = states[slot(index, way)];
+    uint64_t victim_address = geometry.lineAddress(tags[slot(index, way)], index);
+    stats.evictions++;
+    // 先写回 LLC 的脏行, 再由 L1 写回更新的副本
+    if (state == MODIFIED) {
+        memory->writeLine(victim_address, lineData(index, way), geometry.words_per_line);
+        stats.writebacks++;
+    }
+    state = INVALID;
+    if (inclusion == LLC_INCLUSIVE) {
+        stats.back_invalidations += bus->backInvalidate(victim_address);
+    }
+    return way;
+}
+
+bool LastLevelCache::readLine(uint64_t address, uint32_t *line) {
+    uint32_t index = geometry.indexOf(address);
+    uint64_t tag = geometry.tagOf(address);
+    int words = geometry.words_per_line;
+    int way = findWay(index, tag);
+    if (way >= 0) {
+        uint32_t *data = lineData(index, way);
+        std::copy(data, data + words, line);
+        stats.hits++;
+        if (inclusion == LLC_EXCLUSIVE) {
+            // 行移入 L1 后 L1 持有干净副本, 因此脏数据先写回内存
+            uint8_t &state = states[slot(index, way)];
+            if (state == MODIFIED) {
+                memory->writeLine(address, data, words);
+                stats.writebacks++;
+            }
+            state = INVALID;
+        } else {
+            replacement->touch(index, way);
+        }
+        return true;
+    }
+
+    stats.misses++;
+    memory->readLine(address, line, words);
+    if (inclusion != LLC_EXCLUSIVE) {
+        way = allocate(index);
+        std::copy(line, line + words, lineData(index, way));
+        setTag(index, way, tag);
+        states[slot(index, way)] = SHARED;
+        replacement->insert(index, way);
+    }
+    return false;
+}
+
+void LastLevelCache::writeLine(uint64_t address, const uint32_t *line) {
+    uint32_t index = geometry.indexOf(address);
+    int way = findWay(index, geometry.tagOf(address));
+    if (way < 0) {
+        memory->writeLine(address, line, geometry.words_per_line);
+        return;
+    }
+    std::copy(line, line + geometry.words_per_line, lineData(index, way));
+    states[slot(index, way)] = MODIFIED;
+    stats.l1_writebacks++;
+}
+
+void LastLevelCache::evict(uint64_t address, const uint32_t *line, bool dirty) {
+    if (!dirty && inclusion != LLC_EXCLUSIVE) {
+        return;
+    }
+    uint32_t index = geometry.indexOf(address);
+    uint64_t tag = geometry.tagOf(address);
+    int way = findWay(index, tag);
+    if (way >= 0) {
+        // 互斥模式下同一行可能由另一个 L1 先替换进来; 干净行的数据与已有的相同, 不覆盖脏状态
+        replacement->touch(index, way);
+        if (!dirty) {
+            return;
+        }
+    } else {
+        way = allocate(index);
+        setTag(index, way, tag);
+        states[slot(index, way)] = SHARED;
+        replacement->insert(index, way);
+    }
+    std::copy(line, line + geometry.words_per_line, lineData(index, way));
+    if (dirty) {
+        states[slot(index, way)] = MODIFIED;
+        stats.l1_writebacks++;
+    } else {
+        stats.victim_fills++;
+    }
+}
+
+void LastLevelCache::checkpoint(Checkpoint &cp) {
+    cp.array(tags);
+    cp.array(states);
+    cp.array(line_store);
+    replacement->checkpoint(cp);
+    cp.value(stats);
+    if (cp.isLoading()) {
+        std::transform(tags.begin(), tags.end(), tag_keys.begin(), tagKey);
+    }
+}
+
+void LastLevelCache::printStats() const {
+    uint64_t accesses = stats.accesses();
+    std::cout << "\nLLC (" << geometry.toString() << ", " << inclusionName(inclusion) << "): "
+              << "hits: " << stats.hits << ", misses: " << stats.misses;
+    if (accesses > 0) {
+        std::cout << " (hit rate " << (100.0 * stats.hits / accesses) << "%)";
+    }
+    std::cout << ", L1 writebacks: " << stats.l1_writebacks;
+    if (inclusion == LLC_EXCLUSIVE) {
+        std::cout << ", victim fills: " << stats.victim_fills;
+    }
+    std::cout << ", evictions: " << stats.evictions << ", writebacks: " << stats.writebacks;
+    if (inclusion == LLC_INCLUSIVE) {
+        std::cout << ", back-invalidations: " << stats.back_invalidations;
+    }
+    std::cout << std::endl;
+}
+
+const char *inclusionName(Inclusion inclusion) {
+    switch (inclusion) {
+    case LLC_EXCLUSIVE:
+        return "exclusive";
+    case LLC_NINE:
+        return "nine";
+    case LLC_INCLUSIVE:
+    default:
+        return "inclusive";
+    }
+}
+
+bool parseInclusion(const std::string &text, Inclusion &inclusion) {
+    if (text == "inclusive") {
+        inclusion = LLC_INCLUSIVE;
+    } else if (text == "exclusive") {
+        inclusion = LLC_EXCLUSIVE;
+    } else if (text == "nine") {
+        inclusion = LLC_NINE;
+    } else {
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,64 @@
+#ifndef LLC_HPP
+#define LLC_HPP
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "common.hpp"
+#include "geometry.hpp"
+#include "replacement.hpp"
+#include "stats.hpp"
+
+class Bus;
+class Memory;
+class Checkpoint;
+
+// 位于总线与内存之间、所有核共享的末级 cache. 只保存数据和干净/脏状态, 一致性仍由各 L1 维护.
+// 行大小与 L1 相同, 以整行为单位与 L1 交换数据
+class LastLevelCache {
+private:
+    const CacheGeometry geometry;
+    Inclusion inclusion;
+    // 与 L1 相同的结构数组布局: 状态只使用 INVALID, SHARED (干净) 和 MODIFIED (脏)
+    uint32_t tag_stride;
+    std::vector<uint64_t> tags;
+    std::vector<uint32_t> tag_keys;     // tag 的低 32 位, 供向量比较
+    std::vector<uint8_t> states;
+    std::vector<uint32_t> line_store;
+    std::unique_ptr<ReplacementPolicy> replacement;
+    Memory *memory;
+    Bus *bus;
+
+    uint32_t slot(uint32_t index, uint32_t way) const { return index * tag_stride + way; }
+    void setTag(uint32_t index, uint32_t way, uint64_t tag);
+    uint32_t *lineData(uint32_t index, uint32_t way) {
+        return &line_store[(index * geometry.ways + way) * geometry.words_per_line];
+    }
+    int findWay(uint32_t index, uint64_t tag) const;
+    // 在组内腾出一路: 优先无效路, 否则替换; 被替换的脏行写回内存, 包含模式下反向无效化 L1 副本
+    uint32_t allocate(uint32_t index);
+
+public:
+    LlcStats stats;
+
+    // 策略与几何不匹配时抛出 std::invalid_argument
+    LastLevelCache(const CacheGeometry &geometry, Inclusion inclusion, Replacement kind, Memory *memory, Bus *bus);
+    // L1 缺失时读取一行, 返回是否在 LLC 命中. 缺失时从内存读取, 除互斥模式外同时装入 LLC;
+    // 互斥模式命中时行移入 L1 (脏行先写回内存)
+    bool readLine(uint64_t address, uint32_t *line);
+    // L1 监听写回: LLC 中有该行时更新并置脏, 否则直接写内存
+    void writeLine(uint64_t address, const uint32_t *line);
+    // L1 替换一个有效行: 脏行写入 LLC (没有时分配); 互斥模式下干净行也装入 LLC
+    void evict(uint64_t address, const uint32_t *line, bool dirty);
+    const CacheGeometry &getGeometry() const { return geometry; }
+    Inclusion getInclusion() const { return inclusion; }
+    void checkpoint(Checkpoint &cp);
+    void printStats() const;
+};
+
+const char *inclusionName(Inclusion inclusion);
+// 解析 inclusive, exclusive, nine
+bool parseInclusion(const std::string &text, Inclusion &inclusion);
+
+#endif
@@ -1,106 +1,284 @@
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include <vector>
 #include <string>
-#include <sstream>
-#include "cache.hpp"
-#include "memory.hpp"
-#include "bus.hpp"
-#include "request.hpp"
-#include "core.hpp"
+#include <cstdlib>
+#include <cstdio>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <stdexcept>
 #include "generate_request.hpp"
+#include "simulator.hpp"
+#include "trace.hpp"
+#include "trace_import.hpp"
+#include "workload.hpp"
+
+// sweep 中的一次运行: 在基础配置上叠加一行选项
+struct SweepRun {
+    std::string label;
+    SimConfig config;
+    SimResult result;
+    std::string error;
+};
+
+// 读取 sweep 描述文件: 每个非空且不以 # 开头的行是一组选项, 同时作为该次运行的标签
+static bool loadSweep(const std::string &filename, const SimConfig &base, std::vector<SweepRun> &runs) {
+    std::ifstream file(filename);
+    if (!file.is_open()) {
+        std::cerr << "Error: Cannot open sweep file " << filename << std::endl;
+        return false;
+    }
+    std::string line;
+    int line_number = 0;
+    while (std::getline(file, line)) {
+        line_number++;
+        std::istringstream fields(line);
+        std::vector<std::string> args;
+        std::string field;
+        while (fields >> field) {
+            args.push_back(field);
+        }
+        if (args.empty() || args[0][0] == '#') {
+            continue;
+        }
+        SweepRun run;
+        run.config = base;
+        for (size_t i = 0; i < args.size(); i++) {
+            run.label += (i ? " " : "") + args[i];
+        }
+        for (size_t i = 0; i < args.size(); i++) {
+            int parsed = parseSimOption(args, i, run.config);
+            if (parsed <= 0) {
+                if (parsed == 0) {
+                    std::cerr << "Error: Unknown option " << args[i] << " in " << filename << ":" << line_number << std::endl;
+                }
+                return false;
+            }
+        }
+        // 每次运行只输出汇总表, 不写日志、统计文件和检查点, 避免多个线程写同一文件
+        run.config.quiet = true;
+        run.config.report = false;
+        run.config.log_filename.clear();
+        run.config.stats_filename.clear();
+        run.config.checkpoint_filename.clear();
+        runs.push_back(run);
+    }
+    if (runs.empty()) {
+        std::cerr << "Error: No runs in sweep file " << filename << std::endl;
+        return false;
+    }
+    return true;
+}
+
+static void runSweep(const TraceData &trace, std::vector<SweepRun> &runs, int num_threads) {
+    std::atomic<size_t> next(0);
+    auto worker = [&]() {
+        for (size_t i = next++; i < runs.size(); i = next++) {
+            try {
+                Simulator sim(runs[i].config);
+                if (!runs[i].config.restore_filename.empty() && !sim.restoreCheckpoint(runs[i].config.restore_filename)) {
+                    runs[i].error = "cannot restore " + runs[i].config.restore_filename;
+                    continue;
+                }
+                sim.run(trace);
+                sim.finish();
+                runs[i].result = sim.result();
+            } catch (const std::invalid_argument &e) {
+                runs[i].error = e.what();
+            }
+        }
+    };
+    std::vector<std::thread> threads;
+    for (int t = 0; t < num_threads; t++) {
+        threads.emplace_back(worker);
+    }
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+}
+
+static void printSweep(const std::vector<SweepRun> &runs, bool timing, bool llc) {
+    std::cout.flush();
+    size_t width = 5;
+    for (const SweepRun &run : runs) {
+        width = std::max(width, run.label.size());
+    }
+    std::printf("%-*s %8s %8s %8s %8s %8s %8s %8s %8s %8s %8s %8s %8s", static_cast<int>(width), "Run",
+                "Cycles", "Hits", "Misses", "HitRate", "BusRd", "BusWr", "BusInv", "WB", "C2C", "MemFill",
+                "Inval", "Probes");
+    if (llc) {
+        std::printf(" %8s %8s %8s", "LLCHit", "LLCMiss", "BackInv");
+    }
+    if (timing) {
+        std::printf(" %10s %8s", "TimedCyc", "AMAT");
+    }
+    std::printf("\n");
+    for (const SweepRun &run : runs) {
+        if (!run.error.empty()) {
+            std::printf("%-*s error: %s\n", static_cast<int>(width), run.label.c_str(), run.error.c_str());
+            continue;
+        }
+        const SimResult &r = run.result;
+        const CacheStats &s = r.total;
+        uint64_t accesses = s.hits() + s.misses();
+        double hit_rate = accesses ? 100.0 * s.hits() / accesses : 0.0;
+        std::printf("%-*s %8llu %8llu %8llu %7.2f%% %8llu %8llu %8llu %8llu %8llu %8llu %8llu %8llu",
+                    static_cast<int>(width), run.label.c_str(), (unsigned long long)r.cycles,
+                    (unsigned long long)s.hits(), (unsigned long long)s.misses(), hit_rate,
+                    (unsigned long long)s.bus_transactions[READ_MISS], (unsigned long long)s.bus_transactions[WRITE_MISS],
+                    (unsigned long long)s.bus_transactions[SET_INVALID], (unsigned long long)s.writebacks,
+                    (unsigned long long)s.cache_to_cache, (unsigned long long)s.memory_fills,
+                    (unsigned long long)s.invalidations_received, (unsigned long long)r.probes_sent);
+        if (llc) {
+            if (run.config.llc) {
+                std::printf(" %8llu %8llu %8llu", (unsigned long long)r.llc.hits, (unsigned long long)r.llc.misses,
+                            (unsigned long long)r.llc.back_invalidations);
+            } else {
+                std::printf(" %8s %8s %8s", "-", "-", "-");
+            }
+        }
+        if (timing) {
+            if (run.config.timing) {
+                std::printf(" %10llu %8.2f", (unsigned long long)r.timed_cycles, r.amat);
+            } else {
+                std::printf(" %10s %8s", "-", "-");
+            }
+        }
+        std::printf("\n");
+    }
+}
 
 int main(int argc, char* argv[]) {
-    if (argc < 2 || argc > 4) {
-        std::cerr << "Usage: ./sim [-omp] [-r] filename" << std::endl;
+    std::ios::sync_with_stdio(false);
+    if (argc < 2) {
+        std::cerr << "Usage: ./sim " << simOptionsUsage() << " [-sweep file] [-j N]"
+                  << " (filename | -format din|champsim file[,file...] | -gen pattern[:key=value,...])" << std::endl;
         return 1;
     }
 
-    bool omp_flag = false;
-    bool reduction_flag = false;
+    SimConfig config;
+    std::string sweep_filename;
+    int num_threads = 0;
     std::string filename;
-    for (int i = 1; i < argc; ++i) {
-        std::string arg = argv[i];
-        if (arg == "-omp") {
-            omp_flag = true;
-        } else if (arg == "-r") {
-            reduction_flag = true;
+    std::string format;
+    std::string workload;
+    std::vector<std::string> args(argv + 1, argv + argc);
+    for (size_t i = 0; i < args.size(); ++i) {
+        int parsed = parseSimOption(args, i, config);
+        if (parsed < 0) {
+            return 1;
+        } else if (parsed > 0) {
+            continue;
+        }
+        if (args[i] == "-sweep" && i + 1 < args.size()) {
+            sweep_filename = args[++i];
+        } else if (args[i] == "-j" && i + 1 < args.size()) {
+            num_threads = std::atoi(args[++i].c_str());
+        } else if (args[i] == "-format" && i + 1 < args.size()) {
+            format = args[++i];
+        } else if (args[i] == "-gen" && i + 1 < args.size()) {
+            workload = args[++i];
         } else {
-            filename = arg;
+            filename = args[i];
         }
     }
 
-    if (filename.empty()) {
+    std::unique_ptr<TraceReader> trace;
+    if (!workload.empty()) {
+        // 合成负载边生成边模拟, 不经过文件
+        WorkloadSpec spec;
+        if (!filename.empty() || !format.empty()) {
+            std::cerr << "Error: -gen cannot be combined with a trace file." << std::endl;
+            return 1;
+        }
+        if (!parseWorkload(workload, spec)) {
+            std::cerr << "Error: Invalid workload " << workload << "." << std::endl;
+            return 1;
+        }
+        trace.reset(new SyntheticTraceReader(spec));
+    } else if (filename.empty()) {
         std::cerr << "Error: No filename provided." << std::endl;
         return 1;
+    } else if (!format.empty()) {
+        trace = openImportedTrace(format, filename);
+        if (!trace) {
+            return 1;
+        }
+    } else {
+        trace = TraceReader::open(filename);
+        if (!trace) {
+            std::cout << "File does not exist. Creating and writing to " << filename << std::endl;
+            generateOmpRequest(filename, config.reduction, config.num_cores);
+            trace = TraceReader::open(filename);
+            if (!trace) {
+                std::cerr << "Error: Cannot create " << filename << std::endl;
+                return 1;
+            }
+        }
     }
-
-    std::ifstream file(filename);
-    if (!file.is_open()) {
-        std::cout << "File does not exist. Creating and writing to " << filename << std::endl;
-        generateOmpRequest(filename, reduction_flag);
-        file.open(filename);
-    }
-
-    std::vector<Core *> cores;
-    for (int i = 0; i < 4; i++) {
-        Core *core = new Core(i);
-        Cache *cache = new Cache(i);
-        core->setCache(cache);
-        cores.push_back(core);
+    // 二进制 trace 自带核数
+    if (!config.cores_given && trace->headerCores() > 0) {
+        config.num_cores = trace->headerCores();
     }
-
-    std::vector<int> initial_priorities = {0, 1, 2, 3};
-    Memory memory;
-    Bus bus(cores, &memory, initial_priorities);
-    for (Core* core : cores) {
-        core->getCache()->setBus(&bus);
-        core->getCache()->setMemory(&memory);
+    if (trace->headerCores() > config.num_cores) {
+        std::cerr << "Error: Trace needs " << trace->headerCores() << " cores." << std::endl;
+        return 1;
     }
+    trace->setNumCores(config.num_cores);
 
-    std::string line;
-    int cycle = 0;
-    while (std::getline(file, line)) {
-        std::istringstream iss(line);
-        std::string request_str;
-        std::vector<Request> requests;
-
-        while (std::getline(iss, request_str, ';')) {
-            request_str.erase(0, request_str.find_first_not_of(" \t"));
-            request_str.erase(request_str.find_last_not_of(" \t") + 1);
-            if (request_str != "NULL") {
-                Request request = parseRequest(request_str);
-                requests.push_back(request);
+    if (!sweep_filename.empty()) {
+        std::vector<SweepRun> runs;
+        if (!loadSweep(sweep_filename, config, runs)) {
+            return 1;
+        }
+        for (const SweepRun &run : runs) {
+            if (!checkSimConfig(run.config)) {
+                return 1;
+            }
+            if (run.config.num_cores != config.num_cores) {
+                std::cerr << "Error: Sweep runs must use the trace's core count (" << config.num_cores << ")." << std::endl;
+                return 1;
             }
         }
-        std::cout << "\n----------Cycle " << cycle++ << "----------\n" << std::endl;
-        if (!requests.empty()) {
-            bus.arbitrate(requests, omp_flag, reduction_flag);
+        // trace 只解析一次, 所有运行共享同一份只读数据
+        TraceData data;
+        data.load(*trace);
+        if (num_threads <= 0) {
+            num_threads = std::max(1u, std::thread::hardware_concurrency());
         }
+        num_threads = std::min<int>(num_threads, runs.size());
+        runSweep(data, runs, num_threads);
+        bool timing = false;
+        bool llc = false;
+        for (const SweepRun &run : runs) {
+            timing = timing || run.config.timing;
+            llc = llc || run.config.llc;
+        }
+        printSweep(runs, timing, llc);
+        return 0;
     }
 
-    bool queue_empty = false;
-    while (!queue_empty) {
-        queue_empty = true;
-        for (Core *core : cores) {
-            if (!core->isQueueEmpty()) {
-                queue_empty = false;
-                break;
-            }
+    if (!checkSimConfig(config)) {
+        return 1;
+    }
+    try {
+        Simulator sim(config);
+        if (!sim.openOutputs()) {
+            return 1;
         }
-        if (!queue_empty) {
-            std::cout << "\n----------Cycle " << cycle++ << "----------\n" << std::endl;
-            bus.arbitrate(std::vector<Request>(), omp_flag, reduction_flag);
+        if (!config.restore_filename.empty() && !sim.restoreCheckpoint(config.restore_filename)) {
+            return 1;
         }
-    }
-
-    file.close();
-    for (Core* core : cores) {
-        delete core->getCache();
-        delete core;
+        sim.run(*trace);
+        sim.finish();
+    } catch (const std::invalid_argument &e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
     }
 
     // generateRequestWithReduction("reduction.txt");
 
     return 0;
-}
\ No newline at end of file
+}
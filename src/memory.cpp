@@ -1,31 +1,110 @@
 #include "memory.hpp"
+#include "checkpoint.hpp"
 #include <iostream>
 #include <iomanip>
+#include <algorithm>
 
-Memory::Memory() {
-    int blocks_num = (size_KB * 1024) / block_size;
-    data.resize(blocks_num, 0);
+uint32_t *Memory::findPage(uint64_t page, bool allocate) {
+    if (page == last_page) {
+        return last_data;
+    }
+    auto it = pages.find(page);
+    if (it == pages.end()) {
+        if (!allocate) {
+            return nullptr;
+        }
+        it = pages.emplace(page, std::unique_ptr<uint32_t[]>(new uint32_t[PAGE_WORDS]())).first;
+    }
+    last_page = page;
+    last_data = it->second.get();
+    return last_data;
+}
+
+uint32_t Memory::readOneBlock(uint64_t address) {
+    uint64_t block_addr = address >> 2;
+    const uint32_t *page = findPage(block_addr / PAGE_WORDS, false);
+    return page != nullptr ? page[block_addr % PAGE_WORDS] : 0;
 }
 
-uint32_t Memory::readOneBlock(uint16_t address) {
-    uint16_t block_addr = address >> 2;
-    if (block_addr < data.size()) {
-        return data[block_addr];
+void Memory::writeOneBlock(uint64_t address, uint32_t value) {
+    uint64_t block_addr = address >> 2;
+    findPage(block_addr / PAGE_WORDS, true)[block_addr % PAGE_WORDS] = value;
+}
+
+void Memory::readLine(uint64_t address, uint32_t *dst, int words) {
+    uint64_t first = (address >> 2) & ~static_cast<uint64_t>(words - 1);
+    // 行不超过一页时只查一次页; 更大的行逐页处理
+    for (int i = 0; i < words;) {
+        uint64_t block_addr = first + i;
+        uint32_t offset = block_addr % PAGE_WORDS;
+        int count = std::min<uint64_t>(words - i, PAGE_WORDS - offset);
+        const uint32_t *page = findPage(block_addr / PAGE_WORDS, false);
+        if (page != nullptr) {
+            std::copy(page + offset, page + offset + count, dst + i);
+        } else {
+            std::fill(dst + i, dst + i + count, 0);
+        }
+        i += count;
     }
-    return 0;
 }
 
-void Memory::writeOneBlock(uint16_t address, uint32_t value) {
-    uint16_t block_addr = address >> 2;
-    if (block_addr < data.size()) {
-        data[block_addr] = value;
+void Memory::writeLine(uint64_t address, const uint32_t *src, int words) {
+    uint64_t first = (address >> 2) & ~static_cast<uint64_t>(words - 1);
+    for (int i = 0; i < words;) {
+        uint64_t block_addr = first + i;
+        uint32_t offset = block_addr % PAGE_WORDS;
+        int count = std::min<uint64_t>(words - i, PAGE_WORDS - offset);
+        uint32_t *page = findPage(block_addr / PAGE_WORDS, true);
+        std::copy(src + i, src + i + count, page + offset);
+        i += count;
     }
 }
 
-void Memory::printState(int start, int end) {
+void Memory::copyLines(const Memory &other, int words, const std::function<bool(uint64_t)> &owns) {
+    uint32_t step = std::min<uint32_t>(words, PAGE_WORDS);
+    for (const auto &entry : other.pages) {
+        const uint32_t *from = entry.second.get();
+        for (uint32_t offset = 0; offset < PAGE_WORDS; offset += step) {
+            uint64_t address = (entry.first * PAGE_WORDS + offset) << 2;
+            if (owns(address & ~(static_cast<uint64_t>(words) * 4 - 1))) {
+                uint32_t *page = findPage(entry.first, true);
+                std::copy(from + offset, from + offset + step, page + offset);
+            }
+        }
+    }
+}
+
+void Memory::printState(uint64_t start, uint64_t end) {
     std::cout << "Memory State (first " << end << " blocks):\n";
-    for (int i = start; i < end && i < data.size(); i++) {
+    for (uint64_t i = start; i < end; i++) {
         std::cout << "Block 0x" << std::hex << (i << 2) 
-                  << ": 0x" << std::setw(8) << std::setfill('0') << data[i] << "\n";
+                  << ": 0x" << std::setw(8) << std::setfill('0') << readOneBlock(i << 2) << "\n";
+    }
+}
+
+void Memory::checkpoint(Checkpoint &cp) {
+    uint64_t count = pages.size();
+    cp.value(count);
+    if (cp.isLoading()) {
+        pages.clear();
+        last_page = UINT64_MAX;
+        last_data = nullptr;
+        for (uint64_t i = 0; i < count && cp.good(); i++) {
+            uint64_t page = 0;
+            cp.value(page);
+            cp.bytes(findPage(page, true), PAGE_WORDS * sizeof(uint32_t));
+        }
+        return;
     }
-}
\ No newline at end of file
+    // 按页号顺序写出, 相同的内存内容总是得到相同的文件
+    std::vector<uint64_t> numbers;
+    numbers.reserve(count);
+    for (const auto &entry : pages) {
+        numbers.push_back(entry.first);
+    }
+    std::sort(numbers.begin(), numbers.end());
+    for (uint64_t page : numbers) {
+        cp.value(page);
+        cp.bytes(pages[page].get(), PAGE_WORDS * sizeof(uint32_t));
+    }
+}
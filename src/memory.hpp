@@ -3,18 +3,38 @@
 
 #include <vector>
 #include <cstdint>
+#include <functional>
+#include <memory>
+#include <unordered_map>
 
+class Checkpoint;
+
+// 稀疏分页内存: 64 位物理地址, 只为写过的页分配空间, 从未写过的地址读出 0.
+// 最近访问的页单独缓存, 同一页上的连续访问不需要查哈希表.
 class Memory {
 private:
-    std::vector<uint32_t> data;
-    const int size_KB = 8;
-    const int block_size = 4;
-    
+    static constexpr int PAGE_BITS = 12;                            // 4 KiB 页
+    static constexpr uint32_t PAGE_WORDS = (1u << PAGE_BITS) / 4;   // 每页的 4 字节块数
+
+    std::unordered_map<uint64_t, std::unique_ptr<uint32_t[]>> pages;
+    uint64_t last_page = UINT64_MAX;
+    uint32_t *last_data = nullptr;
+
+    // 返回页号对应的页, allocate 为 false 且该页不存在时返回 nullptr
+    uint32_t *findPage(uint64_t page, bool allocate);
+
 public:
-    Memory();
-    uint32_t readOneBlock(uint16_t address);
-    void writeOneBlock(uint16_t address, uint32_t value);
-    void printState(int start = 0, int end = 10);
+    uint32_t readOneBlock(uint64_t address);
+    void writeOneBlock(uint64_t address, uint32_t value);
+    // 按 cache 行读写: words 个连续的 4 字节块, 起始地址按行对齐
+    void readLine(uint64_t address, uint32_t *dst, int words);
+    void writeLine(uint64_t address, const uint32_t *src, int words);
+    void printState(uint64_t start = 0, uint64_t end = 10);
+    size_t pageCount() const { return pages.size(); }
+    // 从 other 复制 owns(行地址) 为真的行, 行大小为 words 个块; 用于合并分片回放的结果
+    void copyLines(const Memory &other, int words, const std::function<bool(uint64_t)> &owns);
+    // 保存或恢复所有已分配的页
+    void checkpoint(Checkpoint &cp);
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,217 @@
+#include "prefetcher.hpp"
+#include "checkpoint.hpp"
+#include <cstdlib>
+#include <iostream>
+
+#define STRIDE_TABLE_SIZE 16        // 步长表的区域数
+#define STRIDE_REGION_BITS 12       // 4 KiB 区域
+#define STRIDE_CONFIDENCE 2         // 同一步长至少确认两次才预取
+#define STREAM_COUNT 4              // 同时跟踪的流数
+#define STREAM_WINDOW 16            // 缺失与流的下一行相差不超过这么多行时仍算同一个流
+
+Prefetcher::Prefetcher(const CacheGeometry &geometry, uint32_t degree)
+    : line_bytes(geometry.line_bytes), degree(degree) {}
+
+void Prefetcher::propose(int64_t line, std::vector<uint64_t> &candidates) const {
+    if (line >= 0) {
+        candidates.push_back(static_cast<uint64_t>(line) * line_bytes);
+    }
+}
+
+void NextLinePrefetcher::observe(uint64_t line_address, bool trigger, std::vector<uint64_t> &candidates) {
+    if (!trigger) {
+        return;
+    }
+    int64_t line = lineOf(line_address);
+    for (uint32_t k = 1; k <= degree; k++) {
+        propose(line + k, candidates);
+    }
+}
+
+StridePrefetcher::StridePrefetcher(const CacheGeometry &geometry, uint32_t degree)
+    : Prefetcher(geometry, degree), table(STRIDE_TABLE_SIZE) {}
+
+void StridePrefetcher::observe(uint64_t line_address, bool, std::vector<uint64_t> &candidates) {
+    uint64_t region = line_address >> STRIDE_REGION_BITS;
+    int64_t line = lineOf(line_address);
+    clock++;
+    Entry *entry = nullptr;
+    Entry *oldest = &table[0];
+    for (Entry &e : table) {
+        if (e.region == region) {
+            entry = &e;
+            break;
+        }
+        if (e.used < oldest->used) {
+            oldest = &e;
+        }
+    }
+    if (entry == nullptr) {
+        *oldest = Entry();
+        oldest->region = region;
+        oldest->last_line = line;
+        oldest->used = clock;
+        return;
+    }
+    entry->used = clock;
+    int64_t delta = line - entry->last_line;
+    // 同一行内的连续访问不改变步长
+    if (delta == 0) {
+        return;
+    }
+    if (delta == entry->stride) {
+        entry->confidence = entry->confidence < 3 ? entry->confidence + 1 : 3;
+    } else {
+        entry->stride = delta;
+        entry->confidence = 0;
+    }
+    entry->last_line = line;
+    if (entry->confidence < STRIDE_CONFIDENCE) {
+        return;
+    }
+    for (uint32_t k = 1; k <= degree; k++) {
+        int64_t target = line + entry->stride * static_cast<int64_t>(k);
+        if (target < 0 || (static_cast<uint64_t>(target) * line_bytes) >> STRIDE_REGION_BITS != region) {
+            break;
+        }
+        propose(target, candidates);
+    }
+}
+
+void StridePrefetcher::checkpoint(Checkpoint &cp) {
+    cp.array(table);
+    cp.value(clock);
+}
+
+StreamPrefetcher::StreamPrefetcher(const CacheGeometry &geometry, uint32_t degree)
+    : Prefetcher(geometry, degree), streams(STREAM_COUNT) {}
+
+// 需求访问到达 line: 预取到领先 degree 行为止
+void StreamPrefetcher::advance(Stream &stream, int64_t line, std::vector<uint64_t> &candidates) {
+    stream.head = line;
+    stream.used = clock;
+    int64_t target = line + stream.direction * static_cast<int64_t>(degree);
+    while ((target - stream.tail) * stream.direction > 0) {
+        stream.tail += stream.direction;
+        propose(stream.tail, candidates);
+    }
+}
+
+void StreamPrefetcher::observe(uint64_t line_address, bool trigger, std::vector<uint64_t> &candidates) {
+    if (!trigger) {
+        return;
+    }
+    int64_t line = lineOf(line_address);
+    clock++;
+    // 每次触发访问都更新, 新流才能与真正的上一次缺失比较方向
+    int64_t previous_miss = last_miss;
+    last_miss = line;
+    // 落在某个流已预取的范围内, 或紧接在其后的窗口内
+    for (Stream &stream : streams) {
+        if (!stream.valid) {
+            continue;
+        }
+        int64_t ahead = (line - stream.head) * stream.direction;
+        int64_t covered = (stream.tail - stream.head) * stream.direction;
+        if (ahead > 0 && ahead <= covered + STREAM_WINDOW) {
+            if (ahead > covered) {
+                stream.tail = line;
+            }
+            advance(stream, line, candidates);
+            return;
+        }
+    }
+    // 新的流: 紧接在上一次缺失之前的缺失说明在反向扫描
+    Stream *victim = &streams[0];
+    for (Stream &stream : streams) {
+        if (!stream.valid) {
+            victim = &stream;
+            break;
+        }
+        if (stream.used < victim->used) {
+            victim = &stream;
+        }
+    }
+    victim->valid = true;
+    victim->direction = line + 1 == previous_miss ? -1 : 1;
+    victim->head = line;
+    victim->tail = line;
+    advance(*victim, line, candidates);
+}
+
+void StreamPrefetcher::checkpoint(Checkpoint &cp) {
+    cp.array(streams);
+    cp.value(last_miss);
+    cp.value(clock);
+}
+
+std::unique_ptr<Prefetcher> makePrefetcher(Prefetch kind, const CacheGeometry &geometry, uint32_t degree) {
+    switch (kind) {
+    case PREFETCH_NEXT_LINE:
+        return std::unique_ptr<Prefetcher>(new NextLinePrefetcher(geometry, degree));
+    case PREFETCH_STRIDE:
+        return std::unique_ptr<Prefetcher>(new StridePrefetcher(geometry, degree));
+    case PREFETCH_STREAM:
+        return std::unique_ptr<Prefetcher>(new StreamPrefetcher(geometry, degree));
+    case PREFETCH_NONE:
+    default:
+        return nullptr;
+    }
+}
+
+bool parsePrefetch(const std::string &text, Prefetch &kind, uint32_t &degree) {
+    size_t colon = text.find(':');
+    std::string name = text.substr(0, colon);
+    if (name == "none" && colon == std::string::npos) {
+        kind = PREFETCH_NONE;
+        return true;
+    }
+    if (name == "next") {
+        kind = PREFETCH_NEXT_LINE;
+    } else if (name == "stride") {
+        kind = PREFETCH_STRIDE;
+    } else if (name == "stream") {
+        kind = PREFETCH_STREAM;
+    } else {
+        return false;
+    }
+    if (colon != std::string::npos) {
+        const char *p = text.c_str() + colon + 1;
+        char *end = nullptr;
+        long value = std::strtol(p, &end, 10);
+        if (end == p || *end != '\0' || value < 1 || value > 64) {
+            return false;
+        }
+        degree = static_cast<uint32_t>(value);
+    }
+    return true;
+}
+
+const char *prefetchName(Prefetch kind) {
+    switch (kind) {
+    case PREFETCH_NEXT_LINE:
+        return "next";
+    case PREFETCH_STRIDE:
+        return "stride";
+    case PREFETCH_STREAM:
+        return "stream";
+    case PREFETCH_NONE:
+    default:
+        return "none";
+    }
+}
+
+void printPrefetchStats(Prefetch kind, uint32_t degree, const PrefetchStats &stats, uint64_t demand_misses) {
+    std::cout << "\nPrefetcher (" << prefetchName(kind) << ", degree " << degree << "): issued: " << stats.issued
+              << ", useful: " << stats.useful;
+    if (stats.issued > 0) {
+        std::cout << " (accuracy " << (100.0 * stats.useful / stats.issued) << "%";
+        // 有用的预取各自把一次缺失变成了命中
+        std::cout << ", coverage " << (100.0 * stats.useful / (stats.useful + demand_misses)) << "%)";
+    }
+    std::cout << ", unused evictions: " << stats.unused_evictions
+              << ", useless invalidations: " << stats.useless_invalidations
+              << ", shared fills: " << stats.shared_fills
+              << ", dropped: " << stats.dropped
+              << ", late: " << stats.late << std::endl;
+}
@@ -0,0 +1,93 @@
+#ifndef PREFETCHER_HPP
+#define PREFETCHER_HPP
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "common.hpp"
+#include "geometry.hpp"
+#include "stats.hpp"
+
+class Checkpoint;
+
+// 硬件预取器: 观察所属 cache 的每次需求访问, 给出要预取的行地址.
+// 预取的行装入 L1 本身并参与一致性, 因此会被其他核的写无效化; 候选行由 cache 排队,
+// 再作为低优先级请求交给总线仲裁
+class Prefetcher {
+protected:
+    uint32_t line_bytes;
+    uint32_t degree;                    // 每次触发最多预取的行数 (流预取器中为预取距离)
+
+    uint64_t lineOf(uint64_t address) const { return address / line_bytes; }
+    // 把第 line 行加入候选, 小于 0 的行号被忽略
+    void propose(int64_t line, std::vector<uint64_t> &candidates) const;
+
+public:
+    Prefetcher(const CacheGeometry &geometry, uint32_t degree);
+    virtual ~Prefetcher() {}
+    // 每次需求访问之后调用; trigger 表示缺失或第一次命中预取的行. 候选行地址追加到 candidates
+    virtual void observe(uint64_t line_address, bool trigger, std::vector<uint64_t> &candidates) = 0;
+    // 保存或恢复预取器的内部状态
+    virtual void checkpoint(Checkpoint &) {}
+};
+
+// 下一行预取: 每次触发预取紧随其后的 degree 行 (带标记的下一行预取)
+class NextLinePrefetcher : public Prefetcher {
+public:
+    using Prefetcher::Prefetcher;
+    void observe(uint64_t line_address, bool trigger, std::vector<uint64_t> &candidates) override;
+};
+
+// 不依赖 PC 的步长预取: 按 4 KiB 区域记录最近访问的行和步长, 同一步长连续出现后
+// 沿该步长预取 degree 行, 不跨越区域边界
+class StridePrefetcher : public Prefetcher {
+private:
+    struct Entry {
+        uint64_t region = UINT64_MAX;
+        int64_t last_line = 0;
+        int64_t stride = 0;
+        uint32_t confidence = 0;        // 2 位饱和计数
+        uint64_t used = 0;              // 最近使用时刻, 用于替换
+    };
+    std::vector<Entry> table;
+    uint64_t clock = 0;
+
+public:
+    StridePrefetcher(const CacheGeometry &geometry, uint32_t degree);
+    void observe(uint64_t line_address, bool trigger, std::vector<uint64_t> &candidates) override;
+    void checkpoint(Checkpoint &cp) override;
+};
+
+// 流缓冲式预取: 若干个流各记录方向、最近的需求行和已预取到的行. 缺失分配新的流,
+// 需求访问落在某个流已预取的范围内时流前进, 保持领先需求 degree 行
+class StreamPrefetcher : public Prefetcher {
+private:
+    struct Stream {
+        bool valid = false;
+        int64_t direction = 1;
+        int64_t head = 0;               // 最近一次需求访问的行
+        int64_t tail = 0;               // 已预取的最远一行
+        uint64_t used = 0;
+    };
+    std::vector<Stream> streams;
+    int64_t last_miss = -1;
+    uint64_t clock = 0;
+
+    void advance(Stream &stream, int64_t line, std::vector<uint64_t> &candidates);
+
+public:
+    StreamPrefetcher(const CacheGeometry &geometry, uint32_t degree);
+    void observe(uint64_t line_address, bool trigger, std::vector<uint64_t> &candidates) override;
+    void checkpoint(Checkpoint &cp) override;
+};
+
+// kind 为 PREFETCH_NONE 时返回空指针
+std::unique_ptr<Prefetcher> makePrefetcher(Prefetch kind, const CacheGeometry &geometry, uint32_t degree);
+// 解析 "none", 或 "next", "stride", "stream" 后接可选的 ":degree"
+bool parsePrefetch(const std::string &text, Prefetch &kind, uint32_t &degree);
+const char *prefetchName(Prefetch kind);
+// demand_misses 为所有核的需求缺失数, 用于计算覆盖率
+void printPrefetchStats(Prefetch kind, uint32_t degree, const PrefetchStats &stats, uint64_t demand_misses);
+
+#endif
@@ -0,0 +1,203 @@
+#include "profile.hpp"
+
+#ifdef SIM_PROFILE
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define PROFILE_USE_RDTSC 1
+#endif
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#define PROFILE_USE_PERF 1
+#endif
+
+namespace {
+
+const char *const PHASE_NAMES[PROF_PHASES] = {"trace", "parse", "arbitrate", "access", "broadcast", "snoop", "output"};
+
+struct PhaseTotals {
+    uint64_t calls = 0;
+    uint64_t total = 0;
+    uint64_t self = 0;
+};
+
+inline uint64_t ticks() {
+#ifdef PROFILE_USE_RDTSC
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+#endif
+}
+
+// 整次运行的硬件计数器. 每个作用域都读计数器需要一次系统调用, 代价远大于被测的代码,
+// 因此只在开始和结束时各读一次
+struct PerfCounter {
+    const char *name;
+    uint32_t type;
+    uint64_t config;
+    int fd;
+};
+
+class Profiler {
+private:
+    std::mutex mutex;
+    PhaseTotals totals[PROF_PHASES];
+    uint64_t start_ticks;
+    std::chrono::steady_clock::time_point start_time;
+#ifdef PROFILE_USE_PERF
+    PerfCounter counters[4] = {
+        {"cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, -1},
+        {"instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, -1},
+        {"cache-misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, -1},
+        {"branch-misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES, -1},
+    };
+    bool perf_requested = false;
+
+    void openCounters() {
+        const char *env = std::getenv("SIM_PROFILE_PERF");
+        perf_requested = env != nullptr && std::strcmp(env, "0") != 0;
+        if (!perf_requested) {
+            return;
+        }
+        for (PerfCounter &counter : counters) {
+            perf_event_attr attr;
+            std::memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = counter.type;
+            attr.config = counter.config;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.inherit = 1;           // 包含之后创建的线程 (-shards)
+            counter.fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+        }
+    }
+
+    void printCounters() {
+        if (!perf_requested) {
+            return;
+        }
+        uint64_t values[4] = {};
+        bool any = false;
+        for (int i = 0; i < 4; i++) {
+            if (counters[i].fd >= 0 && read(counters[i].fd, &values[i], sizeof(values[i])) == sizeof(values[i])) {
+                any = true;
+            } else {
+                counters[i].fd = -1;
+            }
+        }
+        if (!any) {
+            std::fprintf(stderr, "perf: hardware counters unavailable (check /proc/sys/kernel/perf_event_paranoid)\n");
+            return;
+        }
+        std::fprintf(stderr, "perf:");
+        for (int i = 0; i < 4; i++) {
+            if (counters[i].fd >= 0) {
+                std::fprintf(stderr, " %s %llu", counters[i].name, static_cast<unsigned long long>(values[i]));
+                close(counters[i].fd);
+            }
+        }
+        if (counters[0].fd >= 0 && counters[1].fd >= 0 && values[0] > 0) {
+            std::fprintf(stderr, " (IPC %.2f)", static_cast<double>(values[1]) / values[0]);
+        }
+        std::fputc('\n', stderr);
+    }
+#else
+    void openCounters() {}
+    void printCounters() {}
+#endif
+
+public:
+    Profiler() : start_ticks(ticks()), start_time(std::chrono::steady_clock::now()) {
+        openCounters();
+    }
+
+    void merge(const PhaseTotals *phases) {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (int p = 0; p < PROF_PHASES; p++) {
+            totals[p].calls += phases[p].calls;
+            totals[p].total += phases[p].total;
+            totals[p].self += phases[p].self;
+        }
+    }
+
+    // 各线程的线程局部表在线程结束时合并, 主线程的表在静态对象析构之前合并, 因此这里已包含全部数据
+    ~Profiler() {
+        double wall_ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start_time).count();
+        uint64_t elapsed_ticks = ticks() - start_ticks;
+        double ns_per_tick = elapsed_ticks > 0 ? wall_ns / elapsed_ticks : 1.0;
+#ifndef PROFILE_USE_RDTSC
+        ns_per_tick = 1.0;
+#endif
+        // 输出到 stderr, stdout 上的模拟结果与未启用剖析时相同
+        std::fprintf(stderr, "\nProfile (wall time %.3f ms)\n", wall_ns / 1e6);
+        std::fprintf(stderr, "%-10s %12s %12s %12s %8s %10s\n", "Phase", "Calls", "Total ms", "Self ms", "Self %",
+                     "ns/call");
+        double attributed = 0.0;
+        for (int p = 0; p < PROF_PHASES; p++) {
+            const PhaseTotals &t = totals[p];
+            if (t.calls == 0) {
+                continue;
+            }
+            double total_ns = t.total * ns_per_tick;
+            double self_ns = t.self * ns_per_tick;
+            attributed += self_ns;
+            std::fprintf(stderr, "%-10s %12llu %12.3f %12.3f %7.1f%% %10.1f\n", PHASE_NAMES[p],
+                         static_cast<unsigned long long>(t.calls), total_ns / 1e6, self_ns / 1e6,
+                         wall_ns > 0 ? 100.0 * self_ns / wall_ns : 0.0, total_ns / t.calls);
+        }
+        std::fprintf(stderr, "%-10s %12s %12s %12.3f %7.1f%%\n", "other", "", "", (wall_ns - attributed) / 1e6,
+                     wall_ns > 0 ? 100.0 * (wall_ns - attributed) / wall_ns : 0.0);
+        printCounters();
+    }
+};
+
+Profiler &profiler() {
+    static Profiler instance;
+    return instance;
+}
+
+// 在静态初始化时构造, 墙钟时间与计数器从程序开始计算
+Profiler &profiler_at_startup = profiler();
+
+struct ThreadProfile {
+    PhaseTotals phases[PROF_PHASES];
+    uint32_t active[PROF_PHASES] = {};      // 每个阶段正在进行的层数, 递归调用只在最外层计入 Total
+    ScopedTimer *current = nullptr;
+
+    ~ThreadProfile() { profiler().merge(phases); }
+};
+
+thread_local ThreadProfile thread_profile;
+
+}
+
+ScopedTimer::ScopedTimer(ProfilePhase phase) : phase(phase), start(ticks()), parent(thread_profile.current) {
+    thread_profile.current = this;
+    thread_profile.active[phase]++;
+}
+
+ScopedTimer::~ScopedTimer() {
+    uint64_t elapsed = ticks() - start;
+    ThreadProfile &profile = thread_profile;
+    PhaseTotals &totals = profile.phases[phase];
+    totals.calls++;
+    totals.self += elapsed - child_ticks;
+    if (--profile.active[phase] == 0) {
+        totals.total += elapsed;
+    }
+    if (parent != nullptr) {
+        parent->child_ticks += elapsed;
+    }
+    profile.current = parent;
+}
+
+#endif
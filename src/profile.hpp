@@ -0,0 +1,47 @@
+#ifndef PROFILE_HPP
+#define PROFILE_HPP
+
+#include <cstdint>
+
+// 模拟器自身的热点剖析. 以 -DSIM_PROFILE=ON 配置时启用, 否则 PROFILE_SCOPE 展开为空, 不产生任何代码.
+// 启用时每个作用域记录调用次数与耗时 (x86 上用 rdtsc, 其他平台用 steady_clock), 程序退出时向 stderr 打印
+// 各阶段的累计时间. 阶段可以嵌套: Total 含被调用的其他阶段, Self 只含本阶段自己的时间.
+// 设置环境变量 SIM_PROFILE_PERF=1 时还通过 perf_event_open 读取整次运行的硬件计数器 (仅 Linux)
+enum ProfilePhase {
+    PROF_TRACE,         // 读取 trace 的一个周期 (含解析)
+    PROF_PARSE,         // parseRequest
+    PROF_ARBITRATE,     // Bus::arbitrate: 入队、排序与调度
+    PROF_ACCESS,        // Cache::access
+    PROF_BROADCAST,     // Bus::broadcast
+    PROF_SNOOP,         // Cache::handleBusRequest
+    PROF_OUTPUT,        // 逐请求打印、事件日志与统计文件
+    PROF_PHASES
+};
+
+#ifdef SIM_PROFILE
+
+class ScopedTimer {
+private:
+    ProfilePhase phase;
+    uint64_t start;
+    uint64_t child_ticks = 0;   // 嵌套在本作用域内的其他计时作用域的耗时
+    ScopedTimer *parent;
+
+public:
+    explicit ScopedTimer(ProfilePhase phase);
+    ~ScopedTimer();
+    ScopedTimer(const ScopedTimer &) = delete;
+    ScopedTimer &operator=(const ScopedTimer &) = delete;
+};
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_SCOPE(phase) ScopedTimer PROFILE_CONCAT(profile_timer_, __LINE__)(phase)
+
+#else
+
+#define PROFILE_SCOPE(phase) ((void)0)
+
+#endif
+
+#endif
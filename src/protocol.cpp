@@ -0,0 +1,82 @@
+#include "protocol.hpp"
+
+// 表项顺序与 State 一致: MODIFIED, EXCLUSIVE, SHARED, INVALID, OWNED, FORWARD.
+// 协议中不存在的状态使用与 INVALID 相同的表项.
+#define NO_SNOOP {INVALID, false, false, false}
+#define TO_INVALID {INVALID, false, false, false}
+#define UNUSED_WRITE {MODIFIED, WRITE_MISS}     // 只有有效块才会写命中
+
+const ProtocolTable MSI_PROTOCOL = {
+    "MSI",
+    {SHARED, SHARED},
+    {{MODIFIED, -1}, UNUSED_WRITE, {MODIFIED, SET_INVALID}, UNUSED_WRITE, UNUSED_WRITE, UNUSED_WRITE},
+    {
+        // READ_MISS
+        {{SHARED, true, true, true}, NO_SNOOP, {SHARED, true, false, true}, NO_SNOOP, NO_SNOOP, NO_SNOOP},
+        // WRITE_MISS
+        {{INVALID, false, true, false}, NO_SNOOP, TO_INVALID, NO_SNOOP, NO_SNOOP, NO_SNOOP},
+        // SET_INVALID
+        {TO_INVALID, NO_SNOOP, TO_INVALID, NO_SNOOP, NO_SNOOP, NO_SNOOP},
+    },
+    {true, false, false, false, false, false},
+};
+
+const ProtocolTable MESI_PROTOCOL = {
+    "MESI",
+    {EXCLUSIVE, SHARED},
+    {{MODIFIED, -1}, {MODIFIED, -1}, {MODIFIED, SET_INVALID}, UNUSED_WRITE, UNUSED_WRITE, UNUSED_WRITE},
+    {
+        {{SHARED, true, true, true}, {SHARED, true, false, true}, {SHARED, true, false, true},
+         NO_SNOOP, NO_SNOOP, NO_SNOOP},
+        {{INVALID, false, true, false}, TO_INVALID, TO_INVALID, NO_SNOOP, NO_SNOOP, NO_SNOOP},
+        {TO_INVALID, TO_INVALID, TO_INVALID, NO_SNOOP, NO_SNOOP, NO_SNOOP},
+    },
+    {true, false, false, false, false, false},
+};
+
+// M 被读时转为 O 并继续持有脏数据, 不写回内存
+const ProtocolTable MOESI_PROTOCOL = {
+    "MOESI",
+    {EXCLUSIVE, SHARED},
+    {{MODIFIED, -1}, {MODIFIED, -1}, {MODIFIED, SET_INVALID}, UNUSED_WRITE, {MODIFIED, SET_INVALID}, UNUSED_WRITE},
+    {
+        {{OWNED, true, false, true}, {SHARED, true, false, true}, {SHARED, true, false, true},
+         NO_SNOOP, {OWNED, true, false, true}, NO_SNOOP},
+        {{INVALID, false, true, false}, TO_INVALID, TO_INVALID, NO_SNOOP, {INVALID, false, true, false}, NO_SNOOP},
+        {TO_INVALID, TO_INVALID, TO_INVALID, NO_SNOOP, TO_INVALID, NO_SNOOP},
+    },
+    {true, false, false, false, true, false},
+};
+
+// 只有 F (或 E/M) 副本提供数据, S 副本只声明共享; 最新的读者成为 F
+const ProtocolTable MESIF_PROTOCOL = {
+    "MESIF",
+    {EXCLUSIVE, FORWARD},
+    {{MODIFIED, -1}, {MODIFIED, -1}, {MODIFIED, SET_INVALID}, UNUSED_WRITE, UNUSED_WRITE, {MODIFIED, SET_INVALID}},
+    {
+        {{SHARED, true, true, true}, {SHARED, true, false, true}, {SHARED, false, false, true},
+         NO_SNOOP, NO_SNOOP, {SHARED, true, false, true}},
+        {{INVALID, false, true, false}, TO_INVALID, TO_INVALID, NO_SNOOP, NO_SNOOP, TO_INVALID},
+        {TO_INVALID, TO_INVALID, TO_INVALID, NO_SNOOP, NO_SNOOP, TO_INVALID},
+    },
+    {true, false, false, false, false, false},
+};
+
+const ProtocolTable *findProtocol(const std::string &name) {
+    if (name == "msi") return &MSI_PROTOCOL;
+    if (name == "mesi") return &MESI_PROTOCOL;
+    if (name == "moesi") return &MOESI_PROTOCOL;
+    if (name == "mesif") return &MESIF_PROTOCOL;
+    return nullptr;
+}
+
+char stateChar(State state) {
+    switch (state) {
+        case MODIFIED: return 'M';
+        case EXCLUSIVE: return 'E';
+        case SHARED: return 'S';
+        case OWNED: return 'O';
+        case FORWARD: return 'F';
+        default: return 'I';
+    }
+}
@@ -0,0 +1,40 @@
+#ifndef PROTOCOL_HPP
+#define PROTOCOL_HPP
+
+#include <string>
+#include "common.hpp"
+
+// 监听方收到总线请求后的动作
+struct SnoopAction {
+    State next;
+    bool supply;        // 提供整行数据 (cache-to-cache)
+    bool writeback;     // 先把脏数据写回内存
+    bool shared;        // 向请求方声明自己持有该行
+};
+
+// 写命中时的动作
+struct WriteHitAction {
+    State next;
+    int bus_request;    // 需要广播的 BusRequest, -1 表示不需要总线
+};
+
+// 一致性协议的状态转移表, 访问和监听路径只查表不做协议相关的分支
+struct ProtocolTable {
+    const char *name;
+    State read_fill[2];                         // 读缺失填充的状态, 下标为是否有其他共享者
+    WriteHitAction write_hit[NUM_STATES];
+    SnoopAction snoop[3][NUM_STATES];           // [BusRequest][State]
+    bool dirty[NUM_STATES];                     // 替换时是否需要写回
+};
+
+extern const ProtocolTable MSI_PROTOCOL;
+extern const ProtocolTable MESI_PROTOCOL;
+extern const ProtocolTable MOESI_PROTOCOL;
+extern const ProtocolTable MESIF_PROTOCOL;
+
+// 按名字 (msi, mesi, moesi, mesif) 查找协议, 未知名字返回空指针
+const ProtocolTable *findProtocol(const std::string &name);
+
+char stateChar(State state);
+
+#endif
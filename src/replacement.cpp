@@ -0,0 +1,201 @@
+#include "replacement.hpp"
+#include "checkpoint.hpp"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#define RRPV_MAX 3
+
+// xorshift32, 状态为 0 时不会再变化, 因此初始化时保证非零
+static uint32_t nextRandom(uint8_t *state) {
+    uint32_t x;
+    std::memcpy(&x, state, sizeof(x));
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    std::memcpy(state, &x, sizeof(x));
+    return x;
+}
+
+static void seedRandom(uint8_t *state, uint32_t seed, uint32_t set) {
+    uint32_t x = (seed + 1) * 0x9E3779B9u ^ (set + 1) * 0x85EBCA6Bu;
+    if (x == 0) {
+        x = 1;
+    }
+    std::memcpy(state, &x, sizeof(x));
+}
+
+ReplacementPolicy::ReplacementPolicy(const CacheGeometry &geometry, uint32_t stride)
+    : ways(geometry.ways), stride(stride), meta(static_cast<size_t>(geometry.sets) * stride, 0) {}
+
+void ReplacementPolicy::copySet(const ReplacementPolicy &other, uint32_t set) {
+    std::copy(&other.meta[set * stride], &other.meta[set * stride] + stride, setMeta(set));
+}
+
+void ReplacementPolicy::checkpoint(Checkpoint &cp) {
+    cp.array(meta);
+}
+
+LruPolicy::LruPolicy(const CacheGeometry &geometry) : ReplacementPolicy(geometry, geometry.ways) {
+    // 初始排名为 0..ways-1 的一个排列, 之后每次更新都保持排列性质
+    for (size_t i = 0; i < meta.size(); i++) {
+        meta[i] = static_cast<uint8_t>(i % ways);
+    }
+}
+
+void LruPolicy::touch(uint32_t set, uint32_t way) {
+    uint8_t *rank = setMeta(set);
+    uint8_t old = rank[way];
+    for (uint32_t w = 0; w < ways; w++) {
+        if (rank[w] < old) {
+            rank[w]++;
+        }
+    }
+    rank[way] = 0;
+}
+
+uint32_t LruPolicy::victim(uint32_t set) {
+    const uint8_t *rank = setMeta(set);
+    for (uint32_t w = 0; w < ways; w++) {
+        if (rank[w] == ways - 1) {
+            return w;
+        }
+    }
+    return 0;
+}
+
+TreePlruPolicy::TreePlruPolicy(const CacheGeometry &geometry)
+    : ReplacementPolicy(geometry, (geometry.ways + 7) / 8) {
+    if (!isPowerOfTwo(geometry.ways)) {
+        throw std::invalid_argument("Tree-PLRU needs a power-of-two number of ways");
+    }
+}
+
+// 节点按堆编号 (根为 1), 位为 1 表示替换应走向右子树
+void TreePlruPolicy::touch(uint32_t set, uint32_t way) {
+    uint8_t *bits = setMeta(set);
+    uint32_t node = 1;
+    uint32_t low = 0;
+    for (uint32_t size = ways >> 1; size > 0; size >>= 1) {
+        bool right = way >= low + size;
+        // 指向被访问路的另一侧
+        if (right) {
+            bits[node >> 3] &= ~(1u << (node & 7));
+            low += size;
+        } else {
+            bits[node >> 3] |= 1u << (node & 7);
+        }
+        node = node * 2 + right;
+    }
+}
+
+uint32_t TreePlruPolicy::victim(uint32_t set) {
+    const uint8_t *bits = setMeta(set);
+    uint32_t node = 1;
+    uint32_t low = 0;
+    for (uint32_t size = ways >> 1; size > 0; size >>= 1) {
+        bool right = (bits[node >> 3] >> (node & 7)) & 1;
+        if (right) {
+            low += size;
+        }
+        node = node * 2 + right;
+    }
+    return low;
+}
+
+RripPolicy::RripPolicy(const CacheGeometry &geometry, bool bimodal, uint32_t seed)
+    : ReplacementPolicy(geometry, (geometry.ways + 3) / 4 + (bimodal ? 4 : 0)),
+      bimodal(bimodal), rng_offset((geometry.ways + 3) / 4) {
+    for (uint32_t set = 0; set < geometry.sets; set++) {
+        uint8_t *m = setMeta(set);
+        for (uint32_t w = 0; w < ways; w++) {
+            setRrpv(m, w, RRPV_MAX);
+        }
+        if (bimodal) {
+            seedRandom(m + rng_offset, seed, set);
+        }
+    }
+}
+
+void RripPolicy::setRrpv(uint8_t *m, uint32_t way, uint32_t value) {
+    int shift = (way & 3) * 2;
+    m[way >> 2] = (m[way >> 2] & ~(3u << shift)) | (value << shift);
+}
+
+void RripPolicy::touch(uint32_t set, uint32_t way) {
+    setRrpv(setMeta(set), way, 0);
+}
+
+void RripPolicy::insert(uint32_t set, uint32_t way) {
+    uint8_t *m = setMeta(set);
+    uint32_t value = RRPV_MAX - 1;
+    if (bimodal && (nextRandom(m + rng_offset) & 31) != 0) {
+        value = RRPV_MAX;
+    }
+    setRrpv(m, way, value);
+}
+
+uint32_t RripPolicy::victim(uint32_t set) {
+    uint8_t *m = setMeta(set);
+    // 选择第一个 RRPV 为最大值的路; 没有时所有路一起老化, 直到最老的路达到最大值
+    uint32_t oldest = 0;
+    for (uint32_t w = 0; w < ways; w++) {
+        oldest = std::max(oldest, rrpv(m, w));
+    }
+    uint32_t age = RRPV_MAX - oldest;
+    if (age > 0) {
+        for (uint32_t w = 0; w < ways; w++) {
+            setRrpv(m, w, rrpv(m, w) + age);
+        }
+    }
+    for (uint32_t w = 0; w < ways; w++) {
+        if (rrpv(m, w) == RRPV_MAX) {
+            return w;
+        }
+    }
+    return 0;
+}
+
+RandomPolicy::RandomPolicy(const CacheGeometry &geometry, uint32_t seed) : ReplacementPolicy(geometry, 4) {
+    for (uint32_t set = 0; set < geometry.sets; set++) {
+        seedRandom(setMeta(set), seed, set);
+    }
+}
+
+uint32_t RandomPolicy::victim(uint32_t set) {
+    return nextRandom(setMeta(set)) % ways;
+}
+
+std::unique_ptr<ReplacementPolicy> makeReplacementPolicy(Replacement kind, const CacheGeometry &geometry,
+                                                         uint32_t seed) {
+    switch (kind) {
+    case REPLACE_PLRU:
+        return std::unique_ptr<ReplacementPolicy>(new TreePlruPolicy(geometry));
+    case REPLACE_SRRIP:
+        return std::unique_ptr<ReplacementPolicy>(new RripPolicy(geometry, false, seed));
+    case REPLACE_BRRIP:
+        return std::unique_ptr<ReplacementPolicy>(new RripPolicy(geometry, true, seed));
+    case REPLACE_RANDOM:
+        return std::unique_ptr<ReplacementPolicy>(new RandomPolicy(geometry, seed));
+    case REPLACE_LRU:
+    default:
+        return std::unique_ptr<ReplacementPolicy>(new LruPolicy(geometry));
+    }
+}
+
+bool parseReplacement(const std::string &text, Replacement &kind) {
+    if (text == "lru") {
+        kind = REPLACE_LRU;
+    } else if (text == "plru") {
+        kind = REPLACE_PLRU;
+    } else if (text == "srrip") {
+        kind = REPLACE_SRRIP;
+    } else if (text == "brrip") {
+        kind = REPLACE_BRRIP;
+    } else if (text == "random") {
+        kind = REPLACE_RANDOM;
+    } else {
+        return false;
+    }
+    return true;
+}
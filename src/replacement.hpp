@@ -0,0 +1,88 @@
+#ifndef REPLACEMENT_HPP
+#define REPLACEMENT_HPP
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "common.hpp"
+#include "geometry.hpp"
+
+class Checkpoint;
+
+// 替换策略: 每组只保存少量元数据 (sets * stride 字节), 不依赖全局访问计数,
+// 因此长 trace 不会溢出, 各组之间也完全独立
+class ReplacementPolicy {
+protected:
+    uint32_t ways;
+    uint32_t stride;                    // 每组元数据的字节数
+    std::vector<uint8_t> meta;
+
+    uint8_t *setMeta(uint32_t set) { return &meta[set * stride]; }
+
+public:
+    ReplacementPolicy(const CacheGeometry &geometry, uint32_t stride);
+    virtual ~ReplacementPolicy() {}
+    // 命中时更新
+    virtual void touch(uint32_t set, uint32_t way) = 0;
+    // 缺失填入新行后更新
+    virtual void insert(uint32_t set, uint32_t way) = 0;
+    // 组内所有路都有效时选择被替换的路
+    virtual uint32_t victim(uint32_t set) = 0;
+    // 复制另一个同类策略中一个组的元数据
+    void copySet(const ReplacementPolicy &other, uint32_t set);
+    // 保存或恢复全部元数据; 随机类策略的随机数状态也在元数据中
+    void checkpoint(Checkpoint &cp);
+};
+
+// 真 LRU: 每路一个字节的年龄排名, 0 为最近使用
+class LruPolicy : public ReplacementPolicy {
+public:
+    explicit LruPolicy(const CacheGeometry &geometry);
+    void touch(uint32_t set, uint32_t way) override;
+    void insert(uint32_t set, uint32_t way) override { touch(set, way); }
+    uint32_t victim(uint32_t set) override;
+};
+
+// 树形伪 LRU: 每组 ways - 1 位, 要求路数为 2 的幂
+class TreePlruPolicy : public ReplacementPolicy {
+public:
+    explicit TreePlruPolicy(const CacheGeometry &geometry);
+    void touch(uint32_t set, uint32_t way) override;
+    void insert(uint32_t set, uint32_t way) override { touch(set, way); }
+    uint32_t victim(uint32_t set) override;
+};
+
+// SRRIP / BRRIP: 每路 2 位再引用预测值 (RRPV), 4 路压缩在一个字节中.
+// BRRIP 大多以 "远期再引用" 插入, 约 1/32 的概率以 "中期" 插入, 随机数状态按组保存.
+class RripPolicy : public ReplacementPolicy {
+private:
+    bool bimodal;
+    uint32_t rng_offset;
+
+    uint32_t rrpv(const uint8_t *m, uint32_t way) const { return (m[way >> 2] >> ((way & 3) * 2)) & 3; }
+    void setRrpv(uint8_t *m, uint32_t way, uint32_t value);
+
+public:
+    RripPolicy(const CacheGeometry &geometry, bool bimodal, uint32_t seed);
+    void touch(uint32_t set, uint32_t way) override;
+    void insert(uint32_t set, uint32_t way) override;
+    uint32_t victim(uint32_t set) override;
+};
+
+// 随机替换: 每组 4 字节 xorshift 状态
+class RandomPolicy : public ReplacementPolicy {
+public:
+    RandomPolicy(const CacheGeometry &geometry, uint32_t seed);
+    void touch(uint32_t, uint32_t) override {}
+    void insert(uint32_t, uint32_t) override {}
+    uint32_t victim(uint32_t set) override;
+};
+
+// seed 用于随机类策略, 通常取处理器编号; 策略与几何不匹配时抛出 std::invalid_argument
+std::unique_ptr<ReplacementPolicy> makeReplacementPolicy(Replacement kind, const CacheGeometry &geometry,
+                                                         uint32_t seed = 0);
+// 解析 lru, plru, srrip, brrip, random
+bool parseReplacement(const std::string &text, Replacement &kind);
+
+#endif
@@ -1,27 +1,34 @@
 #include "request.hpp"
+#include "profile.hpp"
 #include <sstream>
 #include <iomanip>
 #include <iostream>
+#include <cstring>
+#include <cctype>
+#include <cstdlib>
 
-Request::Request(int processor_id, Operation op, uint16_t address, uint16_t write_data) 
-    : processor_id(processor_id), op(op), address(address), write_data(write_data) {}
+Request::Request(int processor_id, Operation op, uint64_t address, uint16_t write_data, uint16_t compare_data)
+    : processor_id(processor_id), op(op), address(address), write_data(write_data), compare_data(compare_data) {}
+
+// trace 中的操作名, 下标为 Operation
+static const char *const OPERATION_NAMES[] = {"read", "write", "barrier", "prefetch", "fetch_add", "cas", "ll", "sc"};
+static const char *const OPERATION_TYPES[] = {"READ", "WRITE", "BARRIER", "PREFETCH", "FETCH_ADD", "CAS", "LL", "SC"};
+
+const char *operationType(Operation op) {
+    return OPERATION_TYPES[op];
+}
 
 std::string Request::toString() const {
     std::stringstream ss;
-    ss << "<P" << processor_id << ", ";
-    if (op == READ) {
-        ss << "read";
-    } else if (op == WRITE) {
-        ss << "write";
-    } else {
-        ss << "barrier";
-    }
+    ss << "<P" << processor_id << ", " << OPERATION_NAMES[op];
     if (op != BARRIER) {
         ss << ", " << std::dec << address << ", ";
     } else {
         ss << ", -, ";
     }
-    if (op == WRITE) {
+    if (op == CAS) {
+        ss << compare_data << ":" << write_data;
+    } else if (op == WRITE || op == FETCH_ADD || op == SC) {
         ss << write_data;
     } else {
         ss << "-";
@@ -30,45 +37,128 @@ std::string Request::toString() const {
     return ss.str();
 }
 
-Request parseRequest(const std::string &line) {
-    std::istringstream iss(line);
-    std::string token;
-    std::vector<std::string> tokens;
+// 去掉首尾的空格和尖括号 (与旧解析器的 " <>" 规则一致)
+static void trimToken(const char *&begin, const char *&end) {
+    const char *b = begin;
+    const char *e = end;
+    while (b < e && (*b == ' ' || *b == '<' || *b == '>')) b++;
+    while (e > b && (e[-1] == ' ' || e[-1] == '<' || e[-1] == '>')) e--;
+    if (b < e) {
+        begin = b;
+        end = e;
+    }
+}
+
+static bool tokenEquals(const char *begin, const char *end, const char *word) {
+    size_t len = std::strlen(word);
+    return static_cast<size_t>(end - begin) == len && std::memcmp(begin, word, len) == 0;
+}
 
-    while (std::getline(iss, token, ',')) {
-        size_t start = token.find_first_not_of(" <>");
-        size_t end = token.find_last_not_of(" <>");
-        if (start != std::string::npos && end != std::string::npos) {
-            token = token.substr(start, end - start + 1);
+// 十进制无符号整数, 允许前导空白, 忽略数字之后的内容; 超出 uint64_t 时失败 (与 stoul 一致)
+static bool parseDecimal(const char *begin, const char *end, uint64_t &value) {
+    while (begin < end && std::isspace(static_cast<unsigned char>(*begin))) begin++;
+    if (begin < end && *begin == '+') begin++;
+    if (begin == end || !std::isdigit(static_cast<unsigned char>(*begin))) {
+        return false;
+    }
+    value = 0;
+    while (begin < end && std::isdigit(static_cast<unsigned char>(*begin))) {
+        uint64_t digit = *begin - '0';
+        if (value > (UINT64_MAX - digit) / 10) {
+            return false;
         }
-        tokens.push_back(token);
+        value = value * 10 + digit;
+        begin++;
     }
+    return true;
+}
 
-    if (tokens.size() != 4) {
-        std::cerr << "Invalid request format: " << line << std::endl;
-        exit(1);
+static void invalidRequest(const char *what, const char *begin, const char *end) {
+    std::cerr << what << std::string(begin, end) << std::endl;
+    exit(1);
+}
+
+Request parseRequest(const char *begin, const char *end, int num_cores) {
+    PROFILE_SCOPE(PROF_PARSE);
+    const char *token_begin[4];
+    const char *token_end[4];
+    int count = 0;
+
+    // 按 ',' 切分, 末尾的空字段与 std::getline 一样被忽略
+    const char *p = begin;
+    while (p < end) {
+        const char *comma = static_cast<const char *>(std::memchr(p, ',', end - p));
+        const char *field_end = comma != nullptr ? comma : end;
+        if (count == 4) {
+            invalidRequest("Invalid request format: ", begin, end);
+        }
+        token_begin[count] = p;
+        token_end[count] = field_end;
+        trimToken(token_begin[count], token_end[count]);
+        count++;
+        p = comma != nullptr ? comma + 1 : end;
+    }
+
+    if (count != 4) {
+        invalidRequest("Invalid request format: ", begin, end);
     }
 
-    int processor_id = std::stoi(tokens[0].substr(1));
-    if (processor_id < 0 || processor_id > 3) {
-        std::cerr << "Invalid processor ID: " << processor_id << std::endl;
+    uint64_t id = 0;
+    if (token_end[0] - token_begin[0] < 1 || !parseDecimal(token_begin[0] + 1, token_end[0], id)) {
+        invalidRequest("Invalid request format: ", begin, end);
+    }
+    // 在截断为 int 之前检查范围
+    if (id >= static_cast<uint64_t>(num_cores)) {
+        std::cerr << "Invalid processor ID: " << id << std::endl;
         exit(1);
     }
+    int processor_id = static_cast<int>(id);
 
     Operation op;
-    if (tokens[1] == "read") {
+    if (tokenEquals(token_begin[1], token_end[1], "read")) {
         op = READ;
-    } else if (tokens[1] == "write") {
+    } else if (tokenEquals(token_begin[1], token_end[1], "write")) {
         op = WRITE;
-    } else if (tokens[1] == "barrier") {
+    } else if (tokenEquals(token_begin[1], token_end[1], "barrier")) {
         op = BARRIER;
+    } else if (tokenEquals(token_begin[1], token_end[1], "fetch_add")) {
+        op = FETCH_ADD;
+    } else if (tokenEquals(token_begin[1], token_end[1], "cas")) {
+        op = CAS;
+    } else if (tokenEquals(token_begin[1], token_end[1], "ll")) {
+        op = LL;
+    } else if (tokenEquals(token_begin[1], token_end[1], "sc")) {
+        op = SC;
     } else {
-        std::cerr << "Invalid operation: " << tokens[1] << std::endl;
-        exit(1);
+        invalidRequest("Invalid operation: ", token_begin[1], token_end[1]);
     }
 
-    uint16_t address = tokens[2] == "-" ? UINT16_MAX : std::stoul(tokens[2], nullptr, 10); // 十进制解析
-    uint16_t write_data = tokens[3] == "-" ? UINT16_MAX : std::stoul(tokens[3], nullptr, 10); // 十进制解析
+    uint64_t address = UINT16_MAX;
+    uint64_t write_data = UINT16_MAX;
+    uint64_t compare_data = 0;
+    if (!tokenEquals(token_begin[2], token_end[2], "-") && !parseDecimal(token_begin[2], token_end[2], address)) {
+        invalidRequest("Invalid address: ", token_begin[2], token_end[2]);
+    }
+    if (op == CAS) {
+        // CAS 的数据字段为 "expected:new"
+        const char *colon = static_cast<const char *>(
+            std::memchr(token_begin[3], ':', token_end[3] - token_begin[3]));
+        if (colon == nullptr || !parseDecimal(token_begin[3], colon, compare_data) ||
+            !parseDecimal(colon + 1, token_end[3], write_data)) {
+            invalidRequest("Invalid data: ", token_begin[3], token_end[3]);
+        }
+    } else if (!tokenEquals(token_begin[3], token_end[3], "-") &&
+               !parseDecimal(token_begin[3], token_end[3], write_data)) {
+        invalidRequest("Invalid data: ", token_begin[3], token_end[3]);
+    }
+    // 数据与 CAS 期望值都是半字, 在截断为 uint16_t 之前检查范围
+    if (write_data > UINT16_MAX || compare_data > UINT16_MAX) {
+        invalidRequest("Invalid data: ", token_begin[3], token_end[3]);
+    }
 
-    return Request(processor_id, op, address, write_data);
-}
\ No newline at end of file
+    return Request(processor_id, op, address, write_data, compare_data);
+}
+
+Request parseRequest(const std::string &line, int num_cores) {
+    return parseRequest(line.data(), line.data() + line.size(), num_cores);
+}
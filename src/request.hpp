@@ -8,13 +8,25 @@
 struct Request {
     int processor_id;
     Operation op;
-    uint16_t address;
-    uint16_t write_data;
+    uint64_t address;
+    uint16_t write_data;        // FETCH_ADD: 加数; CAS: 新值
+    uint16_t compare_data;      // CAS: 期望的旧值, 其他操作为 0
 
-    Request(int processor_id, Operation op, uint16_t address = 0, uint16_t write_data = 0);
+    Request(int processor_id, Operation op, uint64_t address = 0, uint16_t write_data = 0,
+            uint16_t compare_data = 0);
     std::string toString() const;
 };
 
-Request parseRequest(const std::string &line);
+// 写数据的操作: 仲裁时排在读之前, 执行时与写一样取得独占所有权
+inline bool isWriteOperation(Operation op) {
+    return op == WRITE || op == FETCH_ADD || op == CAS || op == SC;
+}
+
+// 逐请求输出中的类型名, 如 "WRITE"
+const char *operationType(Operation op);
+
+// 解析单条 "<Pn, op, addr, data>" 请求, 不做任何堆分配
+Request parseRequest(const char *begin, const char *end, int num_cores = 4);
+Request parseRequest(const std::string &line, int num_cores = 4);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,13 @@
+#include "request_queue.hpp"
+
+RequestQueue::RequestQueue() : items(REQUEST_QUEUE_CAPACITY, {Request(0, READ), 0}), mask(REQUEST_QUEUE_CAPACITY - 1) {}
+
+void RequestQueue::grow() {
+    std::vector<QueuedRequest> larger(items.size() * 2, {Request(0, READ), 0});
+    for (uint32_t i = 0; i < count; i++) {
+        larger[i] = at(i);
+    }
+    items.swap(larger);
+    mask = items.size() - 1;
+    head = 0;
+}
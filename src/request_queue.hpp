@@ -0,0 +1,52 @@
+#ifndef REQUEST_QUEUE_HPP
+#define REQUEST_QUEUE_HPP
+
+#include <cstdint>
+#include <vector>
+#include "request.hpp"
+
+#define REQUEST_QUEUE_CAPACITY 16   // 每核请求队列的初始容量, 须为 2 的幂
+
+// 队列中的请求与它进入队列的周期, 用于按年龄仲裁和统计等待时间
+struct QueuedRequest {
+    Request request;
+    uint64_t enqueued;
+};
+
+// 每核请求的环形队列: 预先分配, 稳定状态下入队出队都不分配内存.
+// barrier 期间请求可能持续积压, 写满时容量翻倍而不是拒绝请求
+class RequestQueue {
+private:
+    std::vector<QueuedRequest> items;
+    uint32_t mask;
+    uint32_t head = 0;
+    uint32_t count = 0;
+
+    void grow();
+
+public:
+    RequestQueue();
+    bool empty() const { return count == 0; }
+    uint32_t size() const { return count; }
+    void push(const Request &request, uint64_t enqueued) {
+        if (count == items.size()) {
+            grow();
+        }
+        items[(head + count) & mask] = {request, enqueued};
+        count++;
+    }
+    // 第 position 项, 0 为最旧
+    const QueuedRequest &at(uint32_t position) const { return items[(head + position) & mask]; }
+    QueuedRequest pop() {
+        QueuedRequest front = items[head];
+        head = (head + 1) & mask;
+        count--;
+        return front;
+    }
+    void clear() {
+        head = 0;
+        count = 0;
+    }
+};
+
+#endif
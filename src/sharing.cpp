@@ -0,0 +1,125 @@
+#include "sharing.hpp"
+#include "checkpoint.hpp"
+#include <algorithm>
+#include <iostream>
+
+SharingDetector::SharingDetector(const CacheGeometry &geometry) : offset_mask(geometry.offset_mask) {
+    word_shift = std::max(1, geometry.offset_bits - 6);
+}
+
+void SharingDetector::beginWrite(int core, uint64_t touched, uint64_t written) {
+    writer = core;
+    writer_touched = touched;
+    writer_written = written;
+}
+
+void SharingDetector::addWords(LineRecord &record, int core, uint64_t words) {
+    for (CoreWords &entry : record.cores) {
+        if (entry.core == core) {
+            entry.words |= words;
+            return;
+        }
+    }
+    record.cores.push_back({core, words});
+}
+
+void SharingDetector::classify(uint64_t line_address, int core, uint64_t touched, uint64_t written) {
+    if (touched == 0) {
+        unused_copies++;
+        return;
+    }
+    LineRecord &record = lines[line_address];
+    if ((touched & writer_written) != 0 || (written & writer_touched) != 0) {
+        record.true_sharing++;
+        true_sharing++;
+    } else {
+        record.false_sharing++;
+        false_sharing++;
+        addWords(record, core, touched);
+        addWords(record, writer, writer_written);
+    }
+}
+
+// 各行按地址顺序保存, 检查点文件与哈希表的遍历顺序无关
+void SharingDetector::checkpoint(Checkpoint &cp) {
+    cp.value(true_sharing);
+    cp.value(false_sharing);
+    cp.value(unused_copies);
+    uint64_t count = lines.size();
+    cp.value(count);
+    if (cp.isLoading()) {
+        lines.clear();
+        for (uint64_t i = 0; i < count && cp.good(); i++) {
+            uint64_t line = 0;
+            cp.value(line);
+            LineRecord &record = lines[line];
+            cp.value(record.true_sharing);
+            cp.value(record.false_sharing);
+            cp.array(record.cores, true);
+        }
+        return;
+    }
+    std::vector<uint64_t> addresses;
+    addresses.reserve(count);
+    for (const auto &entry : lines) {
+        addresses.push_back(entry.first);
+    }
+    std::sort(addresses.begin(), addresses.end());
+    for (uint64_t line : addresses) {
+        LineRecord &record = lines[line];
+        cp.value(line);
+        cp.value(record.true_sharing);
+        cp.value(record.false_sharing);
+        cp.array(record.cores, true);
+    }
+}
+
+void SharingDetector::printReport() const {
+    uint64_t classified = true_sharing + false_sharing;
+    std::cout << "\nSharing: invalidations classified: " << classified << ", true sharing: " << true_sharing
+              << ", false sharing: " << false_sharing;
+    if (classified > 0) {
+        std::cout << " (" << (100.0 * false_sharing / classified) << "%)";
+    }
+    std::cout << ", unused copies: " << unused_copies << std::endl;
+
+    std::vector<std::pair<uint64_t, const LineRecord *>> hottest;
+    for (const auto &entry : lines) {
+        if (entry.second.false_sharing > 0) {
+            hottest.push_back({entry.first, &entry.second});
+        }
+    }
+    if (hottest.empty()) {
+        return;
+    }
+    // 伪共享次数降序, 相同时按地址, 输出与哈希表的遍历顺序无关
+    size_t count = std::min<size_t>(hottest.size(), SHARING_REPORT_LINES);
+    std::partial_sort(hottest.begin(), hottest.begin() + count, hottest.end(),
+                      [](const std::pair<uint64_t, const LineRecord *> &a, const std::pair<uint64_t, const LineRecord *> &b) {
+                          if (a.second->false_sharing != b.second->false_sharing) {
+                              return a.second->false_sharing > b.second->false_sharing;
+                          }
+                          return a.first < b.first;
+                      });
+    std::cout << "Line\t\tFalse\tTrue\tCores [byte offsets accessed]\n";
+    for (size_t i = 0; i < count; i++) {
+        const LineRecord &record = *hottest[i].second;
+        std::cout << "0x" << std::hex << hottest[i].first << std::dec << "\t" << record.false_sharing << "\t"
+                  << record.true_sharing << "\t";
+        std::vector<CoreWords> cores = record.cores;
+        std::sort(cores.begin(), cores.end(), [](const CoreWords &a, const CoreWords &b) { return a.core < b.core; });
+        for (size_t c = 0; c < cores.size(); c++) {
+            std::cout << (c > 0 ? " P" : "P") << cores[c].core << "[";
+            bool first = true;
+            for (int bit = 0; bit < 64; bit++) {
+                if ((cores[c].words >> bit) & 1) {
+                    std::cout << (first ? "+" : ",+") << (bit << word_shift);
+                    first = false;
+                }
+            }
+            std::cout << "]";
+        }
+        std::cout << "\n";
+    }
+    std::cout << std::flush;
+}
@@ -0,0 +1,60 @@
+#ifndef SHARING_HPP
+#define SHARING_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include "geometry.hpp"
+
+class Checkpoint;
+
+#define SHARING_REPORT_LINES 10     // 报告中列出的伪共享最严重的行数
+
+// 伪共享检测: 每个 cache 块记录本核取得该副本以来读写过的字 (touched / written 位图, 由 Cache 维护),
+// 写者的 SET_INVALID / WRITE_MISS 无效化其他副本时按位图分类:
+//   被无效化的核读写过写者写的字, 或写过写者读写过的字, 说明两核确实通过这些字通信, 为真共享;
+//   否则两核访问的是同一行中互不相交的字, 为伪共享.
+// 行不超过 128 字节时每个半字一位, 更大的行每 行大小/64 字节一位.
+// 每次访问只在 cache 块上做一次按位或, 只有无效化才查哈希表
+class SharingDetector {
+public:
+    // 一行上某个核在伪共享中访问过的字
+    struct CoreWords {
+        int core;
+        uint64_t words;
+    };
+    struct LineRecord {
+        uint64_t true_sharing = 0;
+        uint64_t false_sharing = 0;
+        std::vector<CoreWords> cores;
+    };
+
+private:
+    uint32_t offset_mask;
+    int word_shift;                         // 每一位对应 1 << word_shift 字节
+    std::unordered_map<uint64_t, LineRecord> lines;
+    // 当前写者, 由 beginWrite 在广播前设置
+    int writer = -1;
+    uint64_t writer_touched = 0;
+    uint64_t writer_written = 0;
+
+    static void addWords(LineRecord &record, int core, uint64_t words);
+
+public:
+    uint64_t true_sharing = 0;
+    uint64_t false_sharing = 0;
+    uint64_t unused_copies = 0;             // 被无效化的副本从未被访问过 (如预取的行), 不参与分类
+
+    explicit SharingDetector(const CacheGeometry &geometry);
+    uint64_t wordBit(uint64_t address) const { return 1ULL << ((address & offset_mask) >> word_shift); }
+    // 写者广播 SET_INVALID / WRITE_MISS 之前调用, 位图已包含本次写入的字
+    void beginWrite(int core, uint64_t touched, uint64_t written);
+    // 一个副本被当前写者无效化
+    void classify(uint64_t line_address, int core, uint64_t touched, uint64_t written);
+    const std::unordered_map<uint64_t, LineRecord> &getLines() const { return lines; }
+    void checkpoint(Checkpoint &cp);
+    void printReport() const;
+};
+
+#endif
@@ -0,0 +1,804 @@
+#include "simulator.hpp"
+#include "bus.hpp"
+#include "cache.hpp"
+#include "checkpoint.hpp"
+#include "core.hpp"
+#include "event_log.hpp"
+#include "llc.hpp"
+#include "prefetcher.hpp"
+#include "stats.hpp"
+#include "trace.hpp"
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <algorithm>
+
+static bool parsePriorities(const std::string &text, std::vector<int> &priorities) {
+    priorities.clear();
+    const char *p = text.c_str();
+    while (*p != '\0') {
+        char *end = nullptr;
+        long value = std::strtol(p, &end, 10);
+        if (end == p || (*end != ',' && *end != '\0')) {
+            return false;
+        }
+        priorities.push_back(static_cast<int>(value));
+        p = *end == ',' ? end + 1 : end;
+    }
+    return !priorities.empty();
+}
+
+// "period:warmup:measure", 预热与测量窗口必须能放进一个周期
+static bool parseSampling(const std::string &text, Sampling &sampling) {
+    unsigned long values[3];
+    const char *p = text.c_str();
+    for (int k = 0; k < 3; k++) {
+        char *end = nullptr;
+        values[k] = std::strtoul(p, &end, 10);
+        if (end == p || *end != (k < 2 ? ':' : '\0') || values[k] > UINT32_MAX) {
+            return false;
+        }
+        p = end + 1;
+    }
+    if (values[0] == 0 || values[2] == 0 || values[1] + values[2] > values[0]) {
+        return false;
+    }
+    sampling.period = values[0];
+    sampling.warmup = values[1];
+    sampling.measure = values[2];
+    return true;
+}
+
+// "cycle:file"
+static bool parseCheckpointAt(const std::string &text, uint64_t &cycle, std::string &filename) {
+    size_t colon = text.find(':');
+    if (colon == std::string::npos || colon + 1 == text.size()) {
+        return false;
+    }
+    char *end = nullptr;
+    cycle = std::strtoull(text.c_str(), &end, 10);
+    if (end != text.c_str() + colon || cycle == 0) {
+        return false;
+    }
+    filename = text.substr(colon + 1);
+    return true;
+}
+
+const char *simOptionsUsage() {
+    return "[-omp] [-r] [-cache default|l1-32k|l1-64k|size:ways:line] [-dir] [-cores N]"
+           " [-protocol msi|mesi|moesi|mesif] [-repl lru|plru|srrip|brrip|random] [-prio p0,p1,...]"
+           " [-arb static|rr|age|lottery] [-atomic cache|bus]"
+           " [-llc llc-1m|size:ways:line] [-inclusion inclusive|exclusive|nine]"
+           " [-q] [-log file] [-stats file.json|file.csv] [-stats-interval N]"
+           " [-timing] [-lat hit:arb:snoop:c2c:mem[:llc]] [-split N] [-mshr N] [-wbb N] [-sb N]"
+           " [-prefetch none|next|stride|stream[:degree]] [-sharing] [-sectors N] [-shards N]"
+           " [-sample period:warmup:measure] [-checkpoint cycle:file] [-restore file]";
+}
+
+bool checkSimConfig(const SimConfig &config) {
+    if (config.replacement == REPLACE_PLRU && (!isPowerOfTwo(config.geometry.ways) ||
+                                               (config.llc && !isPowerOfTwo(config.llc_geometry.ways)))) {
+        std::cerr << "Error: -repl plru needs a power-of-two number of ways." << std::endl;
+        return false;
+    }
+    if (config.llc && config.llc_geometry.line_bytes != config.geometry.line_bytes) {
+        std::cerr << "Error: The LLC line size must match the L1 line size (" << config.geometry.line_bytes
+                  << "B)." << std::endl;
+        return false;
+    }
+    if (config.shards > 1 && (!config.quiet || config.omp || config.timing ||
+                              !config.log_filename.empty() || config.stats_interval > 0)) {
+        // 这些功能依赖跨组的全局顺序: 逐请求输出、读到的数据决定写入值 (-omp)、共享总线的时序
+        std::cerr << "Error: -shards requires -q and cannot be combined with -omp, -timing, -log or -stats-interval."
+                  << std::endl;
+        return false;
+    }
+    if (config.buffers.store > 0 && config.bus_model.split) {
+        std::cerr << "Error: -sb models a blocking core; the split-transaction core already retires stores early."
+                  << std::endl;
+        return false;
+    }
+    if (config.shards > 1 && (config.buffers.writeback > 0 || config.prefetch != PREFETCH_NONE || config.sharing)) {
+        // 写回缓冲按周期在后台排空, 预取按周期仲裁, 都依赖全局的周期顺序; 伪共享检测的记录是全局共享的
+        std::cerr << "Error: -shards cannot be combined with -wbb, -prefetch or -sharing." << std::endl;
+        return false;
+    }
+    if (config.sectors > config.geometry.line_bytes / 2) {
+        std::cerr << "Error: -sectors " << config.sectors << " needs sectors of at least 2 bytes; the line is "
+                  << config.geometry.line_bytes << "B." << std::endl;
+        return false;
+    }
+    if (config.sectors > 1 && (config.llc || config.buffers.writeback > 0 || config.prefetch != PREFETCH_NONE ||
+                               !config.log_filename.empty())) {
+        // LLC、写回缓冲和预取都按整行搬运数据; 事件日志每块只记录一个状态
+        std::cerr << "Error: -sectors cannot be combined with -llc, -wbb, -prefetch or -log." << std::endl;
+        return false;
+    }
+    if (config.sampling.period > 0 && (config.shards > 1 || !config.log_filename.empty() || config.stats_interval > 0)) {
+        std::cerr << "Error: -sample cannot be combined with -shards, -log or -stats-interval." << std::endl;
+        return false;
+    }
+    if ((!config.checkpoint_filename.empty() || !config.restore_filename.empty()) && config.shards > 1) {
+        // 分片模式在 trace 结束后才按组回放访问, 保存检查点时 cache 中还没有任何访问
+        std::cerr << "Error: -checkpoint and -restore cannot be combined with -shards." << std::endl;
+        return false;
+    }
+    if (config.shards > 1 && config.llc) {
+        // LLC 的组索引与 L1 不同, 包含模式的反向无效化还会跨越 L1 的组
+        std::cerr << "Error: -shards cannot be combined with -llc." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+int parseSimOption(const std::vector<std::string> &args, size_t &i, SimConfig &config) {
+    const std::string &arg = args[i];
+    bool has_value = i + 1 < args.size();
+    if (arg == "-omp") {
+        config.omp = true;
+    } else if (arg == "-r") {
+        config.reduction = true;
+    } else if (arg == "-cores") {
+        config.num_cores = has_value ? std::atoi(args[++i].c_str()) : 0;
+        config.cores_given = true;
+        if (config.num_cores < 1 || config.num_cores > MAX_CORES) {
+            std::cerr << "Error: Number of cores must be between 1 and " << MAX_CORES << "." << std::endl;
+            return -1;
+        }
+    } else if (arg == "-q") {
+        config.quiet = true;
+    } else if (arg == "-log" && has_value) {
+        config.log_filename = args[++i];
+    } else if (arg == "-stats" && has_value) {
+        config.stats_filename = args[++i];
+    } else if (arg == "-stats-interval" && has_value) {
+        config.stats_interval = std::atoi(args[++i].c_str());
+    } else if (arg == "-timing") {
+        config.timing = true;
+    } else if (arg == "-lat") {
+        if (!has_value || !parseLatencies(args[++i], config.latencies)) {
+            std::cerr << "Error: Invalid latencies, expected hit:arb:snoop:c2c:mem[:llc]." << std::endl;
+            return -1;
+        }
+        config.timing = true;
+    } else if (arg == "-split" || arg == "-mshr") {
+        int value = has_value ? std::atoi(args[++i].c_str()) : 0;
+        if (value < 1) {
+            std::cerr << "Error: " << arg << " needs a positive count." << std::endl;
+            return -1;
+        }
+        if (arg == "-split") {
+            config.bus_model.outstanding = value;
+        } else {
+            config.bus_model.mshrs = value;
+        }
+        config.bus_model.split = true;
+        config.timing = true;
+    } else if (arg == "-wbb" || arg == "-sb") {
+        int value = has_value ? std::atoi(args[++i].c_str()) : 0;
+        if (value < 1) {
+            std::cerr << "Error: " << arg << " needs a positive number of entries." << std::endl;
+            return -1;
+        }
+        if (arg == "-wbb") {
+            config.buffers.writeback = value;
+        } else {
+            config.buffers.store = value;
+            config.timing = true;
+        }
+    } else if (arg == "-sharing") {
+        config.sharing = true;
+    } else if (arg == "-sectors") {
+        int value = has_value ? std::atoi(args[++i].c_str()) : 0;
+        if (value < 1 || value > MAX_SECTORS || !isPowerOfTwo(value)) {
+            std::cerr << "Error: -sectors needs a power of two between 1 and " << MAX_SECTORS << "." << std::endl;
+            return -1;
+        }
+        config.sectors = value;
+    } else if (arg == "-prefetch") {
+        if (!has_value || !parsePrefetch(args[++i], config.prefetch, config.prefetch_degree)) {
+            std::cerr << "Error: Unknown prefetcher, expected none, next, stride or stream, optionally with :degree (1-64)."
+                      << std::endl;
+            return -1;
+        }
+    } else if (arg == "-sample") {
+        if (!has_value || !parseSampling(args[++i], config.sampling)) {
+            std::cerr << "Error: Invalid sampling, expected period:warmup:measure cycles with warmup + measure <= period."
+                      << std::endl;
+            return -1;
+        }
+    } else if (arg == "-checkpoint") {
+        if (!has_value || !parseCheckpointAt(args[++i], config.checkpoint_cycle, config.checkpoint_filename)) {
+            std::cerr << "Error: Invalid checkpoint, expected cycle:file with a positive cycle." << std::endl;
+            return -1;
+        }
+    } else if (arg == "-restore" && has_value) {
+        config.restore_filename = args[++i];
+    } else if (arg == "-protocol") {
+        config.protocol = has_value ? findProtocol(args[++i]) : nullptr;
+        if (config.protocol == nullptr) {
+            std::cerr << "Error: Unknown protocol, expected msi, mesi, moesi or mesif." << std::endl;
+            return -1;
+        }
+    } else if (arg == "-prio") {
+        if (!has_value || !parsePriorities(args[++i], config.priorities)) {
+            std::cerr << "Error: Invalid priority list, expected comma-separated integers." << std::endl;
+            return -1;
+        }
+    } else if (arg == "-arb") {
+        if (!has_value || !parseArbitration(args[++i], config.arbitration)) {
+            std::cerr << "Error: Unknown arbitration policy, expected static, rr, age or lottery." << std::endl;
+            return -1;
+        }
+        config.arbitration_given = true;
+    } else if (arg == "-atomic") {
+        if (!has_value || !parseAtomicLock(args[++i], config.atomic_lock)) {
+            std::cerr << "Error: Unknown atomic lock, expected cache or bus." << std::endl;
+            return -1;
+        }
+    } else if (arg == "-shards") {
+        config.shards = has_value ? std::atoi(args[++i].c_str()) : 0;
+        if (config.shards < 1) {
+            std::cerr << "Error: Number of shards must be at least 1." << std::endl;
+            return -1;
+        }
+    } else if (arg == "-repl") {
+        if (!has_value || !parseReplacement(args[++i], config.replacement)) {
+            std::cerr << "Error: Unknown replacement policy, expected lru, plru, srrip, brrip or random." << std::endl;
+            return -1;
+        }
+    } else if (arg == "-dir") {
+        config.interconnect = DIRECTORY_FILTER;
+    } else if (arg == "-cache") {
+        if (!has_value || !parseGeometry(args[++i], config.geometry)) {
+            std::cerr << "Error: Invalid cache geometry, expected a preset or size:ways:line "
+                      << "(power-of-two line >= 4 bytes, at most " << MAX_WAYS << " ways and power-of-two set count)." << std::endl;
+            return -1;
+        }
+    } else if (arg == "-llc") {
+        if (!has_value || !parseGeometry(args[++i], config.llc_geometry)) {
+            std::cerr << "Error: Invalid LLC geometry, expected a preset or size:ways:line." << std::endl;
+            return -1;
+        }
+        config.llc = true;
+    } else if (arg == "-inclusion") {
+        if (!has_value || !parseInclusion(args[++i], config.inclusion)) {
+            std::cerr << "Error: Unknown inclusion policy, expected inclusive, exclusive or nine." << std::endl;
+            return -1;
+        }
+    } else {
+        return 0;
+    }
+    return 1;
+}
+
+Simulator::Simulator(const SimConfig &config) : config(config), verbose(!config.quiet) {
+    for (int i = 0; i < config.num_cores; i++) {
+        Core *core = new Core(i);
+        Cache *cache = new Cache(i, config.geometry);
+        cache->setProtocol(config.protocol);
+        cache->setReplacement(config.replacement);
+        cache->setSectors(config.sectors);
+        cache->setWriteBackBuffer(config.buffers.writeback);
+        cache->setPrefetcher(config.prefetch, config.prefetch_degree);
+        cache->setAtomicLock(config.atomic_lock);
+        core->setCache(cache);
+        cores.push_back(core);
+    }
+
+    // 优先级数量与核数不符时抛出 std::invalid_argument
+    bus.reset(new Bus(cores, &memory, config.priorities));
+    bus->setInterconnect(config.interconnect);
+    bus->setArbitration(config.arbitration);
+    for (Core* core : cores) {
+        core->getCache()->setBus(bus.get());
+        core->getCache()->setMemory(&memory);
+    }
+    if (config.llc) {
+        bus->setLastLevel(config.llc_geometry, config.inclusion, config.replacement);
+    }
+    if (config.sharing) {
+        bus->enableSharingDetector();
+    }
+    bus->setOutput(!config.quiet, nullptr);
+    if (config.timing) {
+        timing.reset(new TimingModel(config.num_cores, config.latencies, config.bus_model, config.buffers));
+        bus->setTiming(timing.get());
+    }
+    if (config.shards > 1) {
+        for (Core *core : cores) {
+            core->setSchedule(&schedule);
+        }
+    }
+}
+
+Simulator::~Simulator() {
+    for (Core* core : cores) {
+        delete core->getCache();
+        delete core;
+    }
+}
+
+bool Simulator::openOutputs() {
+    if (!config.log_filename.empty()) {
+        event_log.reset(new EventLog(config.log_filename, config.num_cores, config.geometry));
+        if (!event_log->isOpen()) {
+            std::cerr << "Error: Cannot create event log " << config.log_filename << std::endl;
+            return false;
+        }
+        bus->setOutput(!config.quiet, event_log.get());
+    }
+    if (!config.stats_filename.empty()) {
+        stats.reset(new StatsWriter(config.stats_filename));
+        if (!stats->isOpen()) {
+            std::cerr << "Error: Cannot create statistics file " << config.stats_filename << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+// 一个周期: 打印周期标题, 仲裁本周期的请求. trace 中的空周期只推进时间,
+// drain 时没有新请求, 仲裁只调度各核队列中的请求
+void Simulator::step(const std::vector<Request> &requests, bool drain) {
+    const Sampling &sampling = config.sampling;
+    if (sampling.period > 0) {
+        uint64_t offset = cycle % sampling.period;
+        SamplePhase next = offset < sampling.period - sampling.warmup - sampling.measure ? SAMPLE_FAST_FORWARD
+                         : offset < sampling.period - sampling.measure ? SAMPLE_WARMUP : SAMPLE_MEASURE;
+        if (next != phase) {
+            setPhase(next);
+        }
+    }
+    if (event_log) {
+        event_log->beginCycle(cycle);
+    }
+    if (timing) {
+        timing->beginCycle(cycle);
+    }
+    bus->beginCycle(cycle);
+    if (verbose) {
+        std::cout << "\n----------Cycle " << cycle << "----------\n\n";
+    }
+    cycle++;
+    if (drain || !requests.empty()) {
+        bus->arbitrate(requests, config.omp, config.reduction);
+    } else if (config.prefetch != PREFETCH_NONE) {
+        // 没有请求的周期总线空闲, 预取照常发出
+        bus->issuePrefetches();
+    }
+    if (cycle == config.checkpoint_cycle && !config.checkpoint_filename.empty()) {
+        checkpoint_saved = saveCheckpoint(config.checkpoint_filename);
+    }
+    if (stats && config.stats_interval > 0 && cycle % config.stats_interval == 0) {
+        stats->snapshot(cycle, cores, *bus);
+    }
+}
+
+void Simulator::run(TraceReader &trace) {
+    std::vector<Request> requests;
+    requests.reserve(config.num_cores);
+    // 从检查点恢复时, trace 中已经模拟过的周期只读取不执行
+    for (uint64_t skipped = 0; skipped < cycle && trace.nextCycle(requests); skipped++) {
+    }
+    while (trace.nextCycle(requests)) {
+        step(requests);
+    }
+}
+
+void Simulator::run(const TraceData &trace) {
+    std::vector<Request> requests;
+    requests.reserve(config.num_cores);
+    for (size_t c = cycle; c < trace.cycles(); c++) {
+        requests.assign(trace.cycleBegin(c), trace.cycleEnd(c));
+        step(requests);
+    }
+}
+
+void Simulator::finish() {
+    bool queue_empty = false;
+    std::vector<Request> none;
+    while (!queue_empty) {
+        queue_empty = true;
+        for (Core *core : cores) {
+            if (!core->isQueueEmpty()) {
+                queue_empty = false;
+                break;
+            }
+        }
+        if (!queue_empty) {
+            step(none, true);
+        }
+    }
+    // 写回缓冲中剩余的脏行全部写回, 内存与 LLC 的最终状态才完整
+    for (Core *core : cores) {
+        core->getCache()->drainWriteBack(UINT32_MAX);
+    }
+    if (config.shards > 1) {
+        replayShards();
+    }
+    if (phase == SAMPLE_MEASURE) {
+        closeWindow();
+    }
+    if (!config.checkpoint_filename.empty() && !checkpoint_saved && cycle < config.checkpoint_cycle) {
+        std::cerr << "Error: The trace ended after " << cycle << " cycles, before checkpoint cycle "
+                  << config.checkpoint_cycle << "; no checkpoint written." << std::endl;
+    }
+
+    if (config.interconnect == DIRECTORY_FILTER && config.report) {
+        bus->printProbeStats();
+    }
+    if (config.arbitration_given && config.report) {
+        bus->printArbitrationStats();
+    }
+    if (config.llc && config.report) {
+        bus->getLastLevel()->printStats();
+    }
+    if (config.sharing && config.report) {
+        bus->getSharingDetector()->printReport();
+    }
+    if (config.sectors > 1 && config.report) {
+        uint64_t sector_misses = 0;
+        uint64_t misses = 0;
+        for (const Core *core : cores) {
+            sector_misses += core->getCache()->stats.sector_misses;
+            misses += core->getCache()->stats.misses();
+        }
+        std::cout << "\nSectors: " << config.sectors << " per line (" << config.geometry.line_bytes / config.sectors
+                  << "B each), sector misses (line present, sector invalid): " << sector_misses << " of " << misses
+                  << " misses" << std::endl;
+    }
+    if (config.report) {
+        printAtomicStats();
+    }
+    if (config.prefetch != PREFETCH_NONE && config.report) {
+        PrefetchStats prefetch;
+        uint64_t misses = 0;
+        for (const Core *core : cores) {
+            prefetch += core->getCache()->prefetch_stats;
+            misses += core->getCache()->stats.misses();
+        }
+        printPrefetchStats(config.prefetch, config.prefetch_degree, prefetch, misses);
+    }
+    if (config.sampling.period > 0 && config.report) {
+        printSampling();
+    } else if (timing && config.report) {
+        timing->printReport();
+    }
+    if (stats) {
+        stats->snapshot(cycle, cores, *bus);
+        stats->close();
+    }
+    if (event_log) {
+        event_log->flush();
+    }
+}
+
+// 所有一致性动作只涉及同一组索引, 写回也写入同一组对应的内存行,
+// 因此不同分片访问的 cache 组与内存行互不相交. 稀疏内存的页表与最近页缓存不能并发修改,
+// 所以每个分片使用自己的 Memory, 结束后只合并属于该分片的行
+void Simulator::replayShard(int shard, int shards, const std::vector<Core *> &shard_cores) const {
+    const CacheGeometry &geometry = config.geometry;
+    for (const ScheduledAccess &access : schedule) {
+        Cache *cache = shard_cores[access.processor_id]->getCache();
+        if (static_cast<int>(geometry.indexOf(access.address) % shards) != shard) {
+            if (access.op == LL || access.op == SC) {
+                cache->clearLink();
+            }
+            continue;
+        }
+        cache->setClock(access.clock - 1);
+        Operation op = static_cast<Operation>(access.op);
+        if (op == READ || op == WRITE) {
+            cache->access(access.address, op, access.write_data);
+        } else {
+            cache->atomic(access.address, op, access.write_data, access.compare_data);
+        }
+    }
+}
+
+void Simulator::replayShards() {
+    int shards = std::min<int>(config.shards, config.geometry.sets);
+    std::vector<std::vector<Core *>> shard_cores(shards);
+    std::vector<std::unique_ptr<Bus>> shard_buses(shards);
+    std::vector<std::unique_ptr<Memory>> shard_memories(shards);
+    for (int s = 0; s < shards; s++) {
+        shard_memories[s].reset(new Memory());
+        for (int i = 0; i < config.num_cores; i++) {
+            Core *core = new Core(i);
+            Cache *cache = new Cache(i, config.geometry);
+            cache->setProtocol(config.protocol);
+            cache->setReplacement(config.replacement);
+            cache->setSectors(config.sectors);
+            cache->setAtomicLock(config.atomic_lock);
+            cache->setMemory(shard_memories[s].get());
+            core->setCache(cache);
+            shard_cores[s].push_back(core);
+        }
+        shard_buses[s].reset(new Bus(shard_cores[s], shard_memories[s].get(), config.priorities));
+        shard_buses[s]->setInterconnect(config.interconnect);
+        shard_buses[s]->setOutput(false, nullptr);
+        for (Core *core : shard_cores[s]) {
+            core->getCache()->setBus(shard_buses[s].get());
+        }
+    }
+
+    std::vector<std::thread> threads;
+    for (int s = 0; s < shards; s++) {
+        threads.emplace_back([this, s, shards, &shard_cores]() {
+            replayShard(s, shards, shard_cores[s]);
+        });
+    }
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+
+    // 合并: 各分片的组状态复制回本实例的 cache, 统计累加
+    for (int s = 0; s < shards; s++) {
+        for (int i = 0; i < config.num_cores; i++) {
+            Cache *cache = cores[i]->getCache();
+            const Cache *from = shard_cores[s][i]->getCache();
+            for (uint32_t index = s; index < config.geometry.sets; index += shards) {
+                cache->copySet(*from, index);
+            }
+            cache->stats += from->stats;
+        }
+        const CacheGeometry &geometry = config.geometry;
+        memory.copyLines(*shard_memories[s], geometry.words_per_line, [&geometry, s, shards](uint64_t address) {
+            return static_cast<int>(geometry.indexOf(address) % shards) == s;
+        });
+        bus->probes_sent += shard_buses[s]->probes_sent;
+        bus->broadcast_probes += shard_buses[s]->broadcast_probes;
+        for (Core *core : shard_cores[s]) {
+            delete core->getCache();
+            delete core;
+        }
+    }
+    schedule.clear();
+}
+
+SimResult Simulator::result() const {
+    SimResult result;
+    result.cycles = cycle;
+    for (const Core *core : cores) {
+        result.total += core->getCache()->stats;
+    }
+    result.probes_sent = bus->probes_sent;
+    result.broadcast_probes = bus->broadcast_probes;
+    if (bus->getLastLevel() != nullptr) {
+        result.llc = bus->getLastLevel()->stats;
+    }
+    if (timing) {
+        result.timed_cycles = timing->totalCycles();
+        uint64_t accesses = 0;
+        uint64_t latency = 0;
+        for (int i = 0; i < config.num_cores; i++) {
+            accesses += timing->getCore(i).accesses;
+            latency += timing->getCore(i).total_latency;
+        }
+        result.amat = accesses ? static_cast<double>(latency) / accesses : 0.0;
+    }
+    // 抽样时汇总的是外推值, 与完整模拟的结果直接可比; 探测计数来自功能模拟, 本身就是全程的
+    SampleWindow measured;
+    double factor = sampleFactor(measured);
+    if (factor > 0) {
+        result.total = measured.stats.scaled(factor);
+        result.timed_cycles = static_cast<uint64_t>(measured.timed_cycles * factor + 0.5);
+        result.amat = measured.accesses ? static_cast<double>(measured.latency) / measured.accesses : 0.0;
+    }
+    return result;
+}
+
+void Simulator::setPhase(SamplePhase next) {
+    if (phase == SAMPLE_MEASURE) {
+        closeWindow();
+    }
+    phase = next;
+    verbose = next == SAMPLE_MEASURE && !config.quiet;
+    bus->setOutput(verbose, event_log.get());
+    bus->setTiming(next == SAMPLE_FAST_FORWARD ? nullptr : timing.get());
+    if (next == SAMPLE_MEASURE) {
+        window_start = totals();
+    }
+}
+
+SampleWindow Simulator::totals() const {
+    SampleWindow total;
+    total.cycles = cycle;
+    for (const Core *core : cores) {
+        total.stats += core->getCache()->stats;
+    }
+    if (timing) {
+        // 在本周期开始计时之前取值, 空闲的窗口恰好计为窗口的周期数
+        total.timed_cycles = timing->totalCycles();
+        for (int i = 0; i < config.num_cores; i++) {
+            total.accesses += timing->getCore(i).accesses;
+            total.latency += timing->getCore(i).total_latency;
+        }
+    }
+    return total;
+}
+
+void Simulator::closeWindow() {
+    SampleWindow window = totals();
+    window.cycles -= window_start.cycles;
+    window.stats -= window_start.stats;
+    window.timed_cycles -= window_start.timed_cycles;
+    window.accesses -= window_start.accesses;
+    window.latency -= window_start.latency;
+    if (window.cycles > 0) {
+        windows.push_back(window);
+    }
+}
+
+double Simulator::sampleFactor(SampleWindow &measured) const {
+    measured = SampleWindow();
+    for (const SampleWindow &window : windows) {
+        measured.cycles += window.cycles;
+        measured.stats += window.stats;
+        measured.timed_cycles += window.timed_cycles;
+        measured.accesses += window.accesses;
+        measured.latency += window.latency;
+    }
+    return measured.cycles > 0 ? static_cast<double>(cycle) / measured.cycles : 0.0;
+}
+
+// 各窗口比值的样本标准差给出 95% 置信区间的半宽 (正态近似), 少于两个窗口时为 0
+static double confidence(const std::vector<double> &ratios) {
+    size_t n = ratios.size();
+    if (n < 2) {
+        return 0.0;
+    }
+    double mean = 0.0;
+    for (double r : ratios) {
+        mean += r;
+    }
+    mean /= n;
+    double variance = 0.0;
+    for (double r : ratios) {
+        variance += (r - mean) * (r - mean);
+    }
+    variance /= n - 1;
+    return 1.96 * std::sqrt(variance / n);
+}
+
+void Simulator::printSampling() const {
+    const Sampling &sampling = config.sampling;
+    SampleWindow measured;
+    double factor = sampleFactor(measured);
+    std::cout << "\nSampling (period " << sampling.period << ", warm-up " << sampling.warmup << ", measure "
+              << sampling.measure << "): " << windows.size() << " windows, " << measured.cycles << " of " << cycle
+              << " cycles measured";
+    if (cycle > 0) {
+        std::cout << " (" << (100.0 * measured.cycles / cycle) << "%)";
+    }
+    std::cout << std::endl;
+    if (factor == 0) {
+        return;
+    }
+    std::vector<double> miss_rates;
+    std::vector<double> timed_rates;
+    for (const SampleWindow &window : windows) {
+        uint64_t accesses = window.stats.hits() + window.stats.misses();
+        if (accesses > 0) {
+            miss_rates.push_back(100.0 * window.stats.misses() / accesses);
+        }
+        timed_rates.push_back(static_cast<double>(window.timed_cycles) / window.cycles);
+    }
+    CacheStats estimate = measured.stats.scaled(factor);
+    uint64_t accesses = estimate.hits() + estimate.misses();
+    std::cout << "Estimated: accesses " << accesses << ", misses " << estimate.misses();
+    if (accesses > 0) {
+        std::cout << " (miss rate " << (100.0 * estimate.misses() / accesses) << "% +/- " << confidence(miss_rates)
+                  << "%)";
+    }
+    std::cout << ", bus transactions " << estimate.bus_transactions[READ_MISS] << "/"
+              << estimate.bus_transactions[WRITE_MISS] << "/" << estimate.bus_transactions[SET_INVALID]
+              << " (read/write/invalidate), invalidations " << estimate.invalidations_received
+              << ", writebacks " << estimate.writebacks << std::endl;
+    if (timing) {
+        std::cout << "Estimated timed cycles: " << static_cast<uint64_t>(measured.timed_cycles * factor + 0.5)
+                  << " +/- " << static_cast<uint64_t>(confidence(timed_rates) * cycle + 0.5) << ", AMAT "
+                  << (measured.accesses ? static_cast<double>(measured.latency) / measured.accesses : 0.0)
+                  << std::endl;
+    }
+    std::cout << "(intervals are 95% confidence over the measured windows)" << std::endl;
+}
+
+void Simulator::printAtomicStats() const {
+    CacheStats total;
+    for (const Core *core : cores) {
+        total += core->getCache()->stats;
+    }
+    if (total.atomics + total.load_links + total.store_conditionals + total.sc_failures == 0) {
+        return;
+    }
+    std::cout << "\nAtomics (" << atomicLockName(config.atomic_lock) << " lock): read-modify-writes " << total.atomics
+              << ", CAS failures " << total.cas_failures << ", load-links " << total.load_links
+              << ", store-conditionals " << total.store_conditionals << " succeeded / " << total.sc_failures
+              << " failed";
+    if (config.atomic_lock == LOCK_BUS) {
+        std::cout << ", bus locks " << total.bus_locks;
+    }
+    std::cout << std::endl;
+}
+
+CheckpointHeader Simulator::checkpointHeader() const {
+    CheckpointHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+    header.version = CHECKPOINT_VERSION;
+    header.num_cores = config.num_cores;
+    header.size_bytes = config.geometry.size_bytes;
+    header.ways = config.geometry.ways;
+    header.line_bytes = config.geometry.line_bytes;
+    header.sectors = config.sectors;
+    header.replacement = config.replacement;
+    header.interconnect = config.interconnect;
+    header.arbitration = config.arbitration;
+    if (config.llc) {
+        header.llc_size_bytes = config.llc_geometry.size_bytes;
+        header.llc_ways = config.llc_geometry.ways;
+        header.inclusion = config.inclusion;
+    }
+    header.writeback = config.buffers.writeback;
+    header.store = config.buffers.store;
+    if (config.timing) {
+        header.timing = 1 + (config.bus_model.split ? config.bus_model.mshrs : 0);
+    }
+    header.prefetch = config.prefetch;
+    header.sharing = config.sharing;
+    std::strncpy(header.protocol, config.protocol->name, sizeof(header.protocol) - 1);
+    header.cycle = cycle;
+    return header;
+}
+
+bool Simulator::transferCheckpoint(const std::string &filename, bool loading) {
+    Checkpoint cp(filename, loading);
+    if (!cp.isOpen()) {
+        std::cerr << "Error: Cannot " << (loading ? "open" : "create") << " checkpoint " << filename << std::endl;
+        return false;
+    }
+    CheckpointHeader expected = checkpointHeader();
+    CheckpointHeader header = expected;
+    cp.value(header);
+    if (loading && cp.good()) {
+        if (std::memcmp(header.magic, expected.magic, sizeof(header.magic)) != 0 || header.version != expected.version) {
+            std::cerr << "Error: " << filename << " is not a version " << CHECKPOINT_VERSION << " checkpoint." << std::endl;
+            return false;
+        }
+        expected.cycle = header.cycle;
+        if (std::memcmp(&header, &expected, sizeof(header)) != 0) {
+            std::cerr << "Error: Checkpoint " << filename << " was saved with a different configuration"
+                      << " (cores, -cache, -sectors, -repl, -dir, -arb, -protocol, -llc, -wbb, -sb, -timing, -split/-mshr,"
+                      << " -prefetch and -sharing must match)." << std::endl;
+            return false;
+        }
+        cycle = header.cycle;
+    }
+    bus->checkpoint(cp);
+    for (Core *core : cores) {
+        core->checkpoint(cp);
+        core->getCache()->checkpoint(cp);
+    }
+    memory.checkpoint(cp);
+    if (timing) {
+        timing->checkpoint(cp);
+    }
+    if (!cp.close()) {
+        std::cerr << "Error: " << (loading ? "Corrupt checkpoint " : "Cannot write checkpoint ") << filename
+                  << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool Simulator::saveCheckpoint(const std::string &filename) {
+    return transferCheckpoint(filename, false);
+}
+
+bool Simulator::restoreCheckpoint(const std::string &filename) {
+    return transferCheckpoint(filename, true);
+}
@@ -0,0 +1,164 @@
+#ifndef SIMULATOR_HPP
+#define SIMULATOR_HPP
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "common.hpp"
+#include "geometry.hpp"
+#include "protocol.hpp"
+#include "timing.hpp"
+#include "stats.hpp"
+#include "memory.hpp"
+#include "request.hpp"
+#include "core.hpp"
+
+class Bus;
+class EventLog;
+class StatsWriter;
+class TraceReader;
+class Checkpoint;
+struct TraceData;
+struct CheckpointHeader;
+
+// 抽样模拟 (SMARTS 式): trace 按 period 个周期分段, 每段最后 warmup + measure 个周期详细模拟.
+// 其余周期快进: 只做功能模拟, cache 与内存照常更新以保持预热, 但不打印也不运行时序模型;
+// 预热窗口运行时序模型但不计入结果, 只有测量窗口计入统计, 最后按测量周期的占比外推全程
+struct Sampling {
+    uint32_t period = 0;                // 0 表示不抽样
+    uint32_t warmup = 0;
+    uint32_t measure = 0;
+};
+
+enum SamplePhase {
+    SAMPLE_OFF,             // 不抽样, 或第一个周期之前
+    SAMPLE_FAST_FORWARD,
+    SAMPLE_WARMUP,
+    SAMPLE_MEASURE
+};
+
+// 一个测量窗口内各项统计的增量
+struct SampleWindow {
+    uint64_t cycles = 0;
+    CacheStats stats;
+    uint64_t timed_cycles = 0;
+    uint64_t accesses = 0;
+    uint64_t latency = 0;
+};
+
+// 一次模拟的全部配置
+struct SimConfig {
+    int num_cores = 4;
+    bool cores_given = false;
+    CacheGeometry geometry = DefaultGeometry::value;
+    const ProtocolTable *protocol = &MESI_PROTOCOL;
+    Replacement replacement = REPLACE_LRU;
+    Interconnect interconnect = BROADCAST_BUS;
+    bool llc = false;                   // 在总线与内存之间加入共享 LLC
+    CacheGeometry llc_geometry = LlcGeometry1M::value;
+    Inclusion inclusion = LLC_INCLUSIVE;
+    std::vector<int> priorities;        // 为空时优先级即处理器编号
+    Arbitration arbitration = ARB_STATIC;
+    bool arbitration_given = false;     // 显式给出 -arb 时结束时打印仲裁统计
+    AtomicLock atomic_lock = LOCK_CACHE;
+    bool omp = false;
+    bool reduction = false;
+    bool quiet = false;
+    bool report = true;                 // 结束时打印探测与时序汇总
+    bool timing = false;
+    Latencies latencies;
+    BusModel bus_model;
+    BufferModel buffers;                // 写回缓冲同时改变功能模型, 存储缓冲只影响时序
+    Prefetch prefetch = PREFETCH_NONE;
+    uint32_t prefetch_degree = 2;
+    bool sharing = false;               // 伪共享检测
+    uint32_t sectors = 1;               // 每行的一致性扇区数, 1 为整行一致性
+    Sampling sampling;
+    std::string checkpoint_filename;    // 模拟完 checkpoint_cycle 个周期后保存检查点
+    uint64_t checkpoint_cycle = 0;
+    std::string restore_filename;       // 从检查点恢复, trace 中已模拟的周期被跳过
+    std::string log_filename;
+    std::string stats_filename;
+    int stats_interval = 0;
+    int shards = 1;                     // >1 时按组索引分片, 多线程回放 cache 访问
+};
+
+// 解析 args[i] 处的一个模拟选项 (可能消耗后续参数):
+//   返回 1 表示已识别, 0 表示不是模拟选项, -1 表示参数非法 (错误已打印)
+int parseSimOption(const std::vector<std::string> &args, size_t &i, SimConfig &config);
+const char *simOptionsUsage();
+// 检查选项组合是否可用, 不可用时打印错误并返回 false
+bool checkSimConfig(const SimConfig &config);
+
+// 一次模拟结束后的汇总结果
+struct SimResult {
+    uint64_t cycles = 0;
+    CacheStats total;
+    uint64_t probes_sent = 0;
+    uint64_t broadcast_probes = 0;
+    LlcStats llc;                       // 仅在启用 LLC 时有效
+    uint64_t timed_cycles = 0;          // 仅在启用时序模型时有效
+    double amat = 0.0;
+};
+
+// 一个完整的模拟实例: 内存、总线、各核及其 cache. 实例之间不共享任何可变状态.
+class Simulator {
+private:
+    SimConfig config;
+    Memory memory;
+    std::vector<Core *> cores;
+    std::unique_ptr<Bus> bus;
+    std::unique_ptr<EventLog> event_log;
+    std::unique_ptr<TimingModel> timing;
+    std::unique_ptr<StatsWriter> stats;
+    uint64_t cycle = 0;
+    std::vector<ScheduledAccess> schedule;  // 分片模式下按全局执行顺序记录的访问
+    bool verbose;                           // 是否逐周期打印; 抽样时只在测量窗口打印
+    SamplePhase phase = SAMPLE_OFF;
+    SampleWindow window_start;              // 当前测量窗口开始时的累计值
+    std::vector<SampleWindow> windows;
+    bool checkpoint_saved = false;
+
+    // 每个分片持有一套独立的 cache 与总线, 只回放组索引 % shards == shard 的访问
+    void replayShard(int shard, int shards, const std::vector<Core *> &shard_cores) const;
+    void replayShards();
+
+    void step(const std::vector<Request> &requests, bool drain = false);
+
+    // 切换抽样阶段: 快进时断开时序模型并关闭输出, 离开测量窗口时记录该窗口的增量
+    void setPhase(SamplePhase next);
+    SampleWindow totals() const;
+    void closeWindow();
+    // 由测量窗口外推全程: 返回外推系数, 没有测量窗口时返回 0
+    double sampleFactor(SampleWindow &measured) const;
+    void printSampling() const;
+    // trace 中有原子操作时打印各核原子操作的次数与失败数
+    void printAtomicStats() const;
+
+    CheckpointHeader checkpointHeader() const;
+    // 按固定顺序保存或恢复全部状态: 文件头、总线、各核与其 cache、内存
+    bool transferCheckpoint(const std::string &filename, bool loading);
+
+public:
+    explicit Simulator(const SimConfig &config);
+    ~Simulator();
+    Simulator(const Simulator &) = delete;
+    Simulator &operator=(const Simulator &) = delete;
+
+    // 打开日志/统计文件, 失败时打印错误并返回 false
+    bool openOutputs();
+    void run(TraceReader &trace);
+    void run(const TraceData &trace);
+    // 模拟完当前周期之后的状态写入检查点, 失败时打印错误并返回 false
+    bool saveCheckpoint(const std::string &filename);
+    // 在 run 之前调用; 检查点的配置与本实例不符或文件损坏时打印错误并返回 false
+    bool restoreCheckpoint(const std::string &filename);
+    // 执行完各核队列中剩余的请求并输出汇总
+    void finish();
+    SimResult result() const;
+    const std::vector<Core *> &getCores() const { return cores; }
+    Bus &getBus() { return *bus; }
+};
+
+#endif
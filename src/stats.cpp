@@ -0,0 +1,220 @@
+#include "stats.hpp"
+#include "bus.hpp"
+#include "core.hpp"
+#include "cache.hpp"
+#include "profile.hpp"
+#include <cinttypes>
+
+CacheStats &CacheStats::operator+=(const CacheStats &other) {
+    read_hits += other.read_hits;
+    read_misses += other.read_misses;
+    write_hits += other.write_hits;
+    write_misses += other.write_misses;
+    upgrades += other.upgrades;
+    invalidations_received += other.invalidations_received;
+    writebacks += other.writebacks;
+    cache_to_cache += other.cache_to_cache;
+    memory_fills += other.memory_fills;
+    for (int i = 0; i < 3; i++) {
+        bus_transactions[i] += other.bus_transactions[i];
+    }
+    barrier_stall_cycles += other.barrier_stall_cycles;
+    sector_misses += other.sector_misses;
+    atomics += other.atomics;
+    cas_failures += other.cas_failures;
+    load_links += other.load_links;
+    store_conditionals += other.store_conditionals;
+    sc_failures += other.sc_failures;
+    bus_locks += other.bus_locks;
+    return *this;
+}
+
+CacheStats &CacheStats::operator-=(const CacheStats &other) {
+    read_hits -= other.read_hits;
+    read_misses -= other.read_misses;
+    write_hits -= other.write_hits;
+    write_misses -= other.write_misses;
+    upgrades -= other.upgrades;
+    invalidations_received -= other.invalidations_received;
+    writebacks -= other.writebacks;
+    cache_to_cache -= other.cache_to_cache;
+    memory_fills -= other.memory_fills;
+    for (int i = 0; i < 3; i++) {
+        bus_transactions[i] -= other.bus_transactions[i];
+    }
+    barrier_stall_cycles -= other.barrier_stall_cycles;
+    sector_misses -= other.sector_misses;
+    atomics -= other.atomics;
+    cas_failures -= other.cas_failures;
+    load_links -= other.load_links;
+    store_conditionals -= other.store_conditionals;
+    sc_failures -= other.sc_failures;
+    bus_locks -= other.bus_locks;
+    return *this;
+}
+
+static uint64_t scale(uint64_t value, double factor) {
+    return static_cast<uint64_t>(value * factor + 0.5);
+}
+
+CacheStats CacheStats::scaled(double factor) const {
+    CacheStats result;
+    result.read_hits = scale(read_hits, factor);
+    result.read_misses = scale(read_misses, factor);
+    result.write_hits = scale(write_hits, factor);
+    result.write_misses = scale(write_misses, factor);
+    result.upgrades = scale(upgrades, factor);
+    result.invalidations_received = scale(invalidations_received, factor);
+    result.writebacks = scale(writebacks, factor);
+    result.cache_to_cache = scale(cache_to_cache, factor);
+    result.memory_fills = scale(memory_fills, factor);
+    for (int i = 0; i < 3; i++) {
+        result.bus_transactions[i] = scale(bus_transactions[i], factor);
+    }
+    result.barrier_stall_cycles = scale(barrier_stall_cycles, factor);
+    result.sector_misses = scale(sector_misses, factor);
+    result.atomics = scale(atomics, factor);
+    result.cas_failures = scale(cas_failures, factor);
+    result.load_links = scale(load_links, factor);
+    result.store_conditionals = scale(store_conditionals, factor);
+    result.sc_failures = scale(sc_failures, factor);
+    result.bus_locks = scale(bus_locks, factor);
+    return result;
+}
+
+PrefetchStats &PrefetchStats::operator+=(const PrefetchStats &other) {
+    issued += other.issued;
+    useful += other.useful;
+    unused_evictions += other.unused_evictions;
+    useless_invalidations += other.useless_invalidations;
+    shared_fills += other.shared_fills;
+    dropped += other.dropped;
+    late += other.late;
+    return *this;
+}
+
+static const char *STATS_CSV_HEADER =
+    "cycle,core,read_hits,read_misses,write_hits,write_misses,upgrades,invalidations_received,"
+    "writebacks,cache_to_cache,memory_fills,bus_read_miss,bus_write_miss,bus_set_invalid,sector_misses,"
+    "barrier_stall_cycles,atomics,cas_failures,load_links,store_conditionals,sc_failures,bus_locks\n";
+
+static void writeCsvRow(FILE *file, uint64_t cycle, const char *core, const CacheStats &s) {
+    std::fprintf(file, "%" PRIu64 ",%s,%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64
+                 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64,
+                 cycle, core, s.read_hits, s.read_misses, s.write_hits, s.write_misses, s.upgrades,
+                 s.invalidations_received, s.writebacks, s.cache_to_cache, s.memory_fills,
+                 s.bus_transactions[READ_MISS], s.bus_transactions[WRITE_MISS], s.bus_transactions[SET_INVALID],
+                 s.sector_misses, s.barrier_stall_cycles);
+    std::fprintf(file, ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 "\n",
+                 s.atomics, s.cas_failures, s.load_links, s.store_conditionals, s.sc_failures, s.bus_locks);
+}
+
+static void writeJsonObject(FILE *file, const CacheStats &s) {
+    std::fprintf(file, "{\"read_hits\": %" PRIu64 ", \"read_misses\": %" PRIu64 ", \"write_hits\": %" PRIu64
+                 ", \"write_misses\": %" PRIu64 ", \"upgrades\": %" PRIu64 ", \"invalidations_received\": %" PRIu64
+                 ", \"writebacks\": %" PRIu64 ", \"cache_to_cache\": %" PRIu64 ", \"memory_fills\": %" PRIu64
+                 ", \"bus_transactions\": {\"READ_MISS\": %" PRIu64 ", \"WRITE_MISS\": %" PRIu64
+                 ", \"SET_INVALID\": %" PRIu64 "}, \"sector_misses\": %" PRIu64
+                 ", \"barrier_stall_cycles\": %" PRIu64,
+                 s.read_hits, s.read_misses, s.write_hits, s.write_misses, s.upgrades, s.invalidations_received,
+                 s.writebacks, s.cache_to_cache, s.memory_fills, s.bus_transactions[READ_MISS],
+                 s.bus_transactions[WRITE_MISS], s.bus_transactions[SET_INVALID], s.sector_misses,
+                 s.barrier_stall_cycles);
+    std::fprintf(file, ", \"atomics\": %" PRIu64 ", \"cas_failures\": %" PRIu64 ", \"load_links\": %" PRIu64
+                 ", \"store_conditionals\": %" PRIu64 ", \"sc_failures\": %" PRIu64 ", \"bus_locks\": %" PRIu64 "}",
+                 s.atomics, s.cas_failures, s.load_links, s.store_conditionals, s.sc_failures, s.bus_locks);
+}
+
+static bool endsWith(const std::string &text, const std::string &suffix) {
+    return text.size() >= suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+StatsWriter::StatsWriter(const std::string &filename) {
+    json = !endsWith(filename, ".csv");
+    file = std::fopen(filename.c_str(), "w");
+    if (file == nullptr) {
+        return;
+    }
+    if (json) {
+        std::fputs("{\"snapshots\": [", file);
+    } else {
+        std::fputs(STATS_CSV_HEADER, file);
+    }
+}
+
+StatsWriter::~StatsWriter() {
+    close();
+}
+
+void StatsWriter::snapshot(uint64_t cycle, const std::vector<Core *> &cores, const Bus &bus) {
+    PROFILE_SCOPE(PROF_OUTPUT);
+    CacheStats total;
+    for (const Core *core : cores) {
+        total += core->getCache()->stats;
+    }
+
+    if (!json) {
+        char id[16];
+        for (const Core *core : cores) {
+            std::snprintf(id, sizeof(id), "%d", core->getProcessorId());
+            writeCsvRow(file, cycle, id, core->getCache()->stats);
+        }
+        writeCsvRow(file, cycle, "all", total);
+        return;
+    }
+
+    std::fprintf(file, "%s\n  {\"cycle\": %" PRIu64 ", \"cores\": [", first_snapshot ? "" : ",", cycle);
+    first_snapshot = false;
+    for (size_t i = 0; i < cores.size(); i++) {
+        std::fputs(i == 0 ? "\n    " : ",\n    ", file);
+        writeJsonObject(file, cores[i]->getCache()->stats);
+    }
+    std::fputs("],\n   \"total\": ", file);
+    writeJsonObject(file, total);
+    std::fprintf(file, ",\n   \"probes_sent\": %" PRIu64 ", \"broadcast_probes\": %" PRIu64,
+                 bus.probes_sent, bus.broadcast_probes);
+    if (bus.getLastLevel() != nullptr) {
+        const LlcStats &l = bus.getLastLevel()->stats;
+        std::fprintf(file, ",\n   \"llc\": {\"hits\": %" PRIu64 ", \"misses\": %" PRIu64 ", \"l1_writebacks\": %" PRIu64
+                     ", \"victim_fills\": %" PRIu64 ", \"evictions\": %" PRIu64 ", \"writebacks\": %" PRIu64
+                     ", \"back_invalidations\": %" PRIu64 "}",
+                     l.hits, l.misses, l.l1_writebacks, l.victim_fills, l.evictions, l.writebacks, l.back_invalidations);
+    }
+    if (bus.getSharingDetector() != nullptr) {
+        const SharingDetector &d = *bus.getSharingDetector();
+        std::fprintf(file, ",\n   \"sharing\": {\"true_sharing\": %" PRIu64 ", \"false_sharing\": %" PRIu64
+                     ", \"unused_copies\": %" PRIu64 "}",
+                     d.true_sharing, d.false_sharing, d.unused_copies);
+    }
+    if (!cores.empty() && cores[0]->getCache()->getPrefetch() != PREFETCH_NONE) {
+        PrefetchStats p;
+        for (const Core *core : cores) {
+            p += core->getCache()->prefetch_stats;
+        }
+        std::fprintf(file, ",\n   \"prefetch\": {\"issued\": %" PRIu64 ", \"useful\": %" PRIu64
+                     ", \"unused_evictions\": %" PRIu64 ", \"useless_invalidations\": %" PRIu64
+                     ", \"shared_fills\": %" PRIu64 ", \"dropped\": %" PRIu64 ", \"late\": %" PRIu64 "}",
+                     p.issued, p.useful, p.unused_evictions, p.useless_invalidations, p.shared_fills, p.dropped,
+                     p.late);
+    }
+    const std::vector<ArbitrationStats> &arbitration = bus.getArbitrationStats();
+    std::fprintf(file, ",\n   \"arbitration\": {\"policy\": \"%s\", \"cores\": [", arbitrationName(bus.getArbitration()));
+    for (size_t i = 0; i < arbitration.size(); i++) {
+        const ArbitrationStats &a = arbitration[i];
+        std::fprintf(file, "%s{\"grants\": %" PRIu64 ", \"wait_cycles\": %" PRIu64 ", \"max_wait\": %" PRIu64
+                     ", \"preceded\": %" PRIu64 "}",
+                     i == 0 ? "" : ", ", a.grants, a.wait_cycles, a.max_wait, a.preceded);
+    }
+    std::fputs("]}}", file);
+}
+
+void StatsWriter::close() {
+    if (file == nullptr) {
+        return;
+    }
+    if (json) {
+        std::fputs("\n]}\n", file);
+    }
+    std::fclose(file);
+    file = nullptr;
+}
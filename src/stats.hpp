@@ -0,0 +1,92 @@
+#ifndef STATS_HPP
+#define STATS_HPP
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "common.hpp"
+
+class Core;
+class Bus;
+
+// 每个核的 cache 与一致性统计
+struct CacheStats {
+    uint64_t read_hits = 0;
+    uint64_t read_misses = 0;
+    uint64_t write_hits = 0;
+    uint64_t write_misses = 0;
+    uint64_t upgrades = 0;                  // S -> M, 广播 SET_INVALID
+    uint64_t invalidations_received = 0;    // 有效块被其他核的请求无效化
+    uint64_t writebacks = 0;                // M 块写回内存 (替换或监听)
+    uint64_t cache_to_cache = 0;            // 读缺失由其他 cache 提供数据
+    uint64_t memory_fills = 0;              // 缺失由内存提供数据
+    uint64_t bus_transactions[3] = {};      // 按 BusRequest 类型统计本核发出的总线事务
+    uint64_t barrier_stall_cycles = 0;      // 因 barrier 未能调度的仲裁周期
+    uint64_t sector_misses = 0;             // 扇区模式: 行在 cache 中但所需扇区无效的缺失 (已计入读写缺失)
+    // 原子操作 (同时计入写命中/缺失)
+    uint64_t atomics = 0;                   // FETCH_ADD 与 CAS
+    uint64_t cas_failures = 0;              // 旧值不等于期望值的 CAS
+    uint64_t load_links = 0;
+    uint64_t store_conditionals = 0;        // 成功的 SC
+    uint64_t sc_failures = 0;               // 失败的 SC: 不访问 cache 也不计入读写
+    uint64_t bus_locks = 0;                 // 总线锁模式下锁住总线的读-改-写
+
+    uint64_t hits() const { return read_hits + write_hits; }
+    uint64_t misses() const { return read_misses + write_misses; }
+    CacheStats &operator+=(const CacheStats &other);
+    CacheStats &operator-=(const CacheStats &other);
+    // 每项乘以 factor 后取整, 用于由抽样结果外推全程
+    CacheStats scaled(double factor) const;
+};
+
+// 共享 LLC 的统计
+struct LlcStats {
+    uint64_t hits = 0;                      // L1 缺失在 LLC 命中
+    uint64_t misses = 0;                    // L1 缺失在 LLC 缺失, 由内存提供数据
+    uint64_t l1_writebacks = 0;             // 写入 LLC 的 L1 脏行 (替换或监听写回)
+    uint64_t victim_fills = 0;              // L1 替换出的干净行装入 LLC (仅互斥模式)
+    uint64_t evictions = 0;                 // LLC 替换有效行
+    uint64_t writebacks = 0;                // LLC 脏行写回内存
+    uint64_t back_invalidations = 0;        // 包含模式下被反向无效化的 L1 副本数
+
+    uint64_t accesses() const { return hits + misses; }
+};
+
+// 预取统计: 准确率 = useful / issued; 覆盖率 = useful / (useful + 需求缺失)
+struct PrefetchStats {
+    uint64_t issued = 0;                    // 发到总线上的预取
+    uint64_t useful = 0;                    // 预取的行在离开 cache 之前被需求访问命中
+    uint64_t unused_evictions = 0;          // 预取的行未被使用就被替换
+    uint64_t useless_invalidations = 0;     // 预取的行未被使用就被其他核的写无效化: 这些无效化是预取造成的
+    uint64_t shared_fills = 0;              // 预取时其他 cache 也持有该行, 之后它们写该行都要先无效化这份副本
+    uint64_t dropped = 0;                   // 预取队列已满而丢弃的候选
+    uint64_t late = 0;                      // 发出之前该行已被需求访问装入而丢弃的候选
+
+    PrefetchStats &operator+=(const PrefetchStats &other);
+};
+
+// 每核的仲裁统计: 请求从进入队列到被服务等待的周期, 以及同一周期内先于它被服务的请求数
+struct ArbitrationStats {
+    uint64_t grants = 0;
+    uint64_t wait_cycles = 0;
+    uint64_t max_wait = 0;
+    uint64_t preceded = 0;
+};
+
+// 将统计快照写成 JSON 或 CSV (按文件扩展名选择), 可在固定周期间隔和运行结束时写出
+class StatsWriter {
+private:
+    FILE *file;
+    bool json;
+    bool first_snapshot = true;
+
+public:
+    explicit StatsWriter(const std::string &filename);
+    ~StatsWriter();
+    bool isOpen() const { return file != nullptr; }
+    void snapshot(uint64_t cycle, const std::vector<Core *> &cores, const Bus &bus);
+    void close();
+};
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef TAG_MATCH_HPP
+#define TAG_MATCH_HPP
+
+#include <cstdint>
+#include <cstring>
+#include "common.hpp"
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#define TAG_GROUP 8      // 每组 tag 的对齐粒度, 即一次 AVX2 比较的路数 (8 个 32 位 tag 键)
+
+// 每组路数向上取整到 TAG_GROUP, 填充路的状态应恒为 INVALID
+inline uint32_t tagStride(uint32_t ways) {
+    return (ways + TAG_GROUP - 1) / TAG_GROUP * TAG_GROUP;
+}
+
+// 向量比较用的 tag 键: 完整 tag 的低 32 位. 键相等只说明可能命中, 还要再比较完整的 64 位 tag
+inline uint32_t tagKey(uint64_t tag) {
+    return static_cast<uint32_t>(tag);
+}
+
+// 在一组结构数组存储的 tag/状态中查找 tag 相等且状态不为 INVALID 的路, 没有则返回 -1.
+// 64 位比较每条指令只能覆盖一半的路 (SSE2 甚至没有 64 位比较), 因此先比较紧凑存放的 32 位键:
+// AVX2 一条比较覆盖 8 路, SSE2 两条; 键与有效位都匹配的候选路 (通常至多一路) 再核对完整 tag
+inline int matchTag(const uint32_t *set_keys, const uint64_t *set_tags, const uint8_t *set_states, uint32_t ways,
+                    uint64_t tag) {
+#if defined(__AVX2__) || defined(__SSE2__)
+    const __m128i invalid = _mm_set1_epi8(INVALID);
+#if defined(__AVX2__)
+    const __m256i key = _mm256_set1_epi32(static_cast<int>(tagKey(tag)));
+#else
+    const __m128i key = _mm_set1_epi32(static_cast<int>(tagKey(tag)));
+#endif
+    for (uint32_t w = 0; w < ways; w += TAG_GROUP) {
+#if defined(__AVX2__)
+        __m256i eq = _mm256_cmpeq_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(set_keys + w)), key);
+        uint32_t match = _mm256_movemask_ps(_mm256_castsi256_ps(eq));
+#else
+        __m128i eq_low = _mm_cmpeq_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(set_keys + w)), key);
+        __m128i eq_high = _mm_cmpeq_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(set_keys + w + 4)), key);
+        uint32_t match = _mm_movemask_ps(_mm_castsi128_ps(eq_low)) |
+                         (_mm_movemask_ps(_mm_castsi128_ps(eq_high)) << 4);
+#endif
+        __m128i state_bytes = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(set_states + w));
+        match &= ~static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(state_bytes, invalid)));
+        match &= 0xFF;
+        while (match != 0) {
+            uint32_t way = w + __builtin_ctz(match);
+            if (set_tags[way] == tag) {
+                return way;
+            }
+            match &= match - 1;
+        }
+    }
+    return -1;
+#else
+    (void)set_keys;
+    for (uint32_t w = 0; w < ways; w++) {
+        if (set_states[w] != INVALID && set_tags[w] == tag) {
+            return w;
+        }
+    }
+    return -1;
+#endif
+}
+
+#endif
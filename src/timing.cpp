@@ -0,0 +1,449 @@
+#include "timing.hpp"
+#include "checkpoint.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+
+bool parseLatencies(const std::string &text, Latencies &latencies) {
+    uint32_t *fields[6] = {&latencies.l1_hit, &latencies.bus_arbitration, &latencies.snoop,
+                           &latencies.cache_to_cache, &latencies.memory, &latencies.llc};
+    const char *p = text.c_str();
+    for (int i = 0; i < 6; i++) {
+        char *end = nullptr;
+        unsigned long value = std::strtoul(p, &end, 10);
+        // 前 5 项必需, LLC 延迟可省略
+        if (end == p || (*end != ':' && *end != '\0') || (*end == '\0' && i < 4) || (*end == ':' && i == 5)) {
+            return false;
+        }
+        *fields[i] = static_cast<uint32_t>(value);
+        if (*end == '\0') {
+            return true;
+        }
+        p = end + 1;
+    }
+    return false;
+}
+
+TimingModel::TimingModel(int num_cores, const Latencies &latencies, const BusModel &bus_model,
+                         const BufferModel &buffers)
+    : latencies(latencies), bus_model(bus_model), cores(num_cores), buffers(buffers) {
+    if (bus_model.split) {
+        mshrs.resize(static_cast<size_t>(num_cores) * bus_model.mshrs);
+    }
+    writeback_done.resize(static_cast<size_t>(num_cores) * buffers.writeback);
+    stores.resize(static_cast<size_t>(num_cores) * buffers.store);
+    store_head.resize(buffers.store > 0 ? num_cores : 0);
+}
+
+uint64_t TimingModel::account(int core, const AccessInfo &info) {
+    if (bus_model.split) {
+        return accountSplit(core, info);
+    }
+    CoreTiming &timing = cores[core];
+    uint64_t arrival = std::max(now, timing.ready_at);
+    // 原子操作同时是栅栏: 存储缓冲中之前的写全部完成后才发出
+    uint64_t issue = info.atomic ? std::max(arrival, timing.done_at) : arrival;
+    uint64_t done = issue + latencies.l1_hit;
+    // 命中的行由预取装入, 但数据还在路上
+    uint64_t prefetched = info.hit ? prefetchPending(core, info.line, issue) : 0;
+    if (prefetched > done) {
+        timing.late_prefetch_cycles += prefetched - done;
+        done = prefetched;
+    }
+    uint64_t retire = done;     // 核可以发出下一条请求的时刻, 只有存储缓冲会让它早于 done
+
+    if (info.bus_request >= 0 || info.bus_lock) {
+        uint64_t start = done;
+        MshrEntry *store = nullptr;
+        if (info.write && buffers.store > 0 && !info.atomic) {
+            // 存储缓冲已满时等待最旧一项完成
+            uint32_t &head = store_head[core];
+            store = &stores[static_cast<size_t>(core) * buffers.store + head];
+            head = (head + 1) % buffers.store;
+            if (store->done_at > start) {
+                timing.store_full += store->done_at - start;
+                start = store->done_at;
+            }
+        }
+        uint64_t *writeback = nullptr;
+        uint64_t last_writeback = 0;
+        if (info.writeback && buffers.writeback > 0) {
+            // 写回缓冲已满时等待最旧一项写完
+            uint64_t *slots = &writeback_done[static_cast<size_t>(core) * buffers.writeback];
+            writeback = std::min_element(slots, slots + buffers.writeback);
+            last_writeback = *std::max_element(slots, slots + buffers.writeback);
+            uint64_t wait = *writeback > start ? *writeback - start : 0;
+            timing.writeback_full += wait;
+            timing.writeback_hidden += latencies.memory - std::min<uint64_t>(wait, latencies.memory);
+            timing.buffered_writebacks++;
+            start += wait;
+        }
+
+        uint64_t bus_start = std::max(start, bus_free_at);
+        uint64_t occupancy = latencies.bus_arbitration;
+        if (info.bus_request >= 0) {
+            occupancy += latencies.snoop;
+            if (info.bus_request != SET_INVALID) {
+                if (info.cache_to_cache) {
+                    occupancy += latencies.cache_to_cache;
+                } else {
+                    occupancy += info.llc_hit ? latencies.llc : latencies.memory;
+                }
+            }
+        }
+        if (info.bus_lock) {
+            // 读-改-写的写半部分完成后才释放总线
+            occupancy += latencies.l1_hit;
+        }
+        if (info.writeback && writeback == nullptr) {
+            occupancy += latencies.memory;
+        }
+        timing.bus_wait_cycles += bus_start - start;
+        bus_free_at = bus_start + occupancy;
+        bus_busy_cycles += occupancy;
+        done = bus_free_at;
+        retire = done;
+
+        if (writeback != nullptr) {
+            // 缓冲中的各项在缺失事务之后依次经内存写端口写回, 不占用总线
+            *writeback = std::max(done, last_writeback) + latencies.memory;
+        }
+        if (store != nullptr) {
+            // 写在进入存储缓冲后即退休; 各项按程序顺序完成, 因此不早于该核之前的所有访问
+            retire = start;
+            done = std::max(done, timing.done_at);
+            store->line = info.line;
+            store->done_at = done;
+            timing.buffered_stores++;
+            timing.store_hidden += done - retire;
+        }
+    } else if (info.write && buffers.store > 0 && !info.atomic) {
+        // 写命中合并到同一行尚未完成的存储
+        const MshrEntry *entries = &stores[static_cast<size_t>(core) * buffers.store];
+        for (uint32_t i = 0; i < buffers.store; i++) {
+            if (entries[i].done_at > issue && entries[i].line == info.line) {
+                timing.store_merges++;
+                break;
+            }
+        }
+    }
+    if (info.atomic && !info.bus_lock) {
+        // 缓存锁: 取得独占行后在 cache 中完成写半部分, 不占用总线
+        done += latencies.l1_hit;
+        retire = done;
+    }
+
+    uint64_t latency = retire - arrival;
+    timing.ready_at = retire;
+    timing.done_at = std::max(timing.done_at, done);
+    timing.accesses++;
+    timing.total_latency += latency;
+    timing.stall_cycles += latency - latencies.l1_hit;
+    return latency;
+}
+
+// 非阻塞式核: 命中和合并的次缺失不占用新的 MSHR, 核在命中延迟之后即可发出下一条请求;
+// 需要总线的访问先分配 MSHR (全部占用时核停顿), 再等待同一行的未完成事务和总线上的空位
+uint64_t TimingModel::accountSplit(int core, const AccessInfo &info) {
+    CoreTiming &timing = cores[core];
+    uint64_t arrival = std::max(now, timing.ready_at);
+    uint64_t issue = info.atomic ? std::max(arrival, timing.done_at) : arrival;
+    uint64_t done = issue + latencies.l1_hit;
+    uint64_t prefetched = info.hit ? prefetchPending(core, info.line, issue) : 0;
+    if (prefetched > done) {
+        timing.late_prefetch_cycles += prefetched - done;
+        done = prefetched;
+    }
+    MshrEntry *entries = coreMshrs(core);
+    MshrEntry *pending = nullptr;
+    for (uint32_t i = 0; i < bus_model.mshrs; i++) {
+        if (entries[i].done_at > issue && entries[i].line == info.line) {
+            pending = &entries[i];
+        }
+    }
+
+    if (info.bus_request < 0) {
+        // 功能上的命中, 但该行的数据还在路上: 次缺失合并到已有的 MSHR
+        if (pending != nullptr) {
+            done = std::max(done, pending->done_at);
+            timing.mshr_merges++;
+        }
+        timing.ready_at = issue + latencies.l1_hit;
+    } else {
+        // 同一行的事务一个接一个完成, 因此复用该行的 MSHR; 否则选择最早空闲的 MSHR
+        MshrEntry *entry = pending;
+        uint64_t allocated = issue;
+        uint64_t start = done;
+        if (entry == nullptr) {
+            entry = &entries[0];
+            for (uint32_t i = 1; i < bus_model.mshrs; i++) {
+                if (entries[i].done_at < entry->done_at) {
+                    entry = &entries[i];
+                }
+            }
+            if (entry->done_at > issue) {
+                timing.mshr_full_cycles += entry->done_at - issue;
+                allocated = entry->done_at;
+                start = allocated + latencies.l1_hit;
+            }
+        } else {
+            // 例如读缺失的数据未到时写同一行: 升级在读完成之后发出
+            start = std::max(start, pending->done_at);
+        }
+        uint64_t busy_from = std::max(allocated, entry->done_at);
+        timing.ready_at = allocated + latencies.l1_hit;
+
+        // 其他核对同一行的事务未完成时, 该行处于瞬态, 新事务排在它之后
+        for (const MshrEntry &other : mshrs) {
+            if (&other != entry && other.line == info.line && other.done_at > start) {
+                start = other.done_at;
+                timing.line_conflicts++;
+            }
+        }
+        while (!in_flight.empty() && in_flight.top() <= start) {
+            in_flight.pop();
+        }
+        if (in_flight.size() >= bus_model.outstanding) {
+            start = std::max(start, in_flight.top());
+            in_flight.pop();
+        }
+
+        // 请求阶段
+        uint64_t request_start = std::max(start, bus_free_at);
+        uint64_t request_cycles = latencies.bus_arbitration + latencies.snoop;
+        timing.bus_wait_cycles += request_start - start;
+        bus_free_at = request_start + request_cycles;
+        bus_busy_cycles += request_cycles;
+        done = bus_free_at;
+        // 响应阶段: 升级只需要无效化其他副本, 没有数据
+        if (info.bus_request != SET_INVALID) {
+            uint64_t ready = bus_free_at;
+            if (info.cache_to_cache) {
+                ready += latencies.cache_to_cache;
+            } else {
+                ready += info.llc_hit ? latencies.llc : latencies.memory;
+            }
+            uint64_t response_start = std::max(ready, data_free_at);
+            data_free_at = response_start + latencies.bus_arbitration;
+            data_busy_cycles += latencies.bus_arbitration;
+            done = data_free_at;
+        }
+        // 写回占用一次数据传输, 不推迟本次访问
+        if (info.writeback) {
+            data_free_at = std::max(data_free_at, bus_free_at) + latencies.bus_arbitration;
+            data_busy_cycles += latencies.bus_arbitration;
+        }
+        in_flight.push(done);
+
+        entry->line = info.line;
+        entry->done_at = done;
+        timing.mshr_busy_cycles += done - busy_from;
+        uint32_t busy = 0;
+        for (uint32_t i = 0; i < bus_model.mshrs; i++) {
+            busy += entries[i].done_at > allocated;
+        }
+        timing.mshr_peak = std::max(timing.mshr_peak, busy);
+    }
+    if (info.atomic) {
+        if (info.bus_lock) {
+            // 总线锁: 地址总线从取得起一直锁到写完成, 其间不能开始其他事务的请求阶段
+            uint64_t lock_from = bus_free_at;
+            if (info.bus_request < 0) {
+                lock_from = std::max(done, bus_free_at);
+                timing.bus_wait_cycles += lock_from - done;
+                done = lock_from + latencies.bus_arbitration;
+            }
+            done += latencies.l1_hit;
+            if (done > lock_from) {
+                bus_busy_cycles += done - lock_from;
+                bus_free_at = std::max(bus_free_at, done);
+            }
+        } else {
+            done += latencies.l1_hit;
+        }
+        // 核需要读出的旧值, 等待原子操作完成
+        timing.ready_at = done;
+    }
+
+    uint64_t latency = done - arrival;
+    timing.done_at = std::max(timing.done_at, done);
+    timing.accesses++;
+    timing.total_latency += latency;
+    timing.stall_cycles += latency - latencies.l1_hit;
+    return latency;
+}
+
+void TimingModel::checkpoint(Checkpoint &cp) {
+    cp.array(cores);
+    cp.value(now);
+    cp.value(bus_free_at);
+    cp.value(bus_busy_cycles);
+    cp.value(data_free_at);
+    cp.value(data_busy_cycles);
+    cp.array(mshrs);
+    // 优先队列不能直接访问底层数组, 按完成时刻升序取出一份副本保存
+    std::vector<uint64_t> pending;
+    if (!cp.isLoading()) {
+        for (auto copy = in_flight; !copy.empty(); copy.pop()) {
+            pending.push_back(copy.top());
+        }
+    }
+    cp.array(pending, true);
+    if (cp.isLoading()) {
+        in_flight = decltype(in_flight)(pending.begin(), pending.end());
+    }
+    cp.array(writeback_done);
+    cp.array(stores);
+    cp.array(store_head);
+    // 预取记录在第一次预取时才分配
+    cp.array(prefetch_fills, true);
+    cp.array(prefetch_next, true);
+    cp.value(prefetch_done);
+    if (!cp.isLoading()) {
+        return;
+    }
+    if (prefetch_fills.size() != (prefetch_next.empty() ? 0 : cores.size() * PREFETCH_TRACKED) ||
+        prefetch_next.size() != (prefetch_fills.empty() ? 0 : cores.size())) {
+        cp.fail();
+    }
+    // 环形队列的位置用作下标, 损坏的检查点不能让它越界
+    for (uint32_t next : prefetch_next) {
+        if (next >= PREFETCH_TRACKED) {
+            cp.fail();
+        }
+    }
+    for (uint32_t head : store_head) {
+        if (head >= buffers.store) {
+            cp.fail();
+        }
+    }
+}
+
+uint64_t TimingModel::prefetchPending(int core, uint64_t line, uint64_t at) const {
+    if (prefetch_fills.empty()) {
+        return 0;
+    }
+    const MshrEntry *entries = &prefetch_fills[static_cast<size_t>(core) * PREFETCH_TRACKED];
+    for (uint32_t i = 0; i < PREFETCH_TRACKED; i++) {
+        if (entries[i].line == line && entries[i].done_at > at) {
+            return entries[i].done_at;
+        }
+    }
+    return 0;
+}
+
+void TimingModel::accountPrefetch(int core, const AccessInfo &info) {
+    if (prefetch_fills.empty()) {
+        prefetch_fills.resize(cores.size() * PREFETCH_TRACKED);
+        prefetch_next.resize(cores.size());
+    }
+    MshrEntry &entry = prefetch_fills[static_cast<size_t>(core) * PREFETCH_TRACKED + prefetch_next[core]];
+    prefetch_next[core] = (prefetch_next[core] + 1) % PREFETCH_TRACKED;
+    entry.line = info.line;
+    uint64_t data = info.cache_to_cache ? latencies.cache_to_cache : info.llc_hit ? latencies.llc : latencies.memory;
+    uint64_t start = std::max(now, bus_free_at);
+    uint64_t occupancy = latencies.bus_arbitration + latencies.snoop;
+    if (bus_model.split) {
+        bus_free_at = start + occupancy;
+        bus_busy_cycles += occupancy;
+        uint64_t response_start = std::max(bus_free_at + data, data_free_at);
+        data_free_at = response_start + latencies.bus_arbitration;
+        data_busy_cycles += latencies.bus_arbitration;
+        entry.done_at = data_free_at;
+    } else {
+        occupancy += data;
+        if (info.writeback && buffers.writeback == 0) {
+            occupancy += latencies.memory;
+        }
+        bus_free_at = start + occupancy;
+        bus_busy_cycles += occupancy;
+        entry.done_at = bus_free_at;
+    }
+    prefetch_done = std::max(prefetch_done, entry.done_at);
+}
+
+void TimingModel::arriveBarrier(int core) {
+    CoreTiming &timing = cores[core];
+    // barrier 同时等待本核所有未完成的访问
+    timing.barrier_at = std::max(now, timing.done_at);
+    timing.ready_at = timing.barrier_at;
+}
+
+void TimingModel::releaseBarrier() {
+    uint64_t release = 0;
+    for (const CoreTiming &timing : cores) {
+        release = std::max(release, timing.barrier_at);
+    }
+    for (CoreTiming &timing : cores) {
+        timing.barrier_cycles += release - timing.barrier_at;
+        timing.ready_at = std::max(timing.ready_at, release);
+        timing.done_at = std::max(timing.done_at, release);
+    }
+}
+
+uint64_t TimingModel::totalCycles() const {
+    uint64_t total = std::max(now + 1, prefetch_done);
+    for (const CoreTiming &timing : cores) {
+        total = std::max(total, timing.done_at);
+    }
+    return total;
+}
+
+void TimingModel::printReport() const {
+    uint64_t total = totalCycles();
+    std::streamsize precision = std::cout.precision();
+    std::cout << "\nTiming (hit " << latencies.l1_hit << ", arbitration " << latencies.bus_arbitration
+              << ", snoop " << latencies.snoop << ", cache-to-cache " << latencies.cache_to_cache
+              << ", memory " << latencies.memory << ")\n";
+    std::cout << "Core\tCycles\tAccesses\tStall\tBusWait\tBarrier\tAMAT\n";
+    for (size_t i = 0; i < cores.size(); i++) {
+        const CoreTiming &timing = cores[i];
+        double amat = timing.accesses ? static_cast<double>(timing.total_latency) / timing.accesses : 0.0;
+        std::cout << "P" << i << "\t" << timing.done_at << "\t" << timing.accesses << "\t\t"
+                  << timing.stall_cycles << "\t" << timing.bus_wait_cycles << "\t" << timing.barrier_cycles
+                  << "\t" << std::fixed << std::setprecision(2) << amat << "\n";
+        std::cout.unsetf(std::ios::fixed);
+        std::cout.precision(precision);
+    }
+    if (!prefetch_fills.empty()) {
+        uint64_t late = 0;
+        for (const CoreTiming &timing : cores) {
+            late += timing.late_prefetch_cycles;
+        }
+        std::cout << "Cycles waiting for late prefetches: " << late << "\n";
+    }
+    if (!bus_model.split && (buffers.writeback > 0 || buffers.store > 0)) {
+        std::cout << "Buffers (" << buffers.writeback << " write-back, " << buffers.store << " store entries per core)\n";
+        std::cout << "Core\tWBLines\tWBHidden\tWBFull\tStores\tMerged\tSBHidden\tSBFull\n";
+        for (size_t i = 0; i < cores.size(); i++) {
+            const CoreTiming &timing = cores[i];
+            std::cout << "P" << i << "\t" << timing.buffered_writebacks << "\t" << timing.writeback_hidden << "\t\t"
+                      << timing.writeback_full << "\t" << timing.buffered_stores << "\t" << timing.store_merges
+                      << "\t" << timing.store_hidden << "\t\t" << timing.store_full << "\n";
+        }
+    }
+    if (!bus_model.split) {
+        std::cout << "Total cycles: " << total << ", bus utilization: " << std::fixed << std::setprecision(2)
+                  << (100.0 * bus_busy_cycles / total) << "%" << std::endl;
+        std::cout.unsetf(std::ios::fixed);
+        std::cout.precision(precision);
+        return;
+    }
+    std::cout << "Split-transaction bus (" << bus_model.outstanding << " outstanding, " << bus_model.mshrs
+              << " MSHRs per cache)\n";
+    std::cout << "Core\tMerged\tMSHRFull\tConflicts\tAvgMSHR\tPeakMSHR\n";
+    for (size_t i = 0; i < cores.size(); i++) {
+        const CoreTiming &timing = cores[i];
+        std::cout << "P" << i << "\t" << timing.mshr_merges << "\t" << timing.mshr_full_cycles << "\t\t"
+                  << timing.line_conflicts << "\t\t" << std::fixed << std::setprecision(2)
+                  << (static_cast<double>(timing.mshr_busy_cycles) / total) << "\t" << timing.mshr_peak << "\n";
+        std::cout.unsetf(std::ios::fixed);
+        std::cout.precision(precision);
+    }
+    std::cout << "Total cycles: " << total << ", address bus utilization: " << std::fixed << std::setprecision(2)
+              << (100.0 * bus_busy_cycles / total) << "%, data bus utilization: "
+              << (100.0 * data_busy_cycles / total) << "%" << std::endl;
+    std::cout.unsetf(std::ios::fixed);
+    std::cout.precision(precision);
+}
@@ -0,0 +1,144 @@
+#ifndef TIMING_HPP
+#define TIMING_HPP
+
+#include <cstdint>
+#include <functional>
+#include <queue>
+#include <string>
+#include <vector>
+#include "common.hpp"
+
+class Checkpoint;
+
+#define PREFETCH_TRACKED 8      // 每核记录的最近预取数, 需求访问命中其中未完成的预取时等待它完成
+
+// 各操作的延迟 (周期)
+struct Latencies {
+    uint32_t l1_hit = 1;
+    uint32_t bus_arbitration = 2;
+    uint32_t snoop = 3;
+    uint32_t cache_to_cache = 10;
+    uint32_t memory = 100;
+    uint32_t llc = 20;              // 共享 LLC 命中
+};
+
+// 分离事务总线: 请求阶段占用地址总线 (仲裁 + 监听), 数据就绪后响应阶段占用数据总线 (一次仲裁时间),
+// 两个阶段之间总线可以服务其他事务. 每个 cache 有若干 MSHR, 核在缺失期间可以继续发出访问
+struct BusModel {
+    bool split = false;             // false 时为原子总线 + 阻塞式核
+    uint32_t outstanding = 8;       // 总线上同时未完成的事务数上限
+    uint32_t mshrs = 4;             // 每个 cache 的 MSHR 数
+};
+
+// 每核的写回缓冲与合并式存储缓冲的项数, 0 表示不使用. 写回缓冲让替换出的脏行在后台经内存写端口写回,
+// 不再占用缺失的总线事务; 存储缓冲让需要总线的写 (写缺失、升级) 在取得所有权之前就退休,
+// 各项按程序顺序完成 (TSO). 只用于阻塞式核, 分离事务模式下的核本来就不等待写和写回
+struct BufferModel {
+    uint32_t writeback = 0;
+    uint32_t store = 0;
+};
+
+// 解析 "hit:arb:snoop:c2c:mem", 可在末尾追加 ":llc"
+bool parseLatencies(const std::string &text, Latencies &latencies);
+
+// 一次 cache 访问的结果, 由 Cache::access 填写, 供时序模型计算延迟
+struct AccessInfo {
+    bool hit = false;
+    int bus_request = -1;           // 发出的 BusRequest, -1 表示未使用总线
+    bool cache_to_cache = false;    // 数据由其他 cache 提供
+    bool llc_hit = false;           // 数据由共享 LLC 提供
+    bool writeback = false;         // 替换了脏块, 需要先写回内存
+    bool write = false;             // 写请求
+    bool atomic = false;            // 读-改-写: 等待本核之前的访问全部完成, 不进入存储缓冲
+    bool bus_lock = false;          // 总线锁: 读-改-写期间锁住总线, 命中也占用总线
+    uint64_t line = 0;              // 访问的行地址, MSHR 按行合并
+};
+
+struct CoreTiming {
+    uint64_t ready_at = 0;          // 该核可以发出下一条请求的时刻 (阻塞式核即上一条请求完成的时刻)
+    uint64_t done_at = 0;           // 该核已发出的请求全部完成的时刻
+    uint64_t accesses = 0;
+    uint64_t total_latency = 0;     // 所有访问延迟之和 (用于 AMAT)
+    uint64_t stall_cycles = 0;      // 超出 L1 命中延迟的部分, 含总线排队
+    uint64_t bus_wait_cycles = 0;   // 等待总线空闲的周期
+    uint64_t barrier_cycles = 0;    // 在 barrier 处等待其他核的周期
+    uint64_t barrier_at = 0;        // 到达 barrier 的时刻
+    // 以下仅用于分离事务总线
+    uint64_t mshr_merges = 0;       // 合并到同一行未完成 MSHR 的次缺失
+    uint64_t mshr_full_cycles = 0;  // MSHR 全部占用导致核停顿的周期
+    uint64_t line_conflicts = 0;    // 同一行已有未完成事务 (瞬态) 而推迟发出的事务
+    uint64_t mshr_busy_cycles = 0;  // 所有 MSHR 被占用的周期之和, 除以总周期即平均占用数
+    uint32_t mshr_peak = 0;         // 同时占用的 MSHR 数的最大值
+    uint64_t late_prefetch_cycles = 0;  // 命中预取的行但预取尚未完成而等待的周期
+    // 以下仅用于写回缓冲与存储缓冲
+    uint64_t buffered_writebacks = 0;   // 进入写回缓冲的脏行
+    uint64_t writeback_hidden = 0;      // 写回缓冲省去的停顿周期
+    uint64_t writeback_full = 0;        // 写回缓冲已满, 等待最旧一项写完的周期
+    uint64_t buffered_stores = 0;       // 进入存储缓冲的写
+    uint64_t store_merges = 0;          // 合并到同一行未完成存储的写命中
+    uint64_t store_hidden = 0;          // 存储缓冲省去的停顿周期
+    uint64_t store_full = 0;            // 存储缓冲已满, 等待最旧一项完成的周期
+};
+
+// 一个 MSHR: 记录一行未完成的缺失/升级, 在 done_at 之前该行处于瞬态
+// (等待数据的 IS_D / IM_D, 或等待无效化完成的 SM_A), 同一行的后续访问合并到这里
+struct MshrEntry {
+    uint64_t line = 0;
+    uint64_t done_at = 0;
+};
+
+// 默认为阻塞式核 + 原子总线的时序模型:
+//   trace 的每一行是请求到达各核的时刻; 核在上一条请求完成前不能发出新请求;
+//   总线一次只服务一个事务, 事务占用 仲裁 + 监听 + 数据传输 (+ 写回) 个周期.
+// 分离事务模式见 BusModel. 两种模式下一致性的功能结果都由 Cache::access 按仲裁顺序原子地决定,
+// 时序模型只决定各事务何时发出和完成.
+class TimingModel {
+private:
+    Latencies latencies;
+    BusModel bus_model;
+    std::vector<CoreTiming> cores;
+    uint64_t now = 0;
+    uint64_t bus_free_at = 0;
+    uint64_t bus_busy_cycles = 0;
+    // 分离事务总线
+    uint64_t data_free_at = 0;
+    uint64_t data_busy_cycles = 0;
+    std::vector<MshrEntry> mshrs;   // num_cores * bus_model.mshrs
+    std::priority_queue<uint64_t, std::vector<uint64_t>, std::greater<uint64_t>> in_flight;  // 未完成事务的完成时刻
+    // 写回缓冲与存储缓冲
+    BufferModel buffers;
+    std::vector<uint64_t> writeback_done;   // num_cores * buffers.writeback, 各项写完的时刻
+    std::vector<MshrEntry> stores;          // num_cores * buffers.store, 按程序顺序的环形队列
+    std::vector<uint32_t> store_head;       // 每核最旧一项的位置
+    // 预取: 每核最近 PREFETCH_TRACKED 次预取的行与完成时刻, 第一次预取时分配
+    std::vector<MshrEntry> prefetch_fills;
+    std::vector<uint32_t> prefetch_next;
+    uint64_t prefetch_done = 0;             // 最后一次预取完成的时刻
+
+    // 该行有未完成的预取时返回其完成时刻, 否则返回 0
+    uint64_t prefetchPending(int core, uint64_t line, uint64_t at) const;
+
+    MshrEntry *coreMshrs(int core) { return &mshrs[core * bus_model.mshrs]; }
+    uint64_t accountSplit(int core, const AccessInfo &info);
+
+public:
+    TimingModel(int num_cores, const Latencies &latencies, const BusModel &bus_model = BusModel(),
+                const BufferModel &buffers = BufferModel());
+    void beginCycle(uint64_t cycle) { now = cycle; }
+    // 计算一次访问的完成时刻并更新该核的统计, 返回访问延迟
+    uint64_t account(int core, const AccessInfo &info);
+    // 预取在本周期的需求请求之后占用总线, 不计入任何核的延迟
+    void accountPrefetch(int core, const AccessInfo &info);
+    void arriveBarrier(int core);
+    // 所有核都到达 barrier: 同步到最晚到达的核
+    void releaseBarrier();
+    uint64_t totalCycles() const;
+    const CoreTiming &getCore(int core) const { return cores[core]; }
+    uint64_t busBusyCycles() const { return bus_busy_cycles; }
+    const BusModel &getBusModel() const { return bus_model; }
+    const BufferModel &getBuffers() const { return buffers; }
+    void checkpoint(Checkpoint &cp);
+    void printReport() const;
+};
+
+#endif
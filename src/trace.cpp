@@ -0,0 +1,204 @@
+#include "trace.hpp"
+#include "profile.hpp"
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <cstdlib>
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define TRACE_USE_MMAP 1
+#endif
+
+MappedFile::MappedFile(const std::string &filename) {
+#ifdef TRACE_USE_MMAP
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == 0) {
+        opened = true;
+        length = st.st_size;
+        if (length > 0) {
+            void *p = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p == MAP_FAILED) {
+                opened = false;
+                length = 0;
+            } else {
+                madvise(p, length, MADV_SEQUENTIAL);
+                data = static_cast<const char *>(p);
+            }
+        }
+    }
+    ::close(fd);
+#else
+    std::ifstream in(filename, std::ios::binary);
+    if (!in.is_open()) {
+        return;
+    }
+    fallback.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    opened = true;
+    length = fallback.size();
+    data = fallback.data();
+#endif
+}
+
+MappedFile::~MappedFile() {
+#ifdef TRACE_USE_MMAP
+    if (data != nullptr) {
+        munmap(const_cast<char *>(data), length);
+    }
+#endif
+}
+
+std::unique_ptr<TraceReader> TraceReader::open(const std::string &filename) {
+    std::ifstream probe(filename, std::ios::binary);
+    if (!probe.is_open()) {
+        return nullptr;
+    }
+    char magic[8] = {};
+    probe.read(magic, sizeof(magic));
+    probe.close();
+    if (std::memcmp(magic, TRACE_MAGIC, sizeof(magic)) == 0) {
+        return std::unique_ptr<TraceReader>(new BinaryTraceReader(filename));
+    }
+    return std::unique_ptr<TraceReader>(new TextTraceReader(filename));
+}
+
+TextTraceReader::TextTraceReader(const std::string &filename) : file(filename) {
+    cursor = file.begin();
+}
+
+// 每一行是一个周期, 行内用 ';' 分隔各处理器的请求, "NULL" 表示该处理器本周期无请求
+bool TextTraceReader::nextCycle(std::vector<Request> &requests) {
+    PROFILE_SCOPE(PROF_TRACE);
+    const char *end = file.end();
+    if (cursor == end) {
+        return false;
+    }
+    const char *newline = static_cast<const char *>(std::memchr(cursor, '\n', end - cursor));
+    const char *line_end = newline != nullptr ? newline : end;
+    requests.clear();
+
+    const char *p = cursor;
+    while (p < line_end) {
+        const char *semi = static_cast<const char *>(std::memchr(p, ';', line_end - p));
+        const char *field_end = semi != nullptr ? semi : line_end;
+        const char *b = p;
+        const char *e = field_end;
+        while (b < e && (*b == ' ' || *b == '\t')) b++;
+        while (e > b && (e[-1] == ' ' || e[-1] == '\t')) e--;
+        if (!(e - b == 4 && std::memcmp(b, "NULL", 4) == 0)) {
+            requests.push_back(parseRequest(b, e, num_cores));
+        }
+        p = semi != nullptr ? semi + 1 : line_end;
+    }
+
+    cursor = newline != nullptr ? newline + 1 : end;
+    return true;
+}
+
+BinaryTraceReader::BinaryTraceReader(const std::string &filename) : file(filename) {
+    if (file.size() < sizeof(TraceHeader)) {
+        std::cerr << "Invalid binary trace: " << filename << std::endl;
+        exit(1);
+    }
+    header = reinterpret_cast<const TraceHeader *>(file.begin());
+    if (header->version != TRACE_VERSION) {
+        std::cerr << "Unsupported binary trace version: " << header->version << std::endl;
+        exit(1);
+    }
+    if (header->address_bits > sizeof(Request::address) * 8) {
+        std::cerr << "Binary trace uses " << header->address_bits
+                  << "-bit addresses, wider than this simulator supports" << std::endl;
+        exit(1);
+    }
+    num_cores = header->num_cores;
+    cursor = file.begin() + sizeof(TraceHeader);
+}
+
+bool BinaryTraceReader::nextCycle(std::vector<Request> &requests) {
+    PROFILE_SCOPE(PROF_TRACE);
+    const char *end = file.end();
+    if (cursor + sizeof(TraceCycle) > end) {
+        return false;
+    }
+    const TraceCycle *cycle = reinterpret_cast<const TraceCycle *>(cursor);
+    const TraceRecord *record = reinterpret_cast<const TraceRecord *>(cursor + sizeof(TraceCycle));
+    if (reinterpret_cast<const char *>(record + cycle->count) > end) {
+        std::cerr << "Truncated binary trace" << std::endl;
+        exit(1);
+    }
+    requests.clear();
+    for (uint32_t i = 0; i < cycle->count; i++, record++) {
+        if (record->processor_id >= num_cores || record->op > SC || record->op == PREFETCH) {
+            std::cerr << "Invalid binary trace record (P" << record->processor_id
+                      << ", op " << static_cast<int>(record->op) << ")" << std::endl;
+            exit(1);
+        }
+        requests.push_back(Request(record->processor_id, static_cast<Operation>(record->op),
+                                   record->address, record->write_data, record->compare_data));
+    }
+    cursor = reinterpret_cast<const char *>(record);
+    return true;
+}
+
+void TraceData::load(TraceReader &reader) {
+    num_cores = reader.headerCores();
+    requests.clear();
+    cycle_offsets.assign(1, 0);
+    std::vector<Request> cycle;
+    while (reader.nextCycle(cycle)) {
+        requests.insert(requests.end(), cycle.begin(), cycle.end());
+        cycle_offsets.push_back(requests.size());
+    }
+}
+
+BinaryTraceWriter::BinaryTraceWriter(const std::string &filename, int num_cores) {
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, TRACE_MAGIC, sizeof(header.magic));
+    header.version = TRACE_VERSION;
+    header.num_cores = num_cores;
+    header.address_bits = sizeof(Request::address) * 8;
+    file = std::fopen(filename.c_str(), "wb");
+    if (file != nullptr) {
+        std::fwrite(&header, sizeof(header), 1, file);
+    }
+}
+
+BinaryTraceWriter::~BinaryTraceWriter() {
+    close();
+}
+
+void BinaryTraceWriter::writeCycle(const std::vector<Request> &requests) {
+    TraceCycle cycle;
+    std::memset(&cycle, 0, sizeof(cycle));
+    cycle.count = requests.size();
+    std::fwrite(&cycle, sizeof(cycle), 1, file);
+    for (const Request &request : requests) {
+        TraceRecord record;
+        std::memset(&record, 0, sizeof(record));
+        record.address = request.address;
+        record.processor_id = request.processor_id;
+        record.write_data = request.write_data;
+        record.op = request.op;
+        record.compare_data = request.compare_data;
+        std::fwrite(&record, sizeof(record), 1, file);
+    }
+    header.num_cycles++;
+    header.num_records += requests.size();
+}
+
+// 回填周期数和记录数
+void BinaryTraceWriter::close() {
+    if (file == nullptr) {
+        return;
+    }
+    std::fseek(file, 0, SEEK_SET);
+    std::fwrite(&header, sizeof(header), 1, file);
+    std::fclose(file);
+    file = nullptr;
+}
@@ -0,0 +1,130 @@
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+#include "request.hpp"
+
+// 二进制 trace 格式 (小端):
+//   TraceHeader, 之后每个周期一个 TraceCycle, 紧跟 count 条 TraceRecord.
+//   所有结构均为 16 字节的倍数, 映射后可直接按结构体读取.
+#define TRACE_MAGIC "MESITRC"
+#define TRACE_VERSION 1
+
+struct TraceHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t num_cores;
+    uint32_t address_bits;
+    uint32_t reserved;
+    uint64_t num_cycles;
+    uint64_t num_records;
+    uint64_t reserved2;
+};
+
+struct TraceCycle {
+    uint32_t count;
+    uint32_t reserved[3];
+};
+
+struct TraceRecord {
+    uint64_t address;
+    uint16_t processor_id;
+    uint16_t write_data;
+    uint8_t op;
+    uint8_t reserved;
+    uint16_t compare_data;  // CAS 的期望值; 早期文件此处为 0
+};
+
+static_assert(sizeof(TraceHeader) == 48, "TraceHeader layout");
+static_assert(sizeof(TraceCycle) == 16, "TraceCycle layout");
+static_assert(sizeof(TraceRecord) == 16, "TraceRecord layout");
+
+// 只读映射整个文件
+class MappedFile {
+private:
+    const char *data = nullptr;
+    size_t length = 0;
+    bool opened = false;
+    std::vector<char> fallback;     // 不支持 mmap 的平台上读入内存
+
+public:
+    explicit MappedFile(const std::string &filename);
+    ~MappedFile();
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    bool isOpen() const { return opened; }
+    const char *begin() const { return data; }
+    const char *end() const { return data + length; }
+    size_t size() const { return length; }
+};
+
+// 逐周期读取 trace, 复用调用者的 vector, 稳定状态下没有堆分配.
+// 数据来源可以是文件, 也可以是边解码边产生请求的导入器或合成负载生成器
+class TraceReader {
+protected:
+    int num_cores = 4;
+
+public:
+    virtual ~TraceReader() {}
+    // trace 自带的核数 (二进制 trace 头, 或每核一个文件的导入格式), 未知时返回 0
+    virtual int headerCores() const { return 0; }
+    void setNumCores(int n) { num_cores = n; }
+    virtual bool nextCycle(std::vector<Request> &requests) = 0;
+
+    // 根据文件头选择二进制或文本读取器, 文件不存在时返回空指针
+    static std::unique_ptr<TraceReader> open(const std::string &filename);
+};
+
+class TextTraceReader : public TraceReader {
+private:
+    MappedFile file;
+    const char *cursor;
+
+public:
+    explicit TextTraceReader(const std::string &filename);
+    bool nextCycle(std::vector<Request> &requests) override;
+};
+
+class BinaryTraceReader : public TraceReader {
+private:
+    MappedFile file;
+    const TraceHeader *header;
+    const char *cursor;
+
+public:
+    explicit BinaryTraceReader(const std::string &filename);
+    int headerCores() const override { return header->num_cores; }
+    bool nextCycle(std::vector<Request> &requests) override;
+};
+
+// 整个 trace 解析后的只读内存表示, 可被多个模拟实例同时读取
+struct TraceData {
+    int num_cores = 0;                  // 二进制 trace 头中的核数, 文本 trace 为 0
+    std::vector<Request> requests;
+    std::vector<size_t> cycle_offsets;  // 第 c 个周期的请求为 [cycle_offsets[c], cycle_offsets[c + 1])
+
+    void load(TraceReader &reader);
+    size_t cycles() const { return cycle_offsets.empty() ? 0 : cycle_offsets.size() - 1; }
+    const Request *cycleBegin(size_t c) const { return requests.data() + cycle_offsets[c]; }
+    const Request *cycleEnd(size_t c) const { return requests.data() + cycle_offsets[c + 1]; }
+};
+
+class BinaryTraceWriter {
+private:
+    FILE *file;
+    TraceHeader header;
+
+public:
+    BinaryTraceWriter(const std::string &filename, int num_cores);
+    ~BinaryTraceWriter();
+    bool isOpen() const { return file != nullptr; }
+    void writeCycle(const std::vector<Request> &requests);
+    void close();
+};
+
+#endif
@@ -0,0 +1,364 @@
+#include "trace_import.hpp"
+#include "profile.hpp"
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#ifdef SIM_HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef SIM_HAVE_LZMA
+#include <lzma.h>
+#endif
+
+#define INPUT_BUFFER_SIZE (1 << 16)
+
+// 实际的字节来源: 未压缩文件, gzip 或 xz
+struct InputStream::Decoder {
+    FILE *file = nullptr;
+#ifdef SIM_HAVE_ZLIB
+    gzFile gz = nullptr;
+#endif
+#ifdef SIM_HAVE_LZMA
+    bool xz = false;
+    bool xz_finished = false;
+    lzma_stream lzma = LZMA_STREAM_INIT;
+    std::vector<uint8_t> compressed;
+#endif
+
+    ~Decoder() {
+#ifdef SIM_HAVE_ZLIB
+        if (gz != nullptr) {
+            gzclose(gz);
+        }
+#endif
+#ifdef SIM_HAVE_LZMA
+        if (xz) {
+            lzma_end(&lzma);
+        }
+#endif
+        if (file != nullptr) {
+            std::fclose(file);
+        }
+    }
+
+    // 最多读取 size 字节, 返回读到的字节数, 0 表示结束, -1 表示数据损坏
+    long read(char *out, size_t size) {
+#ifdef SIM_HAVE_ZLIB
+        if (gz != nullptr) {
+            return gzread(gz, out, static_cast<unsigned>(size));
+        }
+#endif
+#ifdef SIM_HAVE_LZMA
+        if (xz) {
+            if (xz_finished) {
+                return 0;
+            }
+            lzma.next_out = reinterpret_cast<uint8_t *>(out);
+            lzma.avail_out = size;
+            while (lzma.avail_out == size) {
+                lzma_action action = LZMA_RUN;
+                if (lzma.avail_in == 0) {
+                    lzma.next_in = compressed.data();
+                    lzma.avail_in = std::fread(compressed.data(), 1, compressed.size(), file);
+                    if (lzma.avail_in == 0) {
+                        action = LZMA_FINISH;
+                    }
+                }
+                lzma_ret ret = lzma_code(&lzma, action);
+                if (ret == LZMA_STREAM_END) {
+                    xz_finished = true;
+                    break;
+                }
+                if (ret != LZMA_OK) {
+                    return -1;
+                }
+            }
+            return size - lzma.avail_out;
+        }
+#endif
+        return std::fread(out, 1, size, file);
+    }
+};
+
+InputStream::InputStream(const std::string &filename) : decoder(new Decoder()) {
+    decoder->file = std::fopen(filename.c_str(), "rb");
+    if (decoder->file == nullptr) {
+        error = "Cannot open " + filename;
+        return;
+    }
+    unsigned char magic[6] = {};
+    size_t magic_length = std::fread(magic, 1, sizeof(magic), decoder->file);
+    std::rewind(decoder->file);
+    bool gzip = magic_length >= 2 && magic[0] == 0x1F && magic[1] == 0x8B;
+    bool xz = magic_length == 6 && std::memcmp(magic, "\xFD" "7zXZ\0", 6) == 0;
+    if (gzip) {
+#ifdef SIM_HAVE_ZLIB
+        std::fclose(decoder->file);
+        decoder->file = nullptr;
+        decoder->gz = gzopen(filename.c_str(), "rb");
+        if (decoder->gz == nullptr) {
+            error = "Cannot open " + filename;
+            return;
+        }
+        gzbuffer(decoder->gz, INPUT_BUFFER_SIZE);
+#else
+        error = filename + " is gzip-compressed, but this build has no zlib support";
+        return;
+#endif
+    } else if (xz) {
+#ifdef SIM_HAVE_LZMA
+        if (lzma_stream_decoder(&decoder->lzma, UINT64_MAX, LZMA_CONCATENATED) != LZMA_OK) {
+            error = "Cannot initialize the xz decoder for " + filename;
+            return;
+        }
+        decoder->xz = true;
+        decoder->compressed.resize(INPUT_BUFFER_SIZE);
+#else
+        error = filename + " is xz-compressed, but this build has no liblzma support";
+        return;
+#endif
+    }
+    buffer.resize(INPUT_BUFFER_SIZE);
+}
+
+InputStream::~InputStream() {}
+
+// 把未读的数据移到缓冲区开头, 再尽量填满剩余空间; 没有读到新数据时返回 false
+bool InputStream::fill() {
+    if (eof) {
+        return false;
+    }
+    if (begin > 0) {
+        std::memmove(buffer.data(), buffer.data() + begin, end - begin);
+        end -= begin;
+        begin = 0;
+    }
+    if (end == buffer.size()) {
+        buffer.resize(buffer.size() * 2);
+    }
+    long n = decoder->read(buffer.data() + end, buffer.size() - end);
+    if (n < 0) {
+        std::cerr << "Corrupt compressed trace input" << std::endl;
+        exit(1);
+    }
+    if (n == 0) {
+        eof = true;
+        return false;
+    }
+    end += n;
+    return true;
+}
+
+bool InputStream::readLine(const char *&line, size_t &length) {
+    size_t scanned = begin;
+    const char *newline;
+    while ((newline = static_cast<const char *>(std::memchr(buffer.data() + scanned, '\n', end - scanned))) == nullptr) {
+        size_t offset = end - begin;
+        if (!fill()) {
+            if (begin == end) {
+                return false;
+            }
+            // 最后一行没有换行符
+            newline = buffer.data() + end;
+            break;
+        }
+        scanned = begin + offset;
+    }
+    line = buffer.data() + begin;
+    length = newline - line;
+    begin = newline - buffer.data() + (newline < buffer.data() + end ? 1 : 0);
+    if (length > 0 && line[length - 1] == '\r') {
+        length--;
+    }
+    return true;
+}
+
+bool InputStream::read(void *data, size_t size) {
+    char *out = static_cast<char *>(data);
+    while (end - begin < size) {
+        if (!fill()) {
+            return false;
+        }
+    }
+    std::memcpy(out, buffer.data() + begin, size);
+    begin += size;
+    return true;
+}
+
+DineroTraceReader::DineroTraceReader(const std::string &filename) : input(filename), name(filename) {}
+
+static const char *skipSpaces(const char *p) {
+    while (*p == ' ' || *p == '\t') p++;
+    return p;
+}
+
+bool DineroTraceReader::nextRecord(Request &request) {
+    const char *line;
+    size_t length;
+    char text[128];     // 以 '\0' 结尾的副本, 供 strtoul 等函数使用
+    while (input.readLine(line, length)) {
+        line_number++;
+        if (length >= sizeof(text)) {
+            std::cerr << "Invalid Dinero record at " << name << ":" << line_number << std::endl;
+            exit(1);
+        }
+        std::memcpy(text, line, length);
+        text[length] = '\0';
+        const char *p = skipSpaces(text);
+        if (*p == '\0') {
+            continue;
+        }
+        char *label_end = nullptr;
+        char *address_end = nullptr;
+        char *core_end = nullptr;
+        unsigned long label = std::strtoul(p, &label_end, 10);
+        const char *address_begin = skipSpaces(label_end);
+        uint64_t address = std::strtoull(address_begin, &address_end, 16);
+        const char *core_begin = skipSpaces(address_end);
+        long core = 0;
+        if (*core_begin != '\0') {
+            core = std::strtol(core_begin, &core_end, 10);
+        }
+        if (label_end == p || address_end == address_begin || core_end == core_begin ||
+            (core_end != nullptr && *skipSpaces(core_end) != '\0')) {
+            std::cerr << "Invalid Dinero record at " << name << ":" << line_number << std::endl;
+            exit(1);
+        }
+        // 只导入数据读写
+        if (label > 1) {
+            continue;
+        }
+        if (core < 0 || core >= num_cores) {
+            std::cerr << "Dinero record at " << name << ":" << line_number << " uses processor " << core
+                      << ", but only " << num_cores << " cores are simulated" << std::endl;
+            exit(1);
+        }
+        records++;
+        // trace 中没有写入的数据, 用记录序号的低 16 位区分各次写入
+        request = Request(static_cast<int>(core), label == 0 ? READ : WRITE, address,
+                          label == 0 ? 0 : static_cast<uint16_t>(records));
+        return true;
+    }
+    return false;
+}
+
+bool DineroTraceReader::nextCycle(std::vector<Request> &requests) {
+    PROFILE_SCOPE(PROF_TRACE);
+    requests.clear();
+    uint64_t present[MAX_CORES / 64] = {};
+    Request request = pending;
+    bool have = has_pending || nextRecord(request);
+    has_pending = false;
+    while (have) {
+        uint64_t bit = 1ULL << (request.processor_id & 63);
+        uint64_t &word = present[request.processor_id >> 6];
+        if (word & bit) {
+            pending = request;
+            has_pending = true;
+            break;
+        }
+        word |= bit;
+        requests.push_back(request);
+        have = nextRecord(request);
+    }
+    return !requests.empty();
+}
+
+ChampSimTraceReader::ChampSimTraceReader(const std::vector<std::string> &filenames) : streams(filenames.size()) {
+    for (size_t i = 0; i < filenames.size(); i++) {
+        streams[i].input.reset(new InputStream(filenames[i]));
+        streams[i].name = filenames[i];
+        streams[i].ops.reserve(6);
+    }
+    num_cores = filenames.size();
+}
+
+std::string ChampSimTraceReader::errorMessage() const {
+    for (const Stream &stream : streams) {
+        if (!stream.input->isOpen()) {
+            return stream.input->errorMessage();
+        }
+    }
+    return "";
+}
+
+// 读取下一条访存指令, 展开为读写请求; 文件结束时返回 false
+bool ChampSimTraceReader::refill(int core) {
+    Stream &stream = streams[core];
+    ChampSimInstr instr;
+    stream.ops.clear();
+    stream.next = 0;
+    while (stream.ops.empty()) {
+        if (!stream.input->read(&instr, sizeof(instr))) {
+            if (stream.input->buffered() != 0) {
+                std::cerr << "Truncated ChampSim trace " << stream.name << " (" << stream.input->buffered()
+                          << " trailing bytes)" << std::endl;
+                exit(1);
+            }
+            stream.done = true;
+            return false;
+        }
+        for (uint64_t address : instr.source_memory) {
+            if (address != 0) {
+                stream.ops.push_back(Request(core, READ, address));
+            }
+        }
+        for (uint64_t address : instr.destination_memory) {
+            if (address != 0) {
+                records++;
+                stream.ops.push_back(Request(core, WRITE, address, static_cast<uint16_t>(records)));
+            }
+        }
+    }
+    return true;
+}
+
+bool ChampSimTraceReader::nextCycle(std::vector<Request> &requests) {
+    PROFILE_SCOPE(PROF_TRACE);
+    requests.clear();
+    for (size_t core = 0; core < streams.size(); core++) {
+        Stream &stream = streams[core];
+        if (stream.done || (stream.next == stream.ops.size() && !refill(core))) {
+            continue;
+        }
+        requests.push_back(stream.ops[stream.next++]);
+    }
+    return !requests.empty();
+}
+
+std::unique_ptr<TraceReader> openImportedTrace(const std::string &format, const std::string &files) {
+    if (format == "din") {
+        DineroTraceReader *reader = new DineroTraceReader(files);
+        std::unique_ptr<TraceReader> result(reader);
+        if (!reader->errorMessage().empty()) {
+            std::cerr << "Error: " << reader->errorMessage() << std::endl;
+            return nullptr;
+        }
+        return result;
+    }
+    if (format == "champsim") {
+        std::vector<std::string> filenames;
+        size_t start = 0;
+        while (start <= files.size()) {
+            size_t comma = files.find(',', start);
+            if (comma == std::string::npos) {
+                comma = files.size();
+            }
+            filenames.push_back(files.substr(start, comma - start));
+            start = comma + 1;
+        }
+        if (filenames.size() > MAX_CORES) {
+            std::cerr << "Error: At most " << MAX_CORES << " ChampSim traces (one per core) are supported." << std::endl;
+            return nullptr;
+        }
+        ChampSimTraceReader *reader = new ChampSimTraceReader(filenames);
+        std::unique_ptr<TraceReader> result(reader);
+        if (!reader->errorMessage().empty()) {
+            std::cerr << "Error: " << reader->errorMessage() << std::endl;
+            return nullptr;
+        }
+        return result;
+    }
+    std::cerr << "Error: Unknown trace format " << format << ", expected din or champsim." << std::endl;
+    return nullptr;
+}
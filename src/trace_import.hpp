@@ -0,0 +1,105 @@
+#ifndef TRACE_IMPORT_HPP
+#define TRACE_IMPORT_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+#include "request.hpp"
+#include "trace.hpp"
+
+// 顺序读取一个可能被压缩的文件: 按文件头识别 gzip (需要 zlib) 和 xz (需要 liblzma),
+// 其余按未压缩处理. 解压在固定大小的缓冲区中进行, 内存占用与文件大小无关
+class InputStream {
+private:
+    struct Decoder;
+    std::unique_ptr<Decoder> decoder;
+    std::vector<char> buffer;
+    size_t begin = 0;
+    size_t end = 0;
+    bool eof = false;
+    std::string error;
+
+    bool fill();
+
+public:
+    explicit InputStream(const std::string &filename);
+    ~InputStream();
+    InputStream(const InputStream &) = delete;
+    InputStream &operator=(const InputStream &) = delete;
+    // 打开失败或压缩格式不受支持时返回 false, 原因见 errorMessage
+    bool isOpen() const { return error.empty(); }
+    const std::string &errorMessage() const { return error; }
+    // 读取一行 (不含换行符), 指针在下一次读取前有效; 到达文件末尾时返回 false
+    bool readLine(const char *&line, size_t &length);
+    // 读取恰好 size 字节, 不足时返回 false
+    bool read(void *data, size_t size);
+    // 已读入但尚未取走的字节数; read 在文件末尾失败后不为 0 说明最后一条记录不完整
+    size_t buffered() const { return end - begin; }
+};
+
+// Dinero 格式: 每行 "label address [core]", label 0 为读, 1 为写, 其余 (取指、flush 等) 忽略,
+// 地址为十六进制; 可选的第三列是处理器编号, 缺省为 0.
+// 按原顺序划分周期: 当前周期已有同一处理器的请求时开始新周期
+class DineroTraceReader : public TraceReader {
+private:
+    InputStream input;
+    std::string name;
+    uint64_t line_number = 0;
+    uint64_t records = 0;
+    bool has_pending = false;
+    Request pending = Request(0, READ);
+
+    bool nextRecord(Request &request);
+
+public:
+    explicit DineroTraceReader(const std::string &filename);
+    // 为空表示打开成功
+    const std::string &errorMessage() const { return input.errorMessage(); }
+    bool nextCycle(std::vector<Request> &requests) override;
+};
+
+// ChampSim 指令 trace 的记录 (64 字节), 每个处理器一个文件
+struct ChampSimInstr {
+    uint64_t ip;
+    uint8_t is_branch;
+    uint8_t branch_taken;
+    uint8_t destination_registers[2];
+    uint8_t source_registers[4];
+    uint64_t destination_memory[2];
+    uint64_t source_memory[4];
+};
+
+static_assert(sizeof(ChampSimInstr) == 64, "ChampSimInstr layout");
+
+// 每个周期每个处理器发出其指令流中的下一次访存: 先读 (source_memory) 后写 (destination_memory),
+// 不访存的指令被跳过. 所有文件读完时结束
+class ChampSimTraceReader : public TraceReader {
+private:
+    struct Stream {
+        std::unique_ptr<InputStream> input;
+        std::string name;
+        std::vector<Request> ops;   // 当前指令中尚未发出的访存
+        size_t next = 0;
+        bool done = false;
+    };
+    std::vector<Stream> streams;
+    uint64_t records = 0;
+
+    bool refill(int core);
+
+public:
+    explicit ChampSimTraceReader(const std::vector<std::string> &filenames);
+    // 为空表示所有文件都打开成功
+    std::string errorMessage() const;
+    int headerCores() const override { return streams.size(); }
+    bool nextCycle(std::vector<Request> &requests) override;
+};
+
+// 按格式名打开导入器: "din" 读一个文件, "champsim" 读以逗号分隔的每核文件列表.
+// 格式未知或文件无法打开时打印错误并返回空指针
+std::unique_ptr<TraceReader> openImportedTrace(const std::string &format, const std::string &files);
+
+#endif
@@ -0,0 +1,229 @@
+#include "workload.hpp"
+#include "profile.hpp"
+#include "geometry.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+#define PRIVATE_REGION_BASE (1ULL << 40)    // 各核私有数据的起始地址, 与共享区域不重叠
+#define MIGRATORY_OBJECT_LINES 4            // 迁移式共享对象的行数上限
+
+static bool parsePattern(const std::string &name, WorkloadPattern &pattern) {
+    if (name == "zipf") {
+        pattern = WORKLOAD_ZIPF;
+    } else if (name == "stream") {
+        pattern = WORKLOAD_STREAM;
+    } else if (name == "prodcons") {
+        pattern = WORKLOAD_PRODUCER_CONSUMER;
+    } else if (name == "migratory") {
+        pattern = WORKLOAD_MIGRATORY;
+    } else if (name == "lock") {
+        pattern = WORKLOAD_LOCK;
+    } else if (name == "falseshare") {
+        pattern = WORKLOAD_FALSE_SHARING;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+static bool parseUnsigned(const std::string &text, uint64_t &value) {
+    char *end = nullptr;
+    value = std::strtoull(text.c_str(), &end, 10);
+    return !text.empty() && *end == '\0' && text[0] != '-';
+}
+
+bool parseWorkload(const std::string &text, WorkloadSpec &spec) {
+    size_t colon = text.find(':');
+    if (!parsePattern(text.substr(0, colon), spec.pattern)) {
+        return false;
+    }
+    size_t start = colon == std::string::npos ? text.size() : colon + 1;
+    while (start < text.size()) {
+        size_t comma = text.find(',', start);
+        if (comma == std::string::npos) {
+            comma = text.size();
+        }
+        std::string field = text.substr(start, comma - start);
+        start = comma + 1;
+        size_t equals = field.find('=');
+        if (equals == std::string::npos) {
+            return false;
+        }
+        std::string key = field.substr(0, equals);
+        std::string value = field.substr(equals + 1);
+        uint64_t number = 0;
+        if (key == "reads" || key == "alpha") {
+            char *end = nullptr;
+            double real = std::strtod(value.c_str(), &end);
+            if (value.empty() || *end != '\0' || real < 0) {
+                return false;
+            }
+            if (key == "reads") {
+                if (real > 1) {
+                    return false;
+                }
+                spec.read_ratio = real;
+            } else {
+                spec.zipf_alpha = real;
+            }
+        } else if (!parseUnsigned(value, number)) {
+            return false;
+        } else if (key == "cycles") {
+            spec.cycles = number;
+        } else if (key == "share" && number <= MAX_CORES) {
+            spec.sharing = static_cast<int>(number);
+        } else if (key == "seed") {
+            spec.seed = number;
+        } else if (key == "lines" && number >= 2 && number <= (1u << 30)) {
+            spec.lines = static_cast<uint32_t>(number);
+        } else if (key == "line" && number >= 4 && number <= (1u << 16) && isPowerOfTwo(number)) {
+            spec.line_bytes = static_cast<uint32_t>(number);
+        } else if (key == "burst" && number >= 1 && number <= UINT32_MAX) {
+            spec.burst = static_cast<uint32_t>(number);
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+SyntheticTraceReader::SyntheticTraceReader(const WorkloadSpec &spec) : spec(spec), state(spec.seed) {
+    region_bytes = static_cast<uint64_t>(spec.lines) * spec.line_bytes;
+}
+
+// splitmix64
+uint64_t SyntheticTraceReader::nextRandom() {
+    uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+uint64_t SyntheticTraceReader::zipfLine() {
+    double u = uniform();
+    return std::upper_bound(zipf_cdf.begin(), zipf_cdf.end() - 1, u) - zipf_cdf.begin();
+}
+
+uint64_t SyntheticTraceReader::sharedBase(int group) const {
+    return group * region_bytes;
+}
+
+uint64_t SyntheticTraceReader::privateBase(int core) const {
+    return PRIVATE_REGION_BASE + core * region_bytes;
+}
+
+// 核数在构造后才由 setNumCores 确定, 因此在第一个周期初始化
+void SyntheticTraceReader::start() {
+    if (spec.sharing <= 0 || spec.sharing > num_cores) {
+        spec.sharing = num_cores;
+    }
+    cores.assign(num_cores, CoreState());
+    groups.assign((num_cores + spec.sharing - 1) / spec.sharing, GroupState());
+    if (spec.pattern == WORKLOAD_ZIPF) {
+        zipf_cdf.resize(spec.lines);
+        double sum = 0;
+        for (uint32_t k = 0; k < spec.lines; k++) {
+            sum += 1.0 / std::pow(k + 1.0, spec.zipf_alpha);
+            zipf_cdf[k] = sum;
+        }
+        for (double &p : zipf_cdf) {
+            p /= sum;
+        }
+    }
+}
+
+Request SyntheticTraceReader::generate(int core) {
+    CoreState &self = cores[core];
+    int group = core / spec.sharing;
+    int member = core % spec.sharing;
+    int group_size = std::min(spec.sharing, num_cores - group * spec.sharing);
+    uint64_t base = sharedBase(group);
+    uint16_t data = static_cast<uint16_t>(nextRandom());
+    // 行内随机的半字
+    uint64_t halfword = (nextRandom() % (spec.line_bytes / 2)) * 2;
+
+    switch (spec.pattern) {
+    case WORKLOAD_STREAM: {
+        uint64_t address = base + self.position;
+        self.position = (self.position + 8) % region_bytes;
+        return Request(core, chooseRead() ? READ : WRITE, address, data);
+    }
+    case WORKLOAD_PRODUCER_CONSUMER: {
+        CoreState &producer = cores[group * spec.sharing];
+        if (member == 0) {
+            uint64_t address = base + producer.position;
+            producer.position = (producer.position + 8) % region_bytes;
+            return Request(core, WRITE, address, data);
+        }
+        // 消费者读取生产者 burst 行之前写入的位置
+        uint64_t lag = std::min<uint64_t>(static_cast<uint64_t>(spec.burst) * spec.line_bytes, region_bytes - 8);
+        return Request(core, READ, base + (producer.position + region_bytes - 8 - lag) % region_bytes);
+    }
+    case WORKLOAD_MIGRATORY: {
+        uint64_t epoch = cycle / spec.burst;
+        if (static_cast<int>(epoch % group_size) == member) {
+            uint64_t object_lines = std::min<uint64_t>(spec.lines, MIGRATORY_OBJECT_LINES);
+            // 对象依次经过组内每个核之后才换到下一行
+            uint64_t object = (epoch / group_size) % object_lines;
+            uint64_t address = base + object * spec.line_bytes + (self.position % spec.line_bytes);
+            // 持有期间交替读改写同一个半字
+            Operation op = self.modify ? WRITE : READ;
+            self.modify = !self.modify;
+            if (!self.modify) {
+                self.position += 2;
+            }
+            return Request(core, op, address, data);
+        }
+        uint64_t address = privateBase(core) + (nextRandom() % spec.lines) * spec.line_bytes + halfword;
+        return Request(core, chooseRead() ? READ : WRITE, address, data);
+    }
+    case WORKLOAD_LOCK: {
+        GroupState &lock = groups[group];
+        if (self.holding) {
+            if (self.remaining > 0) {
+                self.remaining--;
+                uint64_t address = base + (1 + nextRandom() % (spec.lines - 1)) * spec.line_bytes + halfword;
+                return Request(core, chooseRead() ? READ : WRITE, address, data);
+            }
+            self.holding = false;
+            lock.lock_owner = -1;
+            return Request(core, WRITE, base, 0);
+        }
+        if (lock.lock_owner < 0) {
+            self.holding = true;
+            self.remaining = spec.burst;
+            lock.lock_owner = core;
+            return Request(core, WRITE, base, 1);
+        }
+        return Request(core, READ, base);
+    }
+    case WORKLOAD_FALSE_SHARING: {
+        // 同一时间所有核访问同一行中各自的半字
+        uint64_t line = (cycle / spec.burst) % spec.lines;
+        uint64_t address = base + line * spec.line_bytes + (member * 2) % spec.line_bytes;
+        return Request(core, chooseRead() ? READ : WRITE, address, data);
+    }
+    case WORKLOAD_ZIPF:
+    default: {
+        uint64_t address = base + zipfLine() * spec.line_bytes + halfword;
+        return Request(core, chooseRead() ? READ : WRITE, address, data);
+    }
+    }
+}
+
+bool SyntheticTraceReader::nextCycle(std::vector<Request> &requests) {
+    PROFILE_SCOPE(PROF_TRACE);
+    if (cycle >= spec.cycles) {
+        return false;
+    }
+    if (cores.empty()) {
+        start();
+    }
+    requests.clear();
+    for (int core = 0; core < num_cores; core++) {
+        requests.push_back(generate(core));
+    }
+    cycle++;
+    return true;
+}
@@ -0,0 +1,73 @@
+#ifndef WORKLOAD_HPP
+#define WORKLOAD_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "request.hpp"
+#include "trace.hpp"
+
+enum WorkloadPattern {
+    WORKLOAD_ZIPF,              // 按 Zipf 分布访问共享热点集合
+    WORKLOAD_STREAM,            // 顺序扫描共享区域, 到末尾后回绕
+    WORKLOAD_PRODUCER_CONSUMER, // 组内第一个核顺序写环形缓冲区, 其余核滞后读取
+    WORKLOAD_MIGRATORY,         // 一小块数据在组内各核间轮流被读改写, 其余时间访问私有数据
+    WORKLOAD_LOCK,              // 组内各核竞争一把锁: 自旋读锁, 获得后写锁并访问临界区数据, 最后写锁释放
+    WORKLOAD_FALSE_SHARING      // 各核只访问自己的半字, 但这些半字位于相同的 cache 行
+};
+
+// 合成负载参数, 文本形式为 "pattern[:key=value,...]", 例如 "zipf:cycles=1000000,reads=0.8,share=2,seed=7".
+// pattern 为 zipf, stream, prodcons, migratory, lock 或 falseshare;
+// key 为 cycles, reads, share, seed, lines, line, alpha, burst
+struct WorkloadSpec {
+    WorkloadPattern pattern = WORKLOAD_ZIPF;
+    uint64_t cycles = 100000;       // 周期数, 每个周期每个核发出一个请求
+    double read_ratio = 0.7;        // 读请求的比例 (生产者/消费者与锁的协议访问除外)
+    int sharing = 0;                // 共享度: 每组核数, 组内的核访问同一区域; 0 表示所有核一组
+    uint64_t seed = 1;
+    uint32_t lines = 4096;          // 每个区域的行数
+    uint32_t line_bytes = 64;
+    double zipf_alpha = 0.99;
+    uint32_t burst = 16;            // 迁移式共享中每个核连续持有的访问数, 以及临界区的访问数
+};
+
+// 解析失败时返回 false
+bool parseWorkload(const std::string &text, WorkloadSpec &spec);
+
+// 按需生成请求的 trace 来源: 每次 nextCycle 只生成一个周期, 内存占用与周期数无关.
+// 使用自带的随机数生成器, 相同参数和种子在任何平台上产生相同的请求序列
+class SyntheticTraceReader : public TraceReader {
+private:
+    struct CoreState {
+        uint64_t position = 0;      // 顺序扫描或生产者写入的位置 (字节)
+        uint32_t remaining = 0;     // 当前持有锁时剩余的临界区访问数
+        bool holding = false;       // 持有锁
+        bool modify = false;        // 迁移式共享: 下一次访问是写 (读改写中的写)
+    };
+    struct GroupState {
+        int lock_owner = -1;
+    };
+
+    WorkloadSpec spec;
+    uint64_t state;
+    uint64_t cycle = 0;
+    std::vector<CoreState> cores;
+    std::vector<GroupState> groups;
+    std::vector<double> zipf_cdf;   // 第 k 热的行被选中的累积概率
+    uint64_t region_bytes;
+
+    uint64_t nextRandom();
+    double uniform() { return (nextRandom() >> 11) * (1.0 / 9007199254740992.0); }
+    bool chooseRead() { return uniform() < spec.read_ratio; }
+    uint64_t zipfLine();
+    uint64_t sharedBase(int group) const;
+    uint64_t privateBase(int core) const;
+    void start();
+    Request generate(int core);
+
+public:
+    explicit SyntheticTraceReader(const WorkloadSpec &spec);
+    bool nextCycle(std::vector<Request> &requests) override;
+};
+
+#endif
@@ -0,0 +1,58 @@
+#include "write_buffer.hpp"
+#include "checkpoint.hpp"
+#include <algorithm>
+
+void WriteBackBuffer::configure(uint32_t entries, int words_per_line) {
+    capacity = entries;
+    words = words_per_line;
+    addresses.assign(entries, 0);
+    lines.assign(static_cast<size_t>(entries) * words_per_line, 0);
+    head = 0;
+    count = 0;
+}
+
+int WriteBackBuffer::find(uint64_t line_address) const {
+    for (uint32_t i = 0; i < count; i++) {
+        if (addresses[slot(i)] == line_address) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void WriteBackBuffer::push(uint64_t line_address, const uint32_t *line) {
+    uint32_t to = slot(count);
+    addresses[to] = line_address;
+    std::copy(line, line + words, &lines[static_cast<size_t>(to) * words]);
+    count++;
+    buffered++;
+}
+
+void WriteBackBuffer::remove(int position) {
+    count--;
+    // 移除最旧一项只需移动队首, 否则之后的项依次前移一位
+    if (position == 0) {
+        head = slot(1);
+        return;
+    }
+    for (uint32_t i = position; i < count; i++) {
+        uint32_t to = slot(i);
+        uint32_t from = slot(i + 1);
+        addresses[to] = addresses[from];
+        std::copy(&lines[static_cast<size_t>(from) * words], &lines[static_cast<size_t>(from) * words] + words,
+                  &lines[static_cast<size_t>(to) * words]);
+    }
+}
+
+void WriteBackBuffer::checkpoint(Checkpoint &cp) {
+    cp.array(addresses);
+    cp.array(lines);
+    cp.value(head);
+    cp.value(count);
+    cp.value(buffered);
+    cp.value(early_drains);
+    cp.value(full_drains);
+    if (cp.isLoading() && count > 0 && (head >= capacity || count > capacity)) {
+        cp.fail();
+    }
+}
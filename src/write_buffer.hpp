@@ -0,0 +1,44 @@
+#ifndef WRITE_BUFFER_HPP
+#define WRITE_BUFFER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class Checkpoint;
+
+// 每个 cache 私有的写回缓冲: 被替换的脏行连同它自己的行地址暂存在这里, 按先进先出在后台写回下一级.
+// 写回之前该行的最新数据只在缓冲中, 因此本 cache 的缺失和其他 cache 的监听都要先检查缓冲
+class WriteBackBuffer {
+private:
+    uint32_t capacity = 0;
+    int words = 0;
+    std::vector<uint64_t> addresses;    // capacity 项的环形队列
+    std::vector<uint32_t> lines;        // capacity * words
+    uint32_t head = 0;
+    uint32_t count = 0;
+
+    uint32_t slot(int position) const { return (head + position) % capacity; }
+
+public:
+    uint64_t buffered = 0;              // 进入缓冲的脏行数
+    uint64_t early_drains = 0;          // 监听或本 cache 的缺失命中缓冲, 被提前写回的项数
+    uint64_t full_drains = 0;           // 缓冲已满, 替换时同步写回最旧一项的次数
+
+    // entries 为 0 表示不使用写回缓冲
+    void configure(uint32_t entries, int words_per_line);
+    bool enabled() const { return capacity > 0; }
+    bool empty() const { return count == 0; }
+    bool full() const { return count == capacity; }
+    // 返回该行在缓冲中的位置 (0 为最旧), 不在缓冲中时返回 -1
+    int find(uint64_t line_address) const;
+    // 缓冲未满时加入一项
+    void push(uint64_t line_address, const uint32_t *line);
+    uint64_t address(int position) const { return addresses[slot(position)]; }
+    const uint32_t *line(int position) const { return &lines[static_cast<size_t>(slot(position)) * words]; }
+    // 移除一项, 其余项保持原来的顺序
+    void remove(int position);
+    void checkpoint(Checkpoint &cp);
+};
+
+#endif
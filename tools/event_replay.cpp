@@ -0,0 +1,161 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include "cache.hpp"
+#include "event_log.hpp"
+#include "trace.hpp"
+
+// 从事件日志重建逐请求的 print_state 输出:
+//   ./event_replay run.log            与未加 -q 的模拟器输出一致
+//   ./event_replay -final run.log     只打印结束时各 cache 的状态
+struct ShadowBlock {
+    State state = INVALID;
+    uint64_t tag = 0;
+    uint32_t lru = 0;
+};
+
+struct ShadowCache {
+    std::vector<ShadowBlock> blocks;
+    std::vector<uint32_t> data;
+};
+
+static void printShadow(const ShadowCache &cache, int core, const CacheGeometry &geometry) {
+    std::cout << "Cache State (Processor " << core << "):\n";
+    for (uint32_t s = 0; s < geometry.sets; s++) {
+        std::cout << "Set " << s << ":\t";
+        for (uint32_t b = 0; b < geometry.ways; b++) {
+            uint32_t slot = s * geometry.ways + b;
+            const ShadowBlock &block = cache.blocks[slot];
+            Cache::printBlock(std::cout, block.state, block.tag, &cache.data[slot * geometry.words_per_line],
+                              geometry.words_per_line, block.lru);
+        }
+        std::cout << "\n";
+    }
+}
+
+int main(int argc, char* argv[]) {
+    std::ios::sync_with_stdio(false);
+    bool final_only = false;
+    std::string filename;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "-final") {
+            final_only = true;
+        } else {
+            filename = arg;
+        }
+    }
+    if (filename.empty()) {
+        std::cerr << "Usage: ./event_replay [-final] logfile" << std::endl;
+        return 1;
+    }
+
+    MappedFile file(filename);
+    if (!file.isOpen() || file.size() < sizeof(EventRecord)) {
+        std::cerr << "Error: Cannot read event log " << filename << std::endl;
+        return 1;
+    }
+    const EventRecord *header = reinterpret_cast<const EventRecord *>(file.begin());
+    if (header->kind != LOG_HEADER || header->lru != EVENT_LOG_VERSION || header->core < 1 ||
+        header->core > MAX_CORES || !CacheGeometry::valid(header->slot, header->tag, header->data)) {
+        std::cerr << "Error: " << filename << " is not an event log" << std::endl;
+        return 1;
+    }
+    int num_cores = header->core;
+    CacheGeometry geometry = CacheGeometry::make(header->slot, header->tag, header->data);
+    int words = geometry.words_per_line;
+    uint32_t num_blocks = geometry.sets * geometry.ways;
+
+    std::vector<ShadowCache> caches(num_cores);
+    for (ShadowCache &cache : caches) {
+        cache.blocks.resize(geometry.sets * geometry.ways);
+        cache.data.resize(cache.blocks.size() * words, 0);
+    }
+
+    const char *p = file.begin() + sizeof(EventRecord);
+    while (p < file.end()) {
+        if (static_cast<size_t>(file.end() - p) < sizeof(EventRecord)) {
+            std::cerr << "Error: Truncated event log " << filename << std::endl;
+            return 1;
+        }
+        const EventRecord *record = reinterpret_cast<const EventRecord *>(p);
+        p += sizeof(EventRecord);
+        // 记录中的核号和块号用作下标, 损坏的日志不能让它们越界
+        if (record->core >= num_cores) {
+            std::cerr << "Error: Corrupt event log " << filename << " (core " << record->core << ")" << std::endl;
+            return 1;
+        }
+        Request request(record->core, static_cast<Operation>(record->state), record->tag, record->data,
+                        record->compare);
+        switch (record->kind) {
+            case LOG_CYCLE:
+                if (!final_only) {
+                    std::cout << "\n----------Cycle " << record->cycle << "----------\n\n";
+                }
+                break;
+            case LOG_BLOCK: {
+                if (record->slot >= num_blocks) {
+                    std::cerr << "Error: Corrupt event log " << filename << " (block " << record->slot << ")"
+                              << std::endl;
+                    return 1;
+                }
+                if (static_cast<size_t>(file.end() - p) < (words - 1) * sizeof(uint32_t)) {
+                    std::cerr << "Error: Truncated event log " << filename << std::endl;
+                    return 1;
+                }
+                ShadowCache &cache = caches[record->core];
+                ShadowBlock &block = cache.blocks[record->slot];
+                block.state = static_cast<State>(record->state);
+                block.tag = record->tag;
+                block.lru = record->lru;
+                uint32_t *data = &cache.data[record->slot * words];
+                data[0] = record->data;
+                for (int w = 1; w < words; w++, p += sizeof(uint32_t)) {
+                    data[w] = *reinterpret_cast<const uint32_t *>(p);
+                }
+                break;
+            }
+            case LOG_ENQUEUE:
+                if (!final_only) {
+                    std::cout << "\nEnqueued " << request.toString() << " (Priority: " << record->slot
+                              << ", Type: " << operationType(request.op) << ")\n";
+                }
+                break;
+            case LOG_PROCESS:
+                if (!final_only) {
+                    std::cout << "\nProcessing " << request.toString() << " (Priority: " << record->core
+                              << ", Type: " << operationType(request.op) << ")\n";
+                    printShadow(caches[record->core], record->core, geometry);
+                }
+                break;
+            case LOG_QUEUED:
+                if (!final_only) {
+                    std::cout << "\nQueued " << request.toString()
+                              << " (Barrier active for P" << record->core << ")\n";
+                }
+                break;
+            case LOG_BARRIER:
+                if (!final_only) {
+                    std::cout << "\nProcessing " << request.toString()
+                              << " (Set barrier for P" << record->core << ")\n";
+                    printShadow(caches[record->core], record->core, geometry);
+                }
+                break;
+            case LOG_CLEAR:
+                if (!final_only) {
+                    std::cout << "\nAll barriers set, clearing barriers\n";
+                }
+                break;
+            default:
+                std::cerr << "Error: Unknown event kind " << static_cast<int>(record->kind) << std::endl;
+                return 1;
+        }
+    }
+
+    if (final_only) {
+        for (int core = 0; core < num_cores; core++) {
+            printShadow(caches[core], core, geometry);
+        }
+    }
+    return 0;
+}
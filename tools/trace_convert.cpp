@@ -0,0 +1,90 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include "trace.hpp"
+#include "trace_import.hpp"
+#include "workload.hpp"
+
+// 将文本 trace、导入格式或合成负载转换为二进制 trace:
+//   ./trace_convert [-cores N] input.txt output.bin
+//   ./trace_convert [-cores N] -format din|champsim input[,input...] output.bin
+//   ./trace_convert [-cores N] -gen pattern[:key=value,...] output.bin
+int main(int argc, char* argv[]) {
+    int num_cores = 4;
+    bool cores_given = false;
+    std::string format;
+    std::string workload;
+    std::vector<std::string> files;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "-cores" && i + 1 < argc) {
+            num_cores = std::atoi(argv[++i]);
+            cores_given = true;
+        } else if (arg == "-format" && i + 1 < argc) {
+            format = argv[++i];
+        } else if (arg == "-gen" && i + 1 < argc) {
+            workload = argv[++i];
+        } else {
+            files.push_back(arg);
+        }
+    }
+    size_t expected_files = workload.empty() ? 2 : 1;
+    if (files.size() != expected_files || num_cores < 1 || num_cores > MAX_CORES || (!workload.empty() && !format.empty())) {
+        std::cerr << "Usage: ./trace_convert [-cores N] [-format din|champsim] input output.bin\n"
+                  << "       ./trace_convert [-cores N] -gen pattern[:key=value,...] output.bin" << std::endl;
+        return 1;
+    }
+
+    std::unique_ptr<TraceReader> reader;
+    if (!workload.empty()) {
+        WorkloadSpec spec;
+        if (!parseWorkload(workload, spec)) {
+            std::cerr << "Error: Invalid workload " << workload << std::endl;
+            return 1;
+        }
+        reader.reset(new SyntheticTraceReader(spec));
+    } else if (!format.empty()) {
+        reader = openImportedTrace(format, files[0]);
+        if (!reader) {
+            return 1;
+        }
+    } else {
+        reader = TraceReader::open(files[0]);
+        if (!reader) {
+            std::cerr << "Error: Cannot open " << files[0] << std::endl;
+            return 1;
+        }
+        if (reader->headerCores() > 0) {
+            std::cerr << "Error: " << files[0] << " is already a binary trace" << std::endl;
+            return 1;
+        }
+    }
+    // 每核一个文件的格式自带核数
+    if (!cores_given && reader->headerCores() > 0) {
+        num_cores = reader->headerCores();
+    }
+    if (reader->headerCores() > num_cores) {
+        std::cerr << "Error: Trace needs " << reader->headerCores() << " cores." << std::endl;
+        return 1;
+    }
+    reader->setNumCores(num_cores);
+
+    const std::string &output = files.back();
+    BinaryTraceWriter writer(output, num_cores);
+    if (!writer.isOpen()) {
+        std::cerr << "Error: Cannot create " << output << std::endl;
+        return 1;
+    }
+    std::vector<Request> requests;
+    uint64_t cycles = 0;
+    uint64_t records = 0;
+    while (reader->nextCycle(requests)) {
+        writer.writeCycle(requests);
+        cycles++;
+        records += requests.size();
+    }
+    writer.close();
+    std::cout << "Converted " << cycles << " cycles, " << records << " requests to " << output << std::endl;
+    return 0;
+}